@@ -1313,8 +1313,23 @@ gjs_array_to_explicit_array_internal(JSContext       *context,
         JS::RootedObject array_obj(context, &value.toObject());
         const GjsAtoms& atoms = GjsContextPrivate::atoms(context);
         GITypeTag element_type = g_type_info_get_tag(param_info);
-        if (JS_IsUint8Array(array_obj) && (element_type == GI_TYPE_TAG_INT8 ||
-                                           element_type == GI_TYPE_TAG_UINT8)) {
+        bool is_struct_array_view = false;
+        if (element_type == GI_TYPE_TAG_INTERFACE &&
+            !g_type_info_is_pointer(param_info)) {
+            GjsAutoBaseInfo interface_info =
+                g_type_info_get_interface(param_info);
+            if (interface_info.type() == GI_INFO_TYPE_STRUCT &&
+                !BoxedPrototype::array_view_to_c_array(
+                    context, array_obj, interface_info, contents, length_p,
+                    &is_struct_array_view))
+                goto out;
+        }
+
+        if (is_struct_array_view) {
+            /* Contents were copied out of the view's buffer */
+        } else if (JS_IsUint8Array(array_obj) &&
+                   (element_type == GI_TYPE_TAG_INT8 ||
+                    element_type == GI_TYPE_TAG_UINT8)) {
             GBytes* bytes = gjs_byte_array_get_bytes(array_obj);
             *contents = g_bytes_unref_to_data(bytes, length_p);
         } else if (JS_HasPropertyById(context, array_obj, atoms.length(),
@@ -2332,6 +2347,17 @@ gjs_array_from_carray_internal (JSContext             *context,
                 !g_type_info_is_pointer(param_info)) {
                 size_t struct_size;
 
+                if (info_type == GI_INFO_TYPE_STRUCT) {
+                    bool is_struct_array_view;
+                    bool ok = BoxedPrototype::array_view_from_c_array(
+                        context, interface_info, array, length, value_p,
+                        &is_struct_array_view);
+                    if (!ok || is_struct_array_view) {
+                        g_base_info_unref(interface_info);
+                        return ok;
+                    }
+                }
+
                 if (info_type == GI_INFO_TYPE_UNION)
                     struct_size = g_union_info_get_size(interface_info);
                 else
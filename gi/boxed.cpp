@@ -24,6 +24,7 @@
 #include <stdint.h>
 #include <string.h>  // for memcpy, size_t, strcmp
 
+#include <new>          // for operator new
 #include <string>       // for string
 #include <type_traits>  // for remove_reference
 #include <utility>      // for move, forward
@@ -47,11 +48,47 @@
 #include "util/log.h"
 
 BoxedInstance::BoxedInstance(JSContext* cx, JS::HandleObject obj)
-    : GIWrapperInstance(cx, obj), m_owning_ptr(false) {
+    : GIWrapperInstance(cx, obj),
+      m_allocated_directly(false),
+      m_allocated_inline(false),
+      m_owning_ptr(false) {
     m_ptr = nullptr;
     GJS_INC_COUNTER(boxed_instance);
 }
 
+/*
+ * BoxedInstance::new_for_js_object:
+ *
+ * Overrides GIWrapperInstance::new_for_js_object(). If the prototype says
+ * instances of this type are small enough, extra space is allocated after the
+ * BoxedInstance so that allocate_directly() can place the struct there, and
+ * creating or collecting the instance takes one allocation instead of two.
+ * The private data never moves during GC, so the pointer handed to C code is
+ * as stable as one from a separate allocation.
+ */
+BoxedInstance* BoxedInstance::new_for_js_object(JSContext* cx,
+                                                JS::HandleObject obj) {
+    g_assert(!JS_GetPrivate(obj));
+    BoxedPrototype* proto = BoxedPrototype::for_js_prototype(cx, obj);
+    size_t size = allocation_size(proto);
+    auto* priv = static_cast<BoxedInstance*>(g_slice_alloc0(size));
+    new (priv) BoxedInstance(cx, obj);
+    GJS_ADD_WRAPPER_BYTES(size);
+
+    // See GIWrapperInstance::new_for_js_object()
+    JS_SetPrivate(obj, priv);
+
+    return priv;
+}
+
+// Overrides GIWrapperInstance::finalize_impl().
+void BoxedInstance::finalize_impl(JSFreeOp*, JSObject*) {
+    size_t size = allocation_size(get_prototype());
+    this->~BoxedInstance();
+    g_slice_free1(size, this);
+    GJS_ADD_WRAPPER_BYTES(-gssize(size));
+}
+
 GJS_USE
 static bool struct_is_simple(GIStructInfo *info);
 
@@ -112,15 +149,24 @@ BoxedBase* BoxedBase::get_copy_source(JSContext* context,
  * Allocate a boxed object of the correct size, set all the bytes to 0, and set
  * m_ptr to point to it. This is used when constructing a boxed object that can
  * be allocated directly (i.e., does not need to be created by a constructor
- * function.)
+ * function.) Small structs use the inline storage that was allocated together
+ * with the BoxedInstance, which is already zeroed.
  */
 void BoxedInstance::allocate_directly(void) {
-    g_assert(get_prototype()->can_allocate_directly());
+    BoxedPrototype* proto = get_prototype();
+    g_assert(proto->can_allocate_directly());
 
-    own_ptr(g_slice_alloc0(g_struct_info_get_size(info())));
+    if (proto->inline_storage_size() > 0) {
+        own_ptr(inline_storage());
+        m_allocated_inline = true;
+        debug_lifecycle("Boxed pointer directly allocated inline");
+    } else {
+        size_t size = g_struct_info_get_size(info());
+        own_ptr(g_slice_alloc0(size));
+        GJS_ADD_WRAPPER_BYTES(size);
+        debug_lifecycle("Boxed pointer directly allocated");
+    }
     m_allocated_directly = true;
-
-    debug_lifecycle("Boxed pointer directly allocated");
 }
 
 /* When initializing a boxed object from a hash of properties, we don't want
@@ -394,8 +440,12 @@ bool BoxedInstance::constructor_impl(JSContext* context, JS::HandleObject obj,
 
 BoxedInstance::~BoxedInstance() {
     if (m_owning_ptr) {
-        if (m_allocated_directly) {
-            g_slice_free1(g_struct_info_get_size(info()), m_ptr);
+        if (m_allocated_inline) {
+            // Freed together with the BoxedInstance, see finalize_impl()
+        } else if (m_allocated_directly) {
+            size_t size = g_struct_info_get_size(info());
+            g_slice_free1(size, m_ptr);
+            GJS_ADD_WRAPPER_BYTES(-gssize(size));
         } else {
             if (g_type_is_a(gtype(), G_TYPE_BOXED))
                 g_boxed_free(gtype(), m_ptr);
@@ -683,6 +733,242 @@ bool BoxedBase::field_setter(JSContext* cx, unsigned argc, JS::Value* vp) {
     return true;
 }
 
+/*
+ * Direct field access:
+ *
+ * Fields of basic scalar types in simple structs (see struct_is_simple()) are
+ * accessed with a typed load or store at the field's offset, instead of going
+ * through GIFieldInfo, g_field_info_get_field(), and GIArgument conversion on
+ * every access. The field's offset, index, and type tag are packed into the
+ * uint32 stored in the accessor's private slot.
+ */
+static constexpr unsigned DIRECT_FIELD_TAG_BITS = 5;
+static constexpr unsigned DIRECT_FIELD_INDEX_BITS = 11;
+static constexpr unsigned DIRECT_FIELD_OFFSET_BITS = 16;
+
+GJS_USE
+static bool direct_field_pack(GIFieldInfo* field_info, int field_ix,
+                              uint32_t* packed) {
+    GjsAutoTypeInfo type_info = g_field_info_get_type(field_info);
+    if (g_type_info_is_pointer(type_info))
+        return false;
+
+    GIFieldInfoFlags flags = g_field_info_get_flags(field_info);
+    if (!(flags & GI_FIELD_IS_READABLE) || !(flags & GI_FIELD_IS_WRITABLE))
+        return false;
+
+    GITypeTag tag = g_type_info_get_tag(type_info);
+    switch (tag) {
+    case GI_TYPE_TAG_BOOLEAN:
+    case GI_TYPE_TAG_INT8:
+    case GI_TYPE_TAG_UINT8:
+    case GI_TYPE_TAG_INT16:
+    case GI_TYPE_TAG_UINT16:
+    case GI_TYPE_TAG_INT32:
+    case GI_TYPE_TAG_UINT32:
+    case GI_TYPE_TAG_FLOAT:
+    case GI_TYPE_TAG_DOUBLE:
+        break;
+    default:
+        // 64-bit integers keep going through the generic path, so that they
+        // still warn about loss of precision
+        return false;
+    }
+
+    int offset = g_field_info_get_offset(field_info);
+    if (offset < 0 || offset >= (1 << DIRECT_FIELD_OFFSET_BITS) ||
+        field_ix >= (1 << DIRECT_FIELD_INDEX_BITS) ||
+        tag >= (1 << DIRECT_FIELD_TAG_BITS))
+        return false;
+
+    *packed = (uint32_t(offset) << (DIRECT_FIELD_INDEX_BITS +
+                                    DIRECT_FIELD_TAG_BITS)) |
+              (uint32_t(field_ix) << DIRECT_FIELD_TAG_BITS) | uint32_t(tag);
+    return true;
+}
+
+GJS_USE
+static inline GITypeTag direct_field_tag(uint32_t packed) {
+    return GITypeTag(packed & ((1 << DIRECT_FIELD_TAG_BITS) - 1));
+}
+
+GJS_USE
+static inline uint32_t direct_field_index(uint32_t packed) {
+    return (packed >> DIRECT_FIELD_TAG_BITS) &
+           ((1 << DIRECT_FIELD_INDEX_BITS) - 1);
+}
+
+GJS_USE
+static inline uint32_t direct_field_offset(uint32_t packed) {
+    return packed >> (DIRECT_FIELD_INDEX_BITS + DIRECT_FIELD_TAG_BITS);
+}
+
+template <typename T>
+GJS_USE static inline T& direct_field(uint8_t* struct_ptr, uint32_t packed) {
+    return *reinterpret_cast<T*>(struct_ptr + direct_field_offset(packed));
+}
+
+/*
+ * BoxedBase::direct_field_getter:
+ *
+ * JSNative property getter for scalar fields of simple structs. Equivalent to
+ * BoxedBase::field_getter(), but reads the memory directly.
+ */
+bool BoxedBase::direct_field_getter(JSContext* cx, unsigned argc,
+                                    JS::Value* vp) {
+    GJS_GET_WRAPPER_PRIV(cx, argc, vp, args, obj, BoxedBase, priv);
+    if (!priv->check_is_instance(cx, "get a field"))
+        return false;
+
+    uint32_t packed =
+        gjs_dynamic_property_private_slot(&args.callee()).toPrivateUint32();
+    uint8_t* struct_ptr = priv->to_instance()->raw_ptr();
+
+    switch (direct_field_tag(packed)) {
+    case GI_TYPE_TAG_BOOLEAN:
+        args.rval().setBoolean(!!direct_field<gboolean>(struct_ptr, packed));
+        return true;
+    case GI_TYPE_TAG_INT8:
+        args.rval().setInt32(direct_field<int8_t>(struct_ptr, packed));
+        return true;
+    case GI_TYPE_TAG_UINT8:
+        args.rval().setInt32(direct_field<uint8_t>(struct_ptr, packed));
+        return true;
+    case GI_TYPE_TAG_INT16:
+        args.rval().setInt32(direct_field<int16_t>(struct_ptr, packed));
+        return true;
+    case GI_TYPE_TAG_UINT16:
+        args.rval().setInt32(direct_field<uint16_t>(struct_ptr, packed));
+        return true;
+    case GI_TYPE_TAG_INT32:
+        args.rval().setInt32(direct_field<int32_t>(struct_ptr, packed));
+        return true;
+    case GI_TYPE_TAG_UINT32:
+        args.rval().setNumber(direct_field<uint32_t>(struct_ptr, packed));
+        return true;
+    case GI_TYPE_TAG_FLOAT:
+        args.rval().setNumber(direct_field<float>(struct_ptr, packed));
+        return true;
+    case GI_TYPE_TAG_DOUBLE:
+        args.rval().setNumber(direct_field<double>(struct_ptr, packed));
+        return true;
+    default:
+        break;
+    }
+
+    g_assert_not_reached();
+    return false;
+}
+
+/*
+ * BoxedBase::direct_field_setter:
+ *
+ * JSNative property setter for scalar fields of simple structs. Equivalent to
+ * BoxedBase::field_setter(), but writes the memory directly. The conversions
+ * and range checks are the same as in gjs_value_to_g_argument(), and like
+ * there, a value that is out of range leaves the field unchanged.
+ */
+bool BoxedBase::direct_field_setter(JSContext* cx, unsigned argc,
+                                    JS::Value* vp) {
+    GJS_GET_WRAPPER_PRIV(cx, argc, vp, args, obj, BoxedBase, priv);
+    if (!priv->check_is_instance(cx, "set a field"))
+        return false;
+
+    uint32_t packed =
+        gjs_dynamic_property_private_slot(&args.callee()).toPrivateUint32();
+    uint8_t* struct_ptr = priv->to_instance()->raw_ptr();
+    GITypeTag tag = direct_field_tag(packed);
+    bool out_of_range = false;
+
+    switch (tag) {
+    case GI_TYPE_TAG_BOOLEAN:
+        direct_field<gboolean>(struct_ptr, packed) = JS::ToBoolean(args[0]);
+        break;
+    case GI_TYPE_TAG_INT8: {
+        int32_t i;
+        if (!JS::ToInt32(cx, args[0], &i))
+            return false;
+        out_of_range = (i > G_MAXINT8 || i < G_MININT8);
+        if (!out_of_range)
+            direct_field<int8_t>(struct_ptr, packed) = i;
+        break;
+    }
+    case GI_TYPE_TAG_UINT8: {
+        uint32_t i;
+        if (!JS::ToUint32(cx, args[0], &i))
+            return false;
+        out_of_range = (i > G_MAXUINT8);
+        if (!out_of_range)
+            direct_field<uint8_t>(struct_ptr, packed) = i;
+        break;
+    }
+    case GI_TYPE_TAG_INT16: {
+        int32_t i;
+        if (!JS::ToInt32(cx, args[0], &i))
+            return false;
+        out_of_range = (i > G_MAXINT16 || i < G_MININT16);
+        if (!out_of_range)
+            direct_field<int16_t>(struct_ptr, packed) = i;
+        break;
+    }
+    case GI_TYPE_TAG_UINT16: {
+        uint32_t i;
+        if (!JS::ToUint32(cx, args[0], &i))
+            return false;
+        out_of_range = (i > G_MAXUINT16);
+        if (!out_of_range)
+            direct_field<uint16_t>(struct_ptr, packed) = i;
+        break;
+    }
+    case GI_TYPE_TAG_INT32:
+        if (!JS::ToInt32(cx, args[0],
+                         &direct_field<int32_t>(struct_ptr, packed)))
+            return false;
+        break;
+    case GI_TYPE_TAG_UINT32: {
+        double v;
+        if (!JS::ToNumber(cx, args[0], &v))
+            return false;
+        out_of_range = (v > G_MAXUINT32 || v < 0);
+        if (!out_of_range)
+            direct_field<uint32_t>(struct_ptr, packed) =
+                CLAMP(v, 0, G_MAXUINT32);
+        break;
+    }
+    case GI_TYPE_TAG_FLOAT: {
+        double v;
+        if (!JS::ToNumber(cx, args[0], &v))
+            return false;
+        out_of_range = (v > G_MAXFLOAT || v < -G_MAXFLOAT);
+        if (!out_of_range)
+            direct_field<float>(struct_ptr, packed) = v;
+        break;
+    }
+    case GI_TYPE_TAG_DOUBLE:
+        if (!JS::ToNumber(cx, args[0],
+                          &direct_field<double>(struct_ptr, packed)))
+            return false;
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    if (G_UNLIKELY(out_of_range)) {
+        GjsAutoFieldInfo field_info =
+            priv->get_field_info(cx, direct_field_index(packed));
+        if (!field_info)
+            return false;
+        GjsAutoChar display_name =
+            gjs_argument_display_name(field_info.name(), GJS_ARGUMENT_FIELD);
+        gjs_throw(cx, "value is out of range for %s (type %s)",
+                  display_name.get(), g_type_tag_to_string(tag));
+        return false;
+    }
+
+    args.rval().setUndefined();  /* No stored value */
+    return true;
+}
+
 /*
  * BoxedPrototype::define_boxed_class_fields:
  *
@@ -711,6 +997,21 @@ bool BoxedPrototype::define_boxed_class_fields(JSContext* cx,
      */
     for (i = 0; i < n_fields; i++) {
         GjsAutoFieldInfo field = g_struct_info_get_field(info(), i);
+
+        // Scalar fields of simple structs get accessors that read and write
+        // the memory directly, see direct_field_pack()
+        uint32_t packed;
+        if (m_can_allocate_directly && direct_field_pack(field, i, &packed)) {
+            JS::RootedValue private_packed(cx, JS::PrivateUint32Value(packed));
+            if (!gjs_define_property_dynamic(
+                    cx, proto, field.name(), "boxed_field",
+                    &BoxedBase::direct_field_getter,
+                    &BoxedBase::direct_field_setter, private_packed,
+                    GJS_MODULE_PROP_FLAGS))
+                return false;
+            continue;
+        }
+
         JS::RootedValue private_id(cx, JS::PrivateUint32Value(i));
         if (!gjs_define_property_dynamic(cx, proto, field.name(), "boxed_field",
                                          &BoxedBase::field_getter,
@@ -882,7 +1183,15 @@ BoxedPrototype::BoxedPrototype(GIStructInfo* info, GType gtype)
       m_default_constructor(-1),
       m_default_constructor_name(JSID_VOID),
       m_field_map(nullptr),
-      m_can_allocate_directly(struct_is_simple(info)) {
+      m_inline_storage_size(0),
+      m_can_allocate_directly(struct_is_simple(info)),
+      m_marshals_arrays_as_views(false) {
+    if (m_can_allocate_directly) {
+        size_t size = g_struct_info_get_size(info);
+        if (size <= INLINE_STORAGE_MAX_SIZE)
+            m_inline_storage_size = size;
+    }
+
     GJS_INC_COUNTER(boxed_prototype);
 }
 
@@ -973,6 +1282,304 @@ bool BoxedPrototype::define_class(JSContext* context,
     return true;
 }
 
+/*
+ * Struct array views:
+ *
+ * While enabled for a simple struct type, with GObject.withStructArrayViews(),
+ * C arrays of that struct type are not marshalled as a JS array of separate
+ * boxed objects. Instead, the C array is copied once into an ArrayBuffer, and a
+ * view object exposes each scalar field as a typed array over that buffer. The
+ * typed array for a field starts at the field's offset and has a `stride`
+ * property, so that field `x` of element `i` is `view.x[i * view.x.stride]`.
+ * The view also has `length`, `buffer`, and `byteStride` properties, and can be
+ * passed back to C functions that take an array of the same struct type. Views
+ * can also be packed from JS structs with GObject.newStructArrayView().
+ */
+
+// clang-format off
+const JSClass BoxedPrototype::array_view_class = {
+    "GIStructArrayView",
+    JSCLASS_HAS_RESERVED_SLOTS(BoxedPrototype::ARRAY_VIEW_N_SLOTS)
+};
+// clang-format on
+
+using NewTypedArrayFunc = JSObject* (*)(JSContext*, JS::HandleObject, uint32_t,
+                                        int32_t);
+
+GJS_USE
+static NewTypedArrayFunc typed_array_constructor_for_field(
+    GIFieldInfo* field_info, size_t* element_size) {
+    GjsAutoTypeInfo type_info = g_field_info_get_type(field_info);
+    if (g_type_info_is_pointer(type_info))
+        return nullptr;
+
+    switch (g_type_info_get_tag(type_info)) {
+    case GI_TYPE_TAG_INT8:
+        *element_size = sizeof(int8_t);
+        return JS_NewInt8ArrayWithBuffer;
+    case GI_TYPE_TAG_UINT8:
+        *element_size = sizeof(uint8_t);
+        return JS_NewUint8ArrayWithBuffer;
+    case GI_TYPE_TAG_INT16:
+        *element_size = sizeof(int16_t);
+        return JS_NewInt16ArrayWithBuffer;
+    case GI_TYPE_TAG_UINT16:
+        *element_size = sizeof(uint16_t);
+        return JS_NewUint16ArrayWithBuffer;
+    case GI_TYPE_TAG_BOOLEAN:  // gboolean is an int
+    case GI_TYPE_TAG_INT32:
+        *element_size = sizeof(int32_t);
+        return JS_NewInt32ArrayWithBuffer;
+    case GI_TYPE_TAG_UINT32:
+        *element_size = sizeof(uint32_t);
+        return JS_NewUint32ArrayWithBuffer;
+    case GI_TYPE_TAG_FLOAT:
+        *element_size = sizeof(float);
+        return JS_NewFloat32ArrayWithBuffer;
+    case GI_TYPE_TAG_DOUBLE:
+        *element_size = sizeof(double);
+        return JS_NewFloat64ArrayWithBuffer;
+    default:
+        // No typed arrays for 64-bit integers, and nested structs or enums
+        // are not exposed as views
+        return nullptr;
+    }
+}
+
+/*
+ * BoxedPrototype::define_array_view_fields:
+ *
+ * Defines one typed array property on @view for each scalar field of the
+ * struct, all sharing @buffer which holds @length structs.
+ */
+bool BoxedPrototype::define_array_view_fields(JSContext* cx,
+                                              JS::HandleObject view,
+                                              JS::HandleObject buffer,
+                                              size_t length) {
+    size_t struct_size = g_struct_info_get_size(info());
+    size_t nbytes = struct_size * length;
+    int n_fields = g_struct_info_get_n_fields(info());
+
+    for (int i = 0; i < n_fields; i++) {
+        GjsAutoFieldInfo field = g_struct_info_get_field(info(), i);
+        size_t element_size;
+        NewTypedArrayFunc new_typed_array =
+            typed_array_constructor_for_field(field, &element_size);
+        if (!new_typed_array)
+            continue;
+
+        size_t offset = g_field_info_get_offset(field);
+        if (offset % element_size != 0 || struct_size % element_size != 0)
+            continue;  // packed struct, can't be expressed as a typed array
+
+        bool already_defined;
+        if (!JS_AlreadyHasOwnProperty(cx, view, field.name(),
+                                      &already_defined))
+            return false;
+        if (already_defined)
+            continue;  // don't shadow length, buffer, or byteStride
+
+        int32_t n_elements = length ? (nbytes - offset) / element_size : 0;
+        JS::RootedObject field_view(
+            cx, new_typed_array(cx, buffer, length ? offset : 0, n_elements));
+        if (!field_view ||
+            !JS_DefineProperty(cx, field_view, "stride",
+                               int32_t(struct_size / element_size),
+                               GJS_MODULE_PROP_FLAGS | JSPROP_READONLY) ||
+            !JS_DefineProperty(cx, view, field.name(), field_view,
+                               GJS_MODULE_PROP_FLAGS | JSPROP_READONLY))
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * BoxedPrototype::new_array_view:
+ * @proto: the prototype object that this is the private data of
+ * @buffer: ArrayBuffer holding @length structs
+ *
+ * Creates a struct array view (see above) over @buffer.
+ */
+bool BoxedPrototype::new_array_view(JSContext* cx, JS::HandleObject proto,
+                                    JS::HandleObject buffer, size_t length,
+                                    JS::MutableHandleValue value) {
+    JS::RootedObject view(cx, JS_NewObject(cx, &array_view_class));
+    if (!view)
+        return false;
+
+    JS_SetReservedSlot(view, ARRAY_VIEW_SLOT_BUFFER, JS::ObjectValue(*buffer));
+    JS_SetReservedSlot(view, ARRAY_VIEW_SLOT_PROTOTYPE,
+                       JS::ObjectValue(*proto));
+
+    const GjsAtoms& atoms = GjsContextPrivate::atoms(cx);
+    if (!JS_DefinePropertyById(cx, view, atoms.length(), double(length),
+                               GJS_MODULE_PROP_FLAGS | JSPROP_READONLY) ||
+        !JS_DefineProperty(cx, view, "buffer", buffer,
+                           GJS_MODULE_PROP_FLAGS | JSPROP_READONLY) ||
+        !JS_DefineProperty(cx, view, "byteStride",
+                           double(g_struct_info_get_size(info())),
+                           GJS_MODULE_PROP_FLAGS | JSPROP_READONLY) ||
+        !define_array_view_fields(cx, view, buffer, length))
+        return false;
+
+    value.setObject(*view);
+    return true;
+}
+
+/*
+ * BoxedPrototype::array_view_from_c_array:
+ * @info: introspection info for the element type of @array
+ * @array: C array of @length structs
+ * @value: return location for the view object
+ * @handled: return location for whether @info has views enabled; if not,
+ *   @value is untouched and the caller should marshal the array as usual
+ *
+ * Creates a struct array view (see above) for @array, if the struct type has
+ * opted in to it.
+ */
+bool BoxedPrototype::array_view_from_c_array(JSContext* cx, GIStructInfo* info,
+                                             void* array, size_t length,
+                                             JS::MutableHandleValue value,
+                                             bool* handled) {
+    *handled = false;
+
+    // Almost no struct types opt in, so don't look up their prototypes
+    if (!GjsContextPrivate::from_cx(cx)->any_struct_array_views())
+        return true;
+
+    JS::RootedObject proto(cx, gjs_lookup_generic_prototype(cx, info));
+    if (!proto)
+        return false;
+
+    BoxedBase* proto_base = BoxedBase::for_js(cx, proto);
+    if (!proto_base || !proto_base->is_prototype())
+        return true;
+    BoxedPrototype* priv = proto_base->to_prototype();
+    if (!priv->marshals_arrays_as_views())
+        return true;
+
+    *handled = true;
+
+    if (!array)
+        length = 0;
+    size_t nbytes = g_struct_info_get_size(info) * length;
+    JS::RootedObject buffer(cx);
+    if (nbytes > 0)
+        buffer = JS_NewArrayBufferWithContents(cx, nbytes,
+                                               g_memdup(array, nbytes));
+    else
+        buffer = JS_NewArrayBuffer(cx, 0);
+    if (!buffer)
+        return false;
+
+    return priv->new_array_view(cx, proto, buffer, length, value);
+}
+
+/*
+ * BoxedPrototype::array_view_from_structs:
+ * @proto: the prototype object that this is the private data of
+ * @structs: JS array of instances of this struct type
+ * @value: return location for the view object
+ *
+ * Creates a struct array view (see above) holding copies of @structs.
+ */
+bool BoxedPrototype::array_view_from_structs(JSContext* cx,
+                                             JS::HandleObject proto,
+                                             JS::HandleObject structs,
+                                             JS::MutableHandleValue value) {
+    bool is_array;
+    if (!JS_IsArrayObject(cx, structs, &is_array))
+        return false;
+    if (!is_array) {
+        gjs_throw(cx, "Expected an array of %s.%s", ns(), name());
+        return false;
+    }
+
+    uint32_t length;
+    if (!JS_GetArrayLength(cx, structs, &length))
+        return false;
+
+    size_t struct_size = g_struct_info_get_size(info());
+    size_t nbytes = struct_size * length;
+    GjsAutoPointer<uint8_t, void, g_free> contents(
+        static_cast<uint8_t*>(g_malloc0(nbytes)));
+
+    JS::RootedValue elem(cx);
+    JS::RootedObject elem_obj(cx);
+    for (uint32_t ix = 0; ix < length; ix++) {
+        if (!JS_GetElement(cx, structs, ix, &elem))
+            return false;
+        if (!elem.isObject()) {
+            gjs_throw(cx, "Element %u is not a %s.%s", ix, ns(), name());
+            return false;
+        }
+        elem_obj = &elem.toObject();
+        if (!BoxedBase::typecheck(cx, elem_obj, info(), gtype()))
+            return false;
+        void* ptr = BoxedBase::to_c_ptr(cx, elem_obj);
+        if (!ptr)
+            return false;
+        memcpy(contents.get() + struct_size * ix, ptr, struct_size);
+    }
+
+    JS::RootedObject buffer(cx);
+    if (nbytes > 0)
+        buffer = JS_NewArrayBufferWithContents(cx, nbytes, contents.release());
+    else
+        buffer = JS_NewArrayBuffer(cx, 0);
+    if (!buffer)
+        return false;
+
+    return new_array_view(cx, proto, buffer, length, value);
+}
+
+/*
+ * BoxedPrototype::array_view_to_c_array:
+ * @view: object to convert
+ * @info: introspection info for the expected element type
+ * @contents: return location for a newly allocated C array, free with g_free()
+ * @length: return location for the number of structs in @contents
+ * @handled: return location for whether @view is a struct array view; if not,
+ *   the out parameters are untouched and the caller should marshal the array as
+ *   usual
+ *
+ * Copies the contents of a struct array view (see above) back into a C array.
+ * Throws if @view is a struct array view of a different struct type.
+ */
+bool BoxedPrototype::array_view_to_c_array(JSContext* cx,
+                                           JS::HandleObject view,
+                                           GIStructInfo* info, void** contents,
+                                           size_t* length, bool* handled) {
+    *handled = false;
+    if (JS_GetClass(view) != &array_view_class)
+        return true;
+
+    *handled = true;
+
+    JS::RootedObject proto(
+        cx, &JS_GetReservedSlot(view, ARRAY_VIEW_SLOT_PROTOTYPE).toObject());
+    BoxedBase* priv = BoxedBase::for_js(cx, proto);
+    g_assert(priv && priv->is_prototype());
+    if (!g_base_info_equal(priv->info(), info)) {
+        gjs_throw(cx, "Expected an array of %s.%s, got an array of %s.%s",
+                  g_base_info_get_namespace(info), g_base_info_get_name(info),
+                  priv->ns(), priv->name());
+        return false;
+    }
+
+    JSObject* buffer =
+        &JS_GetReservedSlot(view, ARRAY_VIEW_SLOT_BUFFER).toObject();
+    uint32_t nbytes;
+    bool is_shared_memory;
+    uint8_t* data;
+    js::GetArrayBufferLengthAndData(buffer, &nbytes, &is_shared_memory, &data);
+
+    *length = nbytes / g_struct_info_get_size(info);
+    *contents = nbytes > 0 ? g_memdup(data, nbytes) : nullptr;
+    return true;
+}
+
 /* Helper function to make the public API more readable. The overloads are
  * specified explicitly in the public API, but the implementation uses
  * std::forward in order to avoid duplicating code. */
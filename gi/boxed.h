@@ -24,6 +24,7 @@
 #ifndef GI_BOXED_H_
 #define GI_BOXED_H_
 
+#include <stddef.h>  // for size_t
 #include <stdint.h>
 
 #include <girepository.h>
@@ -68,6 +69,12 @@ class BoxedBase
     static bool field_getter(JSContext* cx, unsigned argc, JS::Value* vp);
     GJS_JSAPI_RETURN_CONVENTION
     static bool field_setter(JSContext* cx, unsigned argc, JS::Value* vp);
+    GJS_JSAPI_RETURN_CONVENTION
+    static bool direct_field_getter(JSContext* cx, unsigned argc,
+                                    JS::Value* vp);
+    GJS_JSAPI_RETURN_CONVENTION
+    static bool direct_field_setter(JSContext* cx, unsigned argc,
+                                    JS::Value* vp);
 
     // Helper methods that work on either instances or prototypes
 
@@ -95,7 +102,10 @@ class BoxedPrototype : public GIWrapperPrototype<BoxedBase, BoxedPrototype,
     int m_default_constructor;  // -1 if none
     JS::Heap<jsid> m_default_constructor_name;
     FieldMap* m_field_map;
+    uint32_t m_inline_storage_size;  // 0 if instances store the struct out of
+                                     // line
     bool m_can_allocate_directly : 1;
+    bool m_marshals_arrays_as_views : 1;
 
     explicit BoxedPrototype(GIStructInfo* info, GType gtype);
     ~BoxedPrototype(void);
@@ -104,12 +114,26 @@ class BoxedPrototype : public GIWrapperPrototype<BoxedBase, BoxedPrototype,
 
     static constexpr InfoType::Tag info_type_tag = InfoType::Struct;
 
+    // Simple structs up to this size are stored in the same allocation as
+    // their BoxedInstance, see BoxedInstance::new_for_js_object().
+    static constexpr size_t INLINE_STORAGE_MAX_SIZE = 32;
+
     // Accessors
 
  public:
     GJS_USE
     bool can_allocate_directly(void) const { return m_can_allocate_directly; }
     GJS_USE
+    size_t inline_storage_size(void) const { return m_inline_storage_size; }
+    GJS_USE
+    bool marshals_arrays_as_views(void) const {
+        return m_marshals_arrays_as_views;
+    }
+    void set_marshals_arrays_as_views(bool enabled) {
+        g_assert(!enabled || m_can_allocate_directly);
+        m_marshals_arrays_as_views = enabled;
+    }
+    GJS_USE
     bool has_zero_args_constructor(void) const {
         return m_zero_args_constructor >= 0;
     }
@@ -151,6 +175,39 @@ class BoxedPrototype : public GIWrapperPrototype<BoxedBase, BoxedPrototype,
                              GIStructInfo* info);
     GJS_JSAPI_RETURN_CONVENTION
     GIFieldInfo* lookup_field(JSContext* cx, JSString* prop_name);
+
+    // Struct-of-arrays views over C arrays of simple structs
+
+ private:
+    static const JSClass array_view_class;
+    enum ArrayViewSlot : unsigned {
+        ARRAY_VIEW_SLOT_BUFFER,
+        ARRAY_VIEW_SLOT_PROTOTYPE,
+        ARRAY_VIEW_N_SLOTS
+    };
+
+    GJS_JSAPI_RETURN_CONVENTION
+    bool define_array_view_fields(JSContext* cx, JS::HandleObject view,
+                                  JS::HandleObject buffer, size_t length);
+    GJS_JSAPI_RETURN_CONVENTION
+    bool new_array_view(JSContext* cx, JS::HandleObject proto,
+                        JS::HandleObject buffer, size_t length,
+                        JS::MutableHandleValue value);
+
+ public:
+    GJS_JSAPI_RETURN_CONVENTION
+    static bool array_view_from_c_array(JSContext* cx, GIStructInfo* info,
+                                        void* array, size_t length,
+                                        JS::MutableHandleValue value,
+                                        bool* handled);
+    GJS_JSAPI_RETURN_CONVENTION
+    bool array_view_from_structs(JSContext* cx, JS::HandleObject proto,
+                                 JS::HandleObject structs,
+                                 JS::MutableHandleValue value);
+    GJS_JSAPI_RETURN_CONVENTION
+    static bool array_view_to_c_array(JSContext* cx, JS::HandleObject view,
+                                      GIStructInfo* info, void** contents,
+                                      size_t* length, bool* handled);
 };
 
 class BoxedInstance
@@ -160,12 +217,24 @@ class BoxedInstance
     friend class BoxedBase;  // for field_getter, etc.
 
     bool m_allocated_directly : 1;
+    bool m_allocated_inline : 1;  // if set, m_ptr points to inline_storage()
     bool m_owning_ptr : 1;  // if set, the JS wrapper owns the C memory referred
                             // to by m_ptr.
 
     explicit BoxedInstance(JSContext* cx, JS::HandleObject obj);
     ~BoxedInstance(void);
 
+    // Inline storage for small simple structs is allocated directly after the
+    // BoxedInstance itself.
+    GJS_USE
+    static size_t allocation_size(const BoxedPrototype* proto) {
+        return sizeof(BoxedInstance) + proto->inline_storage_size();
+    }
+    GJS_USE
+    void* inline_storage(void) {
+        return reinterpret_cast<uint8_t*>(this) + sizeof(BoxedInstance);
+    }
+
     // Don't set GIWrapperBase::m_ptr directly. Instead, use one of these
     // setters to express your intention to own the pointer or not.
     void own_ptr(void* boxed_ptr) {
@@ -220,11 +289,19 @@ class BoxedInstance
     bool constructor_impl(JSContext* cx, JS::HandleObject obj,
                           const JS::CallArgs& args);
 
+    // JSClass operations
+
+    void finalize_impl(JSFreeOp* fop, JSObject* obj);
+
     // Public API for initializing BoxedInstance JS object from C struct
 
  public:
     struct NoCopy {};
 
+    GJS_USE
+    static BoxedInstance* new_for_js_object(JSContext* cx,
+                                            JS::HandleObject obj);
+
  private:
     GJS_JSAPI_RETURN_CONVENTION
     bool init_from_c_struct(JSContext* cx, void* gboxed);
@@ -44,11 +44,16 @@ static struct {
 
 static GHashTable* foreign_structs_table = NULL;
 
+/* Lookup cache in front of foreign_structs_table. Keyed on the namespace string
+ * and then on the name string of the GIBaseInfo; both point into the typelib,
+ * so they are the same pointers for every GIBaseInfo describing a given type,
+ * and can be hashed directly without formatting a "namespace.name" string. */
+static GHashTable* foreign_structs_by_info = NULL;
+
 GJS_USE
 static GHashTable*
 get_foreign_structs(void)
 {
-    // FIXME: look into hasing on GITypeInfo instead.
     if (!foreign_structs_table) {
         foreign_structs_table = g_hash_table_new_full(g_str_hash, g_str_equal,
                                      (GDestroyNotify)g_free,
@@ -58,6 +63,40 @@ get_foreign_structs(void)
     return foreign_structs_table;
 }
 
+GJS_USE
+static GjsForeignInfo* lookup_cached_foreign_info(GIBaseInfo* interface_info) {
+    if (!foreign_structs_by_info)
+        return nullptr;
+
+    auto* by_name = static_cast<GHashTable*>(g_hash_table_lookup(
+        foreign_structs_by_info, g_base_info_get_namespace(interface_info)));
+    if (!by_name)
+        return nullptr;
+
+    return static_cast<GjsForeignInfo*>(
+        g_hash_table_lookup(by_name, g_base_info_get_name(interface_info)));
+}
+
+static void cache_foreign_info(GIBaseInfo* interface_info,
+                               GjsForeignInfo* info) {
+    if (!foreign_structs_by_info)
+        foreign_structs_by_info = g_hash_table_new_full(
+            nullptr, nullptr, nullptr, (GDestroyNotify)g_hash_table_unref);
+
+    const char* ns = g_base_info_get_namespace(interface_info);
+    auto* by_name = static_cast<GHashTable*>(
+        g_hash_table_lookup(foreign_structs_by_info, ns));
+    if (!by_name) {
+        by_name = g_hash_table_new(nullptr, nullptr);
+        g_hash_table_insert(foreign_structs_by_info, const_cast<char*>(ns),
+                            by_name);
+    }
+
+    g_hash_table_insert(by_name,
+                        const_cast<char*>(g_base_info_get_name(interface_info)),
+                        info);
+}
+
 GJS_USE
 static bool
 gjs_foreign_load_foreign_module(JSContext *context,
@@ -102,6 +141,9 @@ void gjs_struct_foreign_register(const char* gi_namespace,
 
     canonical_name = g_strdup_printf("%s.%s", gi_namespace, type_name);
     g_hash_table_insert(get_foreign_structs(), canonical_name, info);
+
+    // A registration may replace an earlier one, so start the cache afresh
+    g_clear_pointer(&foreign_structs_by_info, g_hash_table_unref);
 }
 
 GJS_USE
@@ -113,6 +155,10 @@ gjs_struct_foreign_lookup(JSContext  *context,
     GHashTable *hash_table;
     char *key;
 
+    retval = lookup_cached_foreign_info(interface_info);
+    if (retval)
+        return retval;
+
     key = g_strdup_printf("%s.%s",
                           g_base_info_get_namespace(interface_info),
                           g_base_info_get_name(interface_info));
@@ -124,7 +170,9 @@ gjs_struct_foreign_lookup(JSContext  *context,
         }
     }
 
-    if (!retval) {
+    if (retval) {
+        cache_foreign_info(interface_info, retval);
+    } else {
         gjs_throw(context, "Unable to find module implementing foreign type %s.%s",
                   g_base_info_get_namespace(interface_info),
                   g_base_info_get_name(interface_info));
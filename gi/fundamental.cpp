@@ -118,7 +118,7 @@ bool FundamentalPrototype::resolve_interface(JSContext* cx,
     interfaces = g_type_interfaces(gtype(), &n_interfaces);
     for (i = 0; i < n_interfaces; i++) {
         GjsAutoInterfaceInfo iface_info =
-            g_irepository_find_by_gtype(nullptr, interfaces[i]);
+            gjs_lookup_gtype_info(interfaces[i]);
 
         if (!iface_info)
             continue;
@@ -364,7 +364,7 @@ gjs_lookup_fundamental_prototype_from_gtype(JSContext *context,
      * data. If that's the case, try to look for a definition of any of the
      * parent type. */
     while (gtype != G_TYPE_INVALID &&
-           !(info = g_irepository_find_by_gtype(nullptr, gtype)))
+           !(info = gjs_lookup_gtype_info(gtype)))
         gtype = g_type_parent(gtype);
 
     return gjs_lookup_fundamental_prototype(context, info, gtype);
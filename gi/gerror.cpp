@@ -35,13 +35,16 @@
 #include "gjs/atoms.h"
 #include "gjs/context-private.h"
 #include "gjs/error-types.h"
+#include "gjs/jsapi-class.h"
+#include "gjs/jsapi-util-args.h"
 #include "gjs/jsapi-util.h"
 #include "gjs/mem-private.h"
 #include "util/log.h"
 
 ErrorPrototype::ErrorPrototype(GIEnumInfo* info, GType gtype)
     : GIWrapperPrototype(info, gtype),
-      m_domain(g_quark_from_string(g_enum_info_get_error_domain(info))) {
+      m_domain(g_quark_from_string(g_enum_info_get_error_domain(info))),
+      m_captures_stack(true) {
     GJS_INC_COUNTER(gerror_prototype);
 }
 
@@ -183,6 +186,55 @@ bool ErrorBase::value_of(JSContext* context, unsigned argc, JS::Value* vp) {
     return true;
 }
 
+/*
+ * ErrorBase::set_capture_stack:
+ *
+ * JSNative implementation of `setCaptureStack(enabled, [code])` on error
+ * domain constructors. Code that uses exceptions for expected conditions, such
+ * as Gio.IOErrorEnum.NOT_FOUND, can turn off capturing a JS stack for those
+ * errors, either for one code or for the whole domain if no code is given.
+ * Such errors don't get stack, fileName, lineNumber, and columnNumber
+ * properties.
+ */
+bool ErrorBase::set_capture_stack(JSContext* cx, unsigned argc,
+                                  JS::Value* vp) {
+    GJS_GET_THIS(cx, argc, vp, args, self);
+    const GjsAtoms& atoms = GjsContextPrivate::atoms(cx);
+
+    // The optional code is checked separately, because undefined means the
+    // whole domain
+    bool enabled;
+    if (!gjs_parse_call_args(cx, "setCaptureStack", args, "!b", "enabled",
+                             &enabled))
+        return false;
+
+    JS::RootedObject prototype(cx);
+    if (!gjs_object_require_property(cx, self, "constructor",
+                                     atoms.prototype(), &prototype))
+        return false;
+
+    ErrorBase* priv = ErrorBase::for_js_typecheck(cx, prototype, args);
+    if (!priv)
+        return false;
+    ErrorPrototype* proto_priv = priv->to_prototype();
+
+    if (args.get(1).isUndefined()) {
+        proto_priv->m_captures_stack = enabled;
+        proto_priv->m_codes_without_stack.clear();
+    } else {
+        int32_t code;
+        if (!JS::ToInt32(cx, args[1], &code))
+            return false;
+        if (enabled)
+            proto_priv->m_codes_without_stack.erase(code);
+        else
+            proto_priv->m_codes_without_stack.insert(code);
+    }
+
+    args.rval().setUndefined();
+    return true;
+}
+
 // clang-format off
 const struct JSClassOps ErrorBase::class_ops = {
     nullptr,  // addProperty
@@ -211,6 +263,8 @@ JSPropertySpec ErrorBase::proto_properties[] = {
 
 JSFunctionSpec ErrorBase::static_methods[] = {
     JS_FN("valueOf", &ErrorBase::value_of, 0, GJS_MODULE_PROP_FLAGS),
+    JS_FN("setCaptureStack", &ErrorBase::set_capture_stack, 1,
+          GJS_MODULE_PROP_FLAGS),
     JS_FS_END
 };
 // clang-format on
@@ -275,18 +329,60 @@ find_error_domain_info(GQuark domain)
     return info;
 }
 
+/* Replaces the lazy `stack` accessor with a plain data property */
+GJS_JSAPI_RETURN_CONVENTION
+static bool define_error_stack_value(JSContext* cx, JS::HandleObject obj,
+                                     JS::HandleValue stack) {
+    const GjsAtoms& atoms = GjsContextPrivate::atoms(cx);
+    return JS_DefinePropertyById(cx, obj, atoms.stack(), stack,
+                                 JSPROP_ENUMERATE);
+}
+
+/* Dynamic property getter for `stack`; formats the captured SavedFrame, which
+ * is the property's private slot, on first access only */
+GJS_JSAPI_RETURN_CONVENTION
+static bool error_stack_getter(JSContext* cx, unsigned argc, JS::Value* vp) {
+    GJS_GET_THIS(cx, argc, vp, args, obj);
+
+    JS::RootedObject frame(
+        cx, &gjs_dynamic_property_private_slot(&args.callee()).toObject());
+    JS::RootedString stack(cx);
+    if (!JS::BuildStackString(cx, frame, &stack))
+        return false;
+
+    args.rval().setString(stack);
+    return define_error_stack_value(cx, obj, args.rval());
+}
+
+/* JSNative setter for `stack`, so that it stays writable like a JS Error's */
+GJS_JSAPI_RETURN_CONVENTION
+static bool error_stack_setter(JSContext* cx, unsigned argc, JS::Value* vp) {
+    GJS_GET_THIS(cx, argc, vp, args, obj);
+    if (!define_error_stack_value(cx, obj, args.get(0)))
+        return false;
+    args.rval().setUndefined();
+    return true;
+}
+
 /* define properties that JS Error() expose, such as
-   fileName, lineNumber and stack
+   fileName, lineNumber and stack.
+
+   Capturing the SavedFrame is cheap, but formatting it into a string is not,
+   so `stack` is an accessor that only formats the string when it is read. If
+   the error's domain opted out with setCaptureStack(), nothing is captured.
 */
 GJS_JSAPI_RETURN_CONVENTION
 bool gjs_define_error_properties(JSContext* cx, JS::HandleObject obj) {
+    ErrorBase* priv = ErrorBase::for_js(cx, obj);
+    if (priv && !priv->is_prototype() &&
+        !priv->get_prototype()->captures_stack(priv->to_instance()->code()))
+        return true;
+
     JS::RootedObject frame(cx);
-    JS::RootedString stack(cx);
     JS::RootedString source(cx);
     uint32_t line, column;
 
-    if (!JS::CaptureCurrentStack(cx, &frame) ||
-        !JS::BuildStackString(cx, frame, &stack))
+    if (!JS::CaptureCurrentStack(cx, &frame))
         return false;
 
     auto ok = JS::SavedFrameResult::Ok;
@@ -297,9 +393,11 @@ bool gjs_define_error_properties(JSContext* cx, JS::HandleObject obj) {
         return false;
     }
 
+    JS::RootedValue frame_value(cx, JS::ObjectValue(*frame));
     const GjsAtoms& atoms = GjsContextPrivate::atoms(cx);
-    return JS_DefinePropertyById(cx, obj, atoms.stack(), stack,
-                                 JSPROP_ENUMERATE) &&
+    return gjs_define_property_dynamic(cx, obj, "stack", "gerror",
+                                       error_stack_getter, error_stack_setter,
+                                       frame_value, JSPROP_ENUMERATE) &&
            JS_DefinePropertyById(cx, obj, atoms.file_name(), source,
                                  JSPROP_ENUMERATE) &&
            JS_DefinePropertyById(cx, obj, atoms.line_number(), line,
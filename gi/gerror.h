@@ -24,6 +24,8 @@
 #ifndef GI_GERROR_H_
 #define GI_GERROR_H_
 
+#include <unordered_set>
+
 #include <girepository.h>
 #include <glib-object.h>
 #include <glib.h>
@@ -87,6 +89,8 @@ class ErrorBase
 
     GJS_JSAPI_RETURN_CONVENTION
     static bool value_of(JSContext* cx, unsigned argc, JS::Value* vp);
+    GJS_JSAPI_RETURN_CONVENTION
+    static bool set_capture_stack(JSContext* cx, unsigned argc, JS::Value* vp);
 
  public:
     GJS_JSAPI_RETURN_CONVENTION
@@ -117,6 +121,9 @@ class ErrorPrototype : public GIWrapperPrototype<ErrorBase, ErrorPrototype,
     friend class GIWrapperBase<ErrorBase, ErrorPrototype, ErrorInstance>;
 
     GQuark m_domain;
+    // Error codes for which no JS stack is captured, see set_capture_stack()
+    std::unordered_set<int> m_codes_without_stack;
+    bool m_captures_stack : 1;
 
     static constexpr InfoType::Tag info_type_tag = InfoType::Enum;
 
@@ -128,6 +135,9 @@ class ErrorPrototype : public GIWrapperPrototype<ErrorBase, ErrorPrototype,
 
  public:
     GJS_USE GQuark domain(void) const { return m_domain; }
+    GJS_USE bool captures_stack(int code) const {
+        return m_captures_stack && m_codes_without_stack.count(code) == 0;
+    }
 
     GJS_JSAPI_RETURN_CONVENTION
     static bool define_class(JSContext* cx, JS::HandleObject in_object,
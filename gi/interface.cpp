@@ -145,7 +145,7 @@ gjs_lookup_interface_constructor(JSContext             *context,
     JSObject *constructor;
     GIBaseInfo *interface_info;
 
-    interface_info = g_irepository_find_by_gtype(nullptr, gtype);
+    interface_info = gjs_lookup_gtype_info(gtype);
 
     if (!interface_info) {
         gjs_throw(context, "Cannot expose non introspectable interface %s",
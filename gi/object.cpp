@@ -653,7 +653,7 @@ bool ObjectPrototype::resolve_no_info(JSContext* cx, JS::HandleObject obj,
     GType *interfaces = g_type_interfaces(m_gtype, &n_interfaces);
     for (i = 0; i < n_interfaces; i++) {
         GjsAutoInterfaceInfo iface_info =
-            g_irepository_find_by_gtype(nullptr, interfaces[i]);
+            gjs_lookup_gtype_info(interfaces[i]);
         if (!iface_info)
             continue;
 
@@ -866,7 +866,7 @@ bool ObjectPrototype::new_enumerate_impl(JSContext* cx, JS::HandleObject,
 
     for (unsigned k = 0; k < n_interfaces; k++) {
         GjsAutoInterfaceInfo iface_info =
-            g_irepository_find_by_gtype(nullptr, interfaces[k]);
+            gjs_lookup_gtype_info(interfaces[k]);
 
         if (!iface_info) {
             continue;
@@ -1674,7 +1674,7 @@ static JSObject *
 gjs_lookup_object_prototype(JSContext *context,
                             GType      gtype)
 {
-    GjsAutoObjectInfo info = g_irepository_find_by_gtype(nullptr, gtype);
+    GjsAutoObjectInfo info = gjs_lookup_gtype_info(gtype);
     return gjs_lookup_object_prototype_from_info(context, info, gtype);
 }
 
@@ -2245,7 +2245,7 @@ bool ObjectPrototype::hook_up_vfunc_impl(JSContext* cx,
     while (!info && info_gtype != G_TYPE_OBJECT) {
         info_gtype = g_type_parent(info_gtype);
 
-        info = g_irepository_find_by_gtype(nullptr, info_gtype);
+        info = gjs_lookup_gtype_info(info_gtype);
     }
 
     /* If we don't have 'info', we don't have the base class (GObject).
@@ -2262,7 +2262,7 @@ bool ObjectPrototype::hook_up_vfunc_impl(JSContext* cx,
 
         for (i = 0; i < n_interfaces; i++) {
             GjsAutoInterfaceInfo interface =
-                g_irepository_find_by_gtype(nullptr, interface_list[i]);
+                gjs_lookup_gtype_info(interface_list[i]);
 
             /* The interface doesn't have to exist -- it could be private
              * or dynamic. */
@@ -2318,7 +2318,7 @@ gjs_lookup_object_constructor(JSContext             *context,
 {
     JSObject *constructor;
 
-    GjsAutoObjectInfo object_info = g_irepository_find_by_gtype(nullptr, gtype);
+    GjsAutoObjectInfo object_info = gjs_lookup_gtype_info(gtype);
 
     constructor = gjs_lookup_object_constructor_from_info(context, object_info, gtype);
 
@@ -71,7 +71,7 @@ param_resolve(JSContext       *context,
         return true; /* not resolved, but no error */
     }
 
-    GjsAutoObjectInfo info = g_irepository_find_by_gtype(nullptr, G_TYPE_PARAM);
+    GjsAutoObjectInfo info = gjs_lookup_gtype_info(G_TYPE_PARAM);
     GjsAutoFunctionInfo method_info =
         g_object_info_find_method(info, name.get());
 
@@ -201,7 +201,7 @@ gjs_define_param_class(JSContext       *context,
     if (!gjs_wrapper_define_gtype_prop(context, constructor, G_TYPE_PARAM))
         return false;
 
-    GjsAutoObjectInfo info = g_irepository_find_by_gtype(nullptr, G_TYPE_PARAM);
+    GjsAutoObjectInfo info = gjs_lookup_gtype_info(G_TYPE_PARAM);
     if (!gjs_define_static_methods<InfoType::Object>(context, constructor,
                                                      G_TYPE_PARAM, info))
         return false;
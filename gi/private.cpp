@@ -29,6 +29,7 @@
 
 #include "gjs/jsapi-wrapper.h"
 
+#include "gi/boxed.h"
 #include "gi/gobject.h"
 #include "gi/gtype.h"
 #include "gi/interface.h"
@@ -406,6 +407,86 @@ static bool gjs_signal_new(JSContext* cx, unsigned argc, JS::Value* vp) {
     return true;
 }
 
+/* Gets the prototype of a struct type whose arrays can be views, and its
+ * private data; throws if @constructor is not one */
+GJS_JSAPI_RETURN_CONVENTION
+static BoxedPrototype* simple_struct_prototype(JSContext* cx,
+                                               JS::HandleObject constructor,
+                                               const char* func_name,
+                                               JS::MutableHandleObject proto) {
+    const GjsAtoms& atoms = GjsContextPrivate::atoms(cx);
+    if (!gjs_object_require_property(cx, constructor, "struct constructor",
+                                     atoms.prototype(), proto))
+        return nullptr;
+
+    BoxedBase* priv = BoxedBase::for_js(cx, proto);
+    if (!priv || !priv->is_prototype()) {
+        gjs_throw(cx, "%s() expects a struct type", func_name);
+        return nullptr;
+    }
+
+    BoxedPrototype* proto_priv = priv->to_prototype();
+    if (!proto_priv->can_allocate_directly()) {
+        gjs_throw(cx,
+                  "Struct array views are only supported for structs with "
+                  "only non-pointer fields, not %s.%s",
+                  proto_priv->ns(), proto_priv->name());
+        return nullptr;
+    }
+
+    return proto_priv;
+}
+
+/* Returns whether views were enabled before, so that callers can restore it */
+GJS_JSAPI_RETURN_CONVENTION
+static bool gjs_set_struct_array_views(JSContext* cx, unsigned argc,
+                                       JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+
+    JSAutoRequest ar(cx);
+
+    JS::RootedObject constructor(cx), prototype(cx);
+    bool enabled;
+    if (!gjs_parse_call_args(cx, "set_struct_array_views", args, "ob",
+                             "constructor", &constructor, "enabled", &enabled))
+        return false;
+
+    BoxedPrototype* proto_priv = simple_struct_prototype(
+        cx, constructor, "set_struct_array_views", &prototype);
+    if (!proto_priv)
+        return false;
+
+    bool was_enabled = proto_priv->marshals_arrays_as_views();
+    if (enabled != was_enabled) {
+        proto_priv->set_marshals_arrays_as_views(enabled);
+        GjsContextPrivate::from_cx(cx)->count_struct_array_views(enabled);
+    }
+
+    args.rval().setBoolean(was_enabled);
+    return true;
+}
+
+GJS_JSAPI_RETURN_CONVENTION
+static bool gjs_new_struct_array_view(JSContext* cx, unsigned argc,
+                                      JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+
+    JSAutoRequest ar(cx);
+
+    JS::RootedObject constructor(cx), structs(cx), prototype(cx);
+    if (!gjs_parse_call_args(cx, "new_struct_array_view", args, "oo",
+                             "constructor", &constructor, "structs", &structs))
+        return false;
+
+    BoxedPrototype* proto_priv = simple_struct_prototype(
+        cx, constructor, "new_struct_array_view", &prototype);
+    if (!proto_priv)
+        return false;
+
+    return proto_priv->array_view_from_structs(cx, prototype, structs,
+                                               args.rval());
+}
+
 GJS_JSAPI_RETURN_CONVENTION
 static bool hook_up_vfunc_symbol_getter(JSContext* cx, unsigned argc,
                                         JS::Value* vp) {
@@ -420,6 +501,10 @@ static JSFunctionSpec module_funcs[] = {
     JS_FN("register_interface", gjs_register_interface, 3,
           GJS_MODULE_PROP_FLAGS),
     JS_FN("register_type", gjs_register_type, 4, GJS_MODULE_PROP_FLAGS),
+    JS_FN("new_struct_array_view", gjs_new_struct_array_view, 2,
+          GJS_MODULE_PROP_FLAGS),
+    JS_FN("set_struct_array_views", gjs_set_struct_array_views, 2,
+          GJS_MODULE_PROP_FLAGS),
     JS_FN("signal_new", gjs_signal_new, 6, GJS_MODULE_PROP_FLAGS),
     JS_FS_END,
 };
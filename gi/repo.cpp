@@ -45,6 +45,7 @@
 #include "gjs/atoms.h"
 #include "gjs/context-private.h"
 #include "gjs/global.h"
+#include "gjs/import-profile.h"
 #include "gjs/jsapi-class.h"
 #include "gjs/jsapi-util.h"
 #include "gjs/mem-private.h"
@@ -115,9 +116,14 @@ static bool resolve_namespace_object(JSContext* context,
     }
     g_list_free_full(versions, g_free);
 
+    GjsAutoImportEvent event(context, GjsImportProfile::NAMESPACE,
+                             ns_name.get());
+
     error = NULL;
+    GjsAutoImportPhase load(context, GjsImportProfile::LOAD_TYPELIB);
     g_irepository_require(nullptr, ns_name.get(), version.get(),
                           GIRepositoryLoadFlags(0), &error);
+    load.stop();
     if (error != NULL) {
         gjs_throw(context, "Requiring %s, version %s: %s", ns_name.get(),
                   version ? version.get() : "none", error->message);
@@ -144,11 +150,13 @@ static bool resolve_namespace_object(JSContext* context,
         return false;
 
     JS::RootedValue result(context);
+    GjsAutoImportPhase execute(context, GjsImportProfile::EXECUTE);
     if (!override.isUndefined() &&
         !JS_CallFunctionValue (context, gi_namespace, /* thisp */
                                override, /* callee */
                                JS::HandleValueArray::empty(), &result))
         return false;
+    execute.stop();
 
     gjs_debug(GJS_DEBUG_GNAMESPACE,
               "Defined namespace '%s' %p in GIRepository %p", ns_name.get(),
@@ -414,6 +422,14 @@ gjs_define_info(JSContext       *context,
     _gjs_log_info_usage(info);
 #endif
 
+    GjsAutoChar profile_name;
+    if (GjsContextPrivate::from_cx(context)->import_profile().enabled())
+        profile_name = g_strdup_printf("%s.%s", g_base_info_get_namespace(info),
+                                       g_base_info_get_name(info));
+    GjsAutoImportEvent event(context, GjsImportProfile::INFO,
+                             profile_name ? profile_name.get()
+                                          : g_base_info_get_name(info));
+
     *defined = true;
 
     switch (g_base_info_get_type(info)) {
@@ -787,3 +803,82 @@ JSObject* gjs_new_object_with_generic_prototype(JSContext* cx,
 
     return JS_NewObjectWithGivenProto(cx, JS_GetClass(proto), proto);
 }
+
+/*
+ * GType to introspection info cache:
+ *
+ * g_irepository_find_by_gtype() is called on many hot paths, and each call
+ * takes the repository's lock and searches the typelibs' directories. This
+ * process-wide cache remembers the info found for a GType; infos never become
+ * invalid. GTypes without introspection info (such as types defined in JS) are
+ * not cached here, because loading a typelib can give them some, and
+ * GIRepository already remembers those misses until it loads one.
+ */
+G_LOCK_DEFINE_STATIC(gtype_info_cache);
+static GHashTable* gtype_info_cache;  // GType -> GIBaseInfo*
+static unsigned gtype_info_cache_hits;
+static unsigned gtype_info_cache_misses;
+
+/*
+ * gjs_lookup_gtype_info:
+ *
+ * Like g_irepository_find_by_gtype(), but cached. Returns a new reference to
+ * the introspection info for @gtype, or %NULL if there is none.
+ */
+GIBaseInfo* gjs_lookup_gtype_info(GType gtype) {
+    void* key = GSIZE_TO_POINTER(gtype);
+
+    G_LOCK(gtype_info_cache);
+
+    if (G_UNLIKELY(!gtype_info_cache))
+        gtype_info_cache = g_hash_table_new_full(
+            nullptr, nullptr, nullptr, (GDestroyNotify)g_base_info_unref);
+
+    auto* info =
+        static_cast<GIBaseInfo*>(g_hash_table_lookup(gtype_info_cache, key));
+    if (info) {
+        gtype_info_cache_hits++;
+        g_base_info_ref(info);
+        G_UNLOCK(gtype_info_cache);
+        return info;
+    }
+
+    gtype_info_cache_misses++;
+    info = g_irepository_find_by_gtype(nullptr, gtype);
+    if (info)
+        g_hash_table_insert(gtype_info_cache, key, g_base_info_ref(info));
+
+    G_UNLOCK(gtype_info_cache);
+    return info;
+}
+
+/*
+ * gjs_gtype_info_cache_free:
+ *
+ * Frees the GType info cache. Called when the last GjsContext is finalized; if
+ * another one is created later, the cache starts out empty again.
+ */
+void gjs_gtype_info_cache_free(void) {
+    G_LOCK(gtype_info_cache);
+    g_clear_pointer(&gtype_info_cache, g_hash_table_destroy);
+    G_UNLOCK(gtype_info_cache);
+}
+
+/*
+ * gjs_gtype_info_cache_report:
+ *
+ * Logs the hit rate of the GType info cache to the memory debug topic.
+ */
+void gjs_gtype_info_cache_report(void) {
+    G_LOCK(gtype_info_cache);
+    unsigned size = gtype_info_cache ? g_hash_table_size(gtype_info_cache) : 0;
+    unsigned hits = gtype_info_cache_hits;
+    unsigned misses = gtype_info_cache_misses;
+    G_UNLOCK(gtype_info_cache);
+
+    unsigned total = hits + misses;
+    gjs_debug(GJS_DEBUG_MEMORY,
+              "  GType info cache: %u entries, %u lookups, %u hits, "
+              "%u misses (%.1f%% hit rate)",
+              size, total, hits, misses, total ? 100.0 * hits / total : 0.0);
+}
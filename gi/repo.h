@@ -25,6 +25,7 @@
 #define GI_REPO_H_
 
 #include <girepository.h>
+#include <glib-object.h>
 
 #include "gjs/jsapi-wrapper.h"
 
@@ -66,6 +67,11 @@ bool gjs_define_info(JSContext       *context,
 GJS_USE
 char*       gjs_hyphen_from_camel               (const char     *camel_name);
 
+GJS_USE
+GIBaseInfo* gjs_lookup_gtype_info(GType gtype);
+void gjs_gtype_info_cache_free(void);
+void gjs_gtype_info_cache_report(void);
+
 
 #if GJS_VERBOSE_ENABLE_GI_USAGE
 void _gjs_log_info_usage(GIBaseInfo *info);
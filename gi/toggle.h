@@ -101,6 +101,13 @@ private:
      * associations between C and JS objects. */
     void shutdown(void);
 
+    /* Returns the number of toggles waiting to be processed. */
+    GJS_USE
+    size_t size(void) const {
+        std::lock_guard<std::mutex> hold(lock);
+        return q.size();
+    }
+
     /* Queues a toggle to be processed in idle time. */
     void enqueue(GObject  *gobj,
                  Direction direction,
@@ -41,6 +41,7 @@
 #include "gi/gtype.h"
 #include "gi/object.h"
 #include "gi/param.h"
+#include "gi/repo.h"
 #include "gi/union.h"
 #include "gi/value.h"
 #include "gi/wrapperutils.h"
@@ -74,7 +75,7 @@ get_signal_info_if_available(GSignalQuery *signal_query)
     if (!signal_query->itype)
         return NULL;
 
-    obj = g_irepository_find_by_gtype(NULL, signal_query->itype);
+    obj = gjs_lookup_gtype_info(signal_query->itype);
     if (!obj)
         return NULL;
 
@@ -540,7 +541,7 @@ gjs_value_to_g_value_internal(JSContext      *context,
                 if (!gboxed)
                     return false;
             } else {
-                GIBaseInfo *registered = g_irepository_find_by_gtype (NULL, gtype);
+                GIBaseInfo *registered = gjs_lookup_gtype_info(gtype);
 
                 /* We don't necessarily have the typelib loaded when
                    we first see the structure... */
@@ -747,7 +748,7 @@ convert_int_to_enum (GType  gtype,
         v_double = v;
     } else {
         /* Need to distinguish between negative integers and unsigned integers */
-        GjsAutoEnumInfo info = g_irepository_find_by_gtype(nullptr, gtype);
+        GjsAutoEnumInfo info = gjs_lookup_gtype_info(gtype);
         g_assert (info);
 
         v_double = _gjs_enum_from_int(info, v);
@@ -867,7 +868,7 @@ gjs_value_from_g_value_internal(JSContext             *context,
 
         /* The only way to differentiate unions and structs is from
          * their g-i info as both GBoxed */
-        GjsAutoBaseInfo info = g_irepository_find_by_gtype(nullptr, gtype);
+        GjsAutoBaseInfo info = gjs_lookup_gtype_info(gtype);
         if (!info) {
             gjs_throw(context,
                       "No introspection information found for %s",
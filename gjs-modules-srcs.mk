@@ -3,9 +3,10 @@ module_console_srcs =		\
 	modules/console.cpp	\
 	$(NULL)
 
-module_resource_srcs =		\
-	modules-resources.c	\
-	modules-resources.h	\
+module_resource_srcs =			\
+	modules-resources.c		\
+	modules-resources.h		\
+	modules-bytecode-resources.c	\
 	$(NULL)
 
 module_system_srcs =		\
@@ -54,10 +54,15 @@ gjs_srcs =				\
 	gi/value.h			\
 	gi/wrapperutils.cpp		\
 	gi/wrapperutils.h		\
+	gjs/allocation-sampler.cpp	\
+	gjs/allocation-sampler.h	\
 	gjs/atoms.cpp			\
 	gjs/atoms.h			\
 	gjs/byteArray.cpp		\
 	gjs/byteArray.h			\
+	gjs/bytecode-build-id.h		\
+	gjs/bytecode-cache.cpp		\
+	gjs/bytecode-cache.h		\
 	gjs/context.cpp			\
 	gjs/context-private.h		\
 	gjs/coverage.cpp 		\
@@ -67,8 +72,14 @@ gjs_srcs =				\
 	gjs/error-types.cpp		\
 	gjs/engine.cpp			\
 	gjs/engine.h			\
+	gjs/gc-scheduler.cpp		\
+	gjs/gc-scheduler.h		\
 	gjs/global.cpp			\
 	gjs/global.h			\
+	gjs/import-prefetch.cpp		\
+	gjs/import-prefetch.h		\
+	gjs/import-profile.cpp		\
+	gjs/import-profile.h		\
 	gjs/importer.cpp		\
 	gjs/importer.h			\
 	gjs/jsapi-class.h		\
@@ -89,6 +100,8 @@ gjs_srcs =				\
 	gjs/profiler.cpp		\
 	gjs/profiler-private.h		\
 	gjs/stack.cpp			\
+	gjs/text-encoding.cpp		\
+	gjs/text-encoding.h		\
 	modules/modules.cpp		\
 	modules/modules.h		\
 	util/log.cpp			\
@@ -0,0 +1,149 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <config.h>
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/allocation-sampler.h"
+#include "gjs/atoms.h"
+#include "gjs/context-private.h"
+#include "gjs/global.h"
+#include "gjs/jsapi-util.h"
+
+bool GjsAllocationSampler::call(const char* function,
+                                const JS::HandleValueArray& args,
+                                JS::MutableHandleValue rval) {
+    JSAutoCompartment ac(m_cx, m_global);
+    return JS_CallFunctionName(m_cx, m_global, function, args, rval);
+}
+
+/*
+ * GjsAllocationSampler::start:
+ * @probability: chance that an allocation is sampled, between 0 and 1
+ *
+ * Starts recording allocations in the import global, discarding any samples
+ * from before. The first time, this creates the debugger global.
+ */
+bool GjsAllocationSampler::start(double probability) {
+    JSAutoRequest ar(m_cx);
+
+    if (!m_global.initialized()) {
+        JS::RootedObject debuggee(m_cx, gjs_get_import_global(m_cx));
+        JS::RootedObject global(m_cx, gjs_create_global_object(m_cx));
+        if (!global)
+            return false;
+
+        JSAutoCompartment ac(m_cx, global);
+        JS::RootedObject debuggee_wrapper(m_cx, debuggee);
+        if (!JS_WrapObject(m_cx, &debuggee_wrapper))
+            return false;
+
+        const GjsAtoms& atoms = GjsContextPrivate::atoms(m_cx);
+        JS::RootedValue v_wrapper(m_cx, JS::ObjectValue(*debuggee_wrapper));
+        if (!JS_SetPropertyById(m_cx, global, atoms.debuggee(), v_wrapper) ||
+            !gjs_define_global_properties(m_cx, global, "allocations"))
+            return false;
+
+        m_global.init(m_cx, global);
+    }
+
+    JS::AutoValueArray<1> args(m_cx);
+    args[0].setDouble(probability);
+    JS::RootedValue ignored(m_cx);
+    return call("startSampling", args, &ignored);
+}
+
+/*
+ * GjsAllocationSampler::drain:
+ * @overflowed: (out): whether samples were lost since the last drain
+ *
+ * Moves the samples out of the Debugger's allocation log, which only holds a
+ * limited number of them, into the aggregated stacks. Call this periodically.
+ */
+bool GjsAllocationSampler::drain(bool* overflowed) {
+    JSAutoRequest ar(m_cx);
+
+    JS::RootedValue rval(m_cx);
+    if (!call("drainSamples", JS::HandleValueArray::empty(), &rval))
+        return false;
+
+    *overflowed = JS::ToBoolean(rval);
+    return true;
+}
+
+/*
+ * GjsAllocationSampler::rotate:
+ * @overflowed: (out): whether samples were lost since the last drain
+ *
+ * Like drain(), and then throws away the samples of the previous period and
+ * starts a new one. Call this when the flight recorder starts a new period.
+ */
+bool GjsAllocationSampler::rotate(bool* overflowed) {
+    JSAutoRequest ar(m_cx);
+
+    JS::RootedValue rval(m_cx);
+    if (!call("rotateSamples", JS::HandleValueArray::empty(), &rval))
+        return false;
+
+    *overflowed = JS::ToBoolean(rval);
+    return true;
+}
+
+/*
+ * GjsAllocationSampler::collect:
+ * @collapsed_stacks: (out): return location for the aggregated samples
+ *
+ * Returns the samples of the current and previous periods in the collapsed
+ * stack format, without stopping.
+ */
+bool GjsAllocationSampler::collect(JS::UniqueChars* collapsed_stacks) {
+    JSAutoRequest ar(m_cx);
+
+    JS::RootedValue rval(m_cx);
+    if (!call("collectSamples", JS::HandleValueArray::empty(), &rval))
+        return false;
+
+    JSAutoCompartment ac(m_cx, m_global);
+    return gjs_string_to_utf8(m_cx, rval, collapsed_stacks);
+}
+
+/*
+ * GjsAllocationSampler::stop:
+ * @collapsed_stacks: (out): return location for the aggregated samples
+ *
+ * Stops recording allocations, and returns the samples recorded since start(),
+ * or those of the current and previous periods if rotate() was called, in the
+ * collapsed stack format.
+ */
+bool GjsAllocationSampler::stop(JS::UniqueChars* collapsed_stacks) {
+    JSAutoRequest ar(m_cx);
+
+    JS::RootedValue rval(m_cx);
+    if (!call("stopSampling", JS::HandleValueArray::empty(), &rval))
+        return false;
+
+    JSAutoCompartment ac(m_cx, m_global);
+    return gjs_string_to_utf8(m_cx, rval, collapsed_stacks);
+}
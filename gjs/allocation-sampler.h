@@ -0,0 +1,68 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#ifndef GJS_ALLOCATION_SAMPLER_H_
+#define GJS_ALLOCATION_SAMPLER_H_
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/macros.h"
+
+/*
+ * GjsAllocationSampler:
+ *
+ * Samples JS allocations with the Debugger API's allocation log, to find out
+ * which code is responsible for growth of the JS heap. Each allocation is
+ * recorded with the given probability, together with the stack at the time of
+ * the allocation. The samples are aggregated by stack, and written out in the
+ * collapsed stack format that flame graph tools read: one line per stack, with
+ * the frames from the outermost to the innermost separated by semicolons,
+ * followed by the estimated number of bytes allocated there. The innermost
+ * "frame" is the class of the allocated object.
+ *
+ * In flight recorder mode, the samples are kept per period like the profiler's
+ * captures, so that only those of the last one or two periods are written out.
+ *
+ * The debugger lives in its own global, set up by the "allocations" bootstrap
+ * script, which does the aggregation.
+ */
+class GjsAllocationSampler {
+    JSContext* m_cx;
+    JS::PersistentRootedObject m_global;
+
+    GJS_JSAPI_RETURN_CONVENTION
+    bool call(const char* function, const JS::HandleValueArray& args,
+              JS::MutableHandleValue rval);
+
+ public:
+    explicit GjsAllocationSampler(JSContext* cx) : m_cx(cx) {}
+
+    GJS_JSAPI_RETURN_CONVENTION bool start(double probability);
+    GJS_JSAPI_RETURN_CONVENTION bool drain(bool* overflowed);
+    GJS_JSAPI_RETURN_CONVENTION bool rotate(bool* overflowed);
+    GJS_JSAPI_RETURN_CONVENTION bool collect(JS::UniqueChars* collapsed_stacks);
+    GJS_JSAPI_RETURN_CONVENTION bool stop(JS::UniqueChars* collapsed_stacks);
+};
+
+#endif  // GJS_ALLOCATION_SAMPLER_H_
@@ -37,6 +37,7 @@
     macro(constructor, "constructor") \
     macro(debuggee, "debuggee") \
     macro(emit, "emit") \
+    macro(fatal, "fatal") \
     macro(file, "__file__") \
     macro(file_name, "fileName") \
     macro(gi, "gi") \
@@ -45,6 +46,7 @@
     macro(gobject, "GObject") \
     macro(gtype, "$gtype") \
     macro(height, "height") \
+    macro(ignore_bom, "ignoreBOM") \
     macro(imports, "imports") \
     macro(init, "_init") \
     macro(instance_init, "_instance_init") \
@@ -63,14 +65,17 @@
     macro(parent_module, "__parentModule__") \
     macro(program_invocation_name, "programInvocationName") \
     macro(prototype, "prototype") \
+    macro(read, "read") \
     macro(search_path, "searchPath") \
     macro(stack, "stack") \
+    macro(stream, "stream") \
     macro(to_string, "toString") \
     macro(value_of, "valueOf") \
     macro(version, "version") \
     macro(versions, "versions") \
     macro(width, "width") \
     macro(window, "window") \
+    macro(written, "written") \
     macro(x, "x") \
     macro(y, "y")
 
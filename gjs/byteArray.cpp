@@ -21,22 +21,29 @@
  * IN THE SOFTWARE.
  */
 
+#include <errno.h>
+#include <fcntl.h>  // for O_RDONLY, O_CLOEXEC
 #include <stdint.h>
 #include <string.h>  // for strcmp, memchr, strlen
 
+#include <map>
+
 #include <girepository.h>
 #include <glib-object.h>
 #include <glib.h>
+#include <glib/gstdio.h>  // for g_open, g_close
 
 #include "gjs/jsapi-wrapper.h"
 
 #include "gi/boxed.h"
+#include "gi/repo.h"
 #include "gjs/atoms.h"
 #include "gjs/byteArray.h"
 #include "gjs/context-private.h"
 #include "gjs/deprecation.h"
 #include "gjs/jsapi-util-args.h"
 #include "gjs/jsapi-util.h"
+#include "gjs/text-encoding.h"
 
 /* Callbacks to use with JS_NewExternalArrayBuffer() */
 
@@ -44,18 +51,73 @@ static void gfree_arraybuffer_contents(void* contents, void*) {
     g_free(contents);
 }
 
-static void bytes_ref_arraybuffer(void* contents G_GNUC_UNUSED,
-                                  void* user_data) {
+/* The GBytes whose data is used by external ArrayBuffers, keyed by the address
+ * of the data, so that arrays on those ArrayBuffers can be passed back to C as
+ * GBytes without copying. Each entry holds a reference to its GBytes, and is
+ * removed when the last ArrayBuffer using the data is freed; that may happen on
+ * a background finalization thread, hence the lock. */
+struct BytesBuffer {
+    GBytes* bytes = nullptr;
+    size_t len = 0;
+    unsigned n_buffers = 0;
+};
+G_LOCK_DEFINE_STATIC(bytes_buffers);
+static std::map<const uint8_t*, BytesBuffer> bytes_buffers;
+
+static void bytes_ref_arraybuffer(void* contents, void* user_data) {
     auto* gbytes = static_cast<GBytes*>(user_data);
     g_bytes_ref(gbytes);
+
+    G_LOCK(bytes_buffers);
+    BytesBuffer& entry = bytes_buffers[static_cast<const uint8_t*>(contents)];
+    if (entry.n_buffers++ == 0) {
+        entry.bytes = g_bytes_ref(gbytes);
+        entry.len = g_bytes_get_size(gbytes);
+    }
+    G_UNLOCK(bytes_buffers);
 }
 
-static void bytes_unref_arraybuffer(void* contents G_GNUC_UNUSED,
-                                    void* user_data) {
+static void bytes_unref_arraybuffer(void* contents, void* user_data) {
     auto* gbytes = static_cast<GBytes*>(user_data);
+    GBytes* unregistered = nullptr;
+
+    G_LOCK(bytes_buffers);
+    auto it = bytes_buffers.find(static_cast<const uint8_t*>(contents));
+    if (it != bytes_buffers.end() && --it->second.n_buffers == 0) {
+        unregistered = it->second.bytes;
+        bytes_buffers.erase(it);
+    }
+    G_UNLOCK(bytes_buffers);
+
+    if (unregistered)
+        g_bytes_unref(unregistered);
     g_bytes_unref(gbytes);
 }
 
+/* Returns a new GBytes for the @len bytes at @data without copying them, if
+ * they are part of the data of a GBytes used by an external ArrayBuffer, or
+ * nullptr otherwise */
+GJS_USE
+static GBytes* lookup_bytes_buffer(const uint8_t* data, size_t len) {
+    if (len == 0)
+        return nullptr;
+
+    GBytes* retval = nullptr;
+    G_LOCK(bytes_buffers);
+    auto it = bytes_buffers.upper_bound(data);
+    if (it != bytes_buffers.begin()) {
+        --it;
+        const uint8_t* start = it->first;
+        const BytesBuffer& entry = it->second;
+        if (data + len <= start + entry.len)
+            retval = g_bytes_new_from_bytes(entry.bytes, data - start, len);
+    }
+    G_UNLOCK(bytes_buffers);
+    return retval;
+}
+
+static void free_stolen_contents(void* contents) { JS_free(nullptr, contents); }
+
 /* implement toString() with an optional encoding arg */
 GJS_JSAPI_RETURN_CONVENTION
 static bool to_string_impl(JSContext* context, JS::HandleObject byte_array,
@@ -105,17 +167,24 @@ static bool to_string_impl(JSContext* context, JS::HandleObject byte_array,
         gsize bytes_written;
         GError *error;
 
-        error = NULL;
-        GjsAutoChar u16_str = g_convert(reinterpret_cast<char*>(data), len,
         // Make sure the bytes of the UTF-16 string are laid out in memory
         // such that we can simply reinterpret_cast<char16_t> them.
 #if G_BYTE_ORDER == G_LITTLE_ENDIAN
-                                        "UTF-16LE",
+        GjsCachedIConv converter("UTF-16LE", encoding);
 #else
-                                        "UTF-16BE",
+        GjsCachedIConv converter("UTF-16BE", encoding);
 #endif
-                                        encoding, nullptr, /* bytes read */
-                                        &bytes_written, &error);
+        if (!converter.is_valid()) {
+            gjs_throw(context, "Conversion from %s is not supported",
+                      encoding);
+            return false;
+        }
+
+        error = NULL;
+        GjsAutoChar u16_str = g_convert_with_iconv(
+            reinterpret_cast<char*>(data), len, converter,
+            nullptr, /* bytes read */
+            &bytes_written, &error);
         if (!u16_str)
             return gjs_throw_gerror_message(context, error);  // frees GError
 
@@ -174,7 +243,6 @@ to_gbytes_func(JSContext *context,
                JS::Value *vp)
 {
     JS::CallArgs rec = JS::CallArgsFromVp(argc, vp);
-    GIBaseInfo *gbytes_info;
     JS::RootedObject byte_array(context);
 
     if (!gjs_parse_call_args(context, "toGBytes", rec, "o",
@@ -191,7 +259,7 @@ to_gbytes_func(JSContext *context,
 
     g_irepository_require(nullptr, "GLib", "2.0", GIRepositoryLoadFlags(0),
                           nullptr);
-    gbytes_info = g_irepository_find_by_gtype(NULL, G_TYPE_BYTES);
+    GjsAutoBaseInfo gbytes_info = gjs_lookup_gtype_info(G_TYPE_BYTES);
     JSObject* ret_bytes_obj =
         BoxedInstance::new_for_c_struct(context, gbytes_info, bytes);
     g_bytes_unref(bytes);
@@ -202,6 +270,72 @@ to_gbytes_func(JSContext *context,
     return true;
 }
 
+/* transferToGBytes() is like toGBytes(), but takes over the memory of the
+ * array's ArrayBuffer instead of copying it. Arrays created from a GBytes give
+ * back a GBytes sharing the memory of that one. Either way the ArrayBuffer is
+ * detached, so the array and any other views on the same buffer become empty,
+ * and JS can't change the contents of the GBytes afterwards. */
+GJS_JSAPI_RETURN_CONVENTION
+static bool transfer_to_gbytes_func(JSContext* cx, unsigned argc,
+                                    JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedObject byte_array(cx);
+
+    if (!gjs_parse_call_args(cx, "transferToGBytes", args, "o", "byteArray",
+                             &byte_array))
+        return false;
+
+    if (!JS_IsUint8Array(byte_array)) {
+        gjs_throw(cx,
+                  "Argument to ByteArray.transferToGBytes() must be a "
+                  "Uint8Array");
+        return false;
+    }
+
+    bool is_shared_memory;
+    JS::RootedObject buffer(
+        cx, JS_GetArrayBufferViewBuffer(cx, byte_array, &is_shared_memory));
+    if (!buffer)
+        return false;
+
+    uint32_t offset = JS_GetTypedArrayByteOffset(byte_array);
+    uint32_t len;
+    uint8_t* data;
+    js::GetUint8ArrayLengthAndData(byte_array, &len, &is_shared_memory, &data);
+
+    // Arrays backed by a GBytes already avoid the copy, and shared memory
+    // can't be taken over
+    GBytes* bytes = lookup_bytes_buffer(data, len);
+    if (bytes && !JS_DetachArrayBuffer(cx, buffer)) {
+        g_bytes_unref(bytes);
+        return false;
+    }
+    if (!bytes && !is_shared_memory && len > 0) {
+        uint32_t buffer_len = JS_GetArrayBufferByteLength(buffer);
+        void* contents = JS_StealArrayBufferContents(cx, buffer);
+        if (!contents)
+            return false;
+        GBytes* whole = g_bytes_new_with_free_func(
+            contents, buffer_len, free_stolen_contents, contents);
+        bytes = g_bytes_new_from_bytes(whole, offset, len);
+        g_bytes_unref(whole);
+    }
+    if (!bytes)
+        bytes = gjs_byte_array_get_bytes(byte_array);
+
+    g_irepository_require(nullptr, "GLib", "2.0", GIRepositoryLoadFlags(0),
+                          nullptr);
+    GjsAutoBaseInfo gbytes_info = gjs_lookup_gtype_info(G_TYPE_BYTES);
+    JSObject* ret_bytes_obj =
+        BoxedInstance::new_for_c_struct(cx, gbytes_info, bytes);
+    g_bytes_unref(bytes);
+    if (!ret_bytes_obj)
+        return false;
+
+    args.rval().setObject(*ret_bytes_obj);
+    return true;
+}
+
 /* fromString() function implementation */
 GJS_JSAPI_RETURN_CONVENTION
 static bool
@@ -243,34 +377,39 @@ from_string_func(JSContext *context,
         char *encoded = NULL;
         gsize bytes_written;
 
+        bool latin1 = JS_StringHasLatin1Chars(str);
+        GjsCachedIConv converter(encoding.get(), latin1 ? "LATIN1" : "UTF-16");
+        if (!converter.is_valid()) {
+            gjs_throw(context, "Conversion to %s is not supported",
+                      encoding.get());
+            return false;
+        }
+
         /* Scope for AutoCheckCannotGC, will crash if a GC is triggered
          * while we are using the string's chars */
         {
             JS::AutoCheckCannotGC nogc;
             size_t len;
 
-            if (JS_StringHasLatin1Chars(str)) {
+            if (latin1) {
                 const JS::Latin1Char *chars =
                     JS_GetLatin1StringCharsAndLength(context, nogc, str, &len);
                 if (chars == NULL)
                     return false;
 
-                encoded = g_convert((char *) chars, len,
-                                    encoding.get(),  // to_encoding
-                                    "LATIN1",  /* from_encoding */
-                                    NULL,  /* bytes read */
-                                    &bytes_written, &error);
+                encoded = g_convert_with_iconv((char*)chars, len, converter,
+                                               NULL, /* bytes read */
+                                               &bytes_written, &error);
             } else {
                 const char16_t *chars =
                     JS_GetTwoByteStringCharsAndLength(context, nogc, str, &len);
                 if (chars == NULL)
                     return false;
 
-                encoded = g_convert((char *) chars, len * 2,
-                                    encoding.get(),  // to_encoding
-                                    "UTF-16",  /* from_encoding */
-                                    NULL,  /* bytes read */
-                                    &bytes_written, &error);
+                encoded = g_convert_with_iconv((char*)chars, len * 2,
+                                               converter,
+                                               NULL, /* bytes read */
+                                               &bytes_written, &error);
             }
         }
 
@@ -295,6 +434,27 @@ from_string_func(JSContext *context,
     return true;
 }
 
+/* Creates a Uint8Array that uses the data of @gbytes in place, and keeps a
+ * reference to @gbytes for as long as it is alive */
+GJS_JSAPI_RETURN_CONVENTION
+static JSObject* uint8_array_from_gbytes(JSContext* cx, GBytes* gbytes) {
+    size_t len;
+    const void* data = g_bytes_get_data(gbytes, &len);
+
+    JS::RootedObject array_buffer(cx);
+    if (len == 0)
+        array_buffer = JS_NewArrayBuffer(cx, 0);
+    else
+        array_buffer = JS_NewExternalArrayBuffer(
+            cx, len,
+            const_cast<void*>(data),  // the ArrayBuffer won't modify the data
+            bytes_ref_arraybuffer, bytes_unref_arraybuffer, gbytes);
+    if (!array_buffer)
+        return nullptr;
+
+    return JS_NewUint8ArrayWithBuffer(cx, array_buffer, 0, -1);
+}
+
 GJS_JSAPI_RETURN_CONVENTION
 static bool
 from_gbytes_func(JSContext *context,
@@ -316,19 +476,7 @@ from_gbytes_func(JSContext *context,
     if (!gbytes)
         return false;
 
-    size_t len;
-    const void* data = g_bytes_get_data(gbytes, &len);
-    JS::RootedObject array_buffer(
-        context,
-        JS_NewExternalArrayBuffer(
-            context, len,
-            const_cast<void*>(data),  // the ArrayBuffer won't modify the data
-            bytes_ref_arraybuffer, bytes_unref_arraybuffer, gbytes));
-    if (!array_buffer)
-        return false;
-
-    JS::RootedObject obj(
-        context, JS_NewUint8ArrayWithBuffer(context, array_buffer, 0, -1));
+    JS::RootedObject obj(context, uint8_array_from_gbytes(context, gbytes));
     if (!obj)
         return false;
 
@@ -341,6 +489,54 @@ from_gbytes_func(JSContext *context,
     return true;
 }
 
+/* fromMappedFile() maps the file into memory and wraps the mapping without
+ * copying it, so even very large files only take up address space, and only
+ * the pages that are touched are read from disk. The file is opened read-only,
+ * so files that the user can't write can be mapped too, but the mapping is
+ * private and writable: writing to the array copies the page, and never changes
+ * the file.
+ */
+GJS_JSAPI_RETURN_CONVENTION
+static bool from_mapped_file_func(JSContext* cx, unsigned argc,
+                                  JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    GjsAutoChar path;
+
+    if (!gjs_parse_call_args(cx, "fromMappedFile", args, "F", "path", &path))
+        return false;
+
+    int flags = O_RDONLY;
+#ifdef O_CLOEXEC
+    flags |= O_CLOEXEC;
+#endif
+    int fd = g_open(path, flags, 0);
+    if (fd == -1) {
+        int errsv = errno;
+        gjs_throw(cx, "Failed to open %s: %s", path.get(), g_strerror(errsv));
+        return false;
+    }
+
+    // g_mapped_file_new() would open the file for writing to map it writable
+    GError* error = nullptr;
+    GMappedFile* mapped_file =
+        g_mapped_file_new_from_fd(fd, /* writable = */ true, &error);
+    g_close(fd, nullptr);  // the mapping stays valid
+    if (!mapped_file)
+        return gjs_throw_gerror_message(cx, error);
+
+    // The GBytes keeps the mapping alive, and the ArrayBuffer keeps the GBytes
+    GBytes* gbytes = g_mapped_file_get_bytes(mapped_file);
+    g_mapped_file_unref(mapped_file);
+
+    JSObject* obj = uint8_array_from_gbytes(cx, gbytes);
+    g_bytes_unref(gbytes);
+    if (!obj)
+        return false;
+
+    args.rval().setObject(*obj);
+    return true;
+}
+
 JSObject* gjs_byte_array_from_data(JSContext* cx, size_t nbytes, void* data) {
     JS::RootedObject array_buffer(cx);
     // a null data pointer takes precedence over whatever `nbytes` says
@@ -365,6 +561,9 @@ JSObject* gjs_byte_array_from_byte_array(JSContext* cx, GByteArray* array) {
     return gjs_byte_array_from_data(cx, array->len, array->data);
 }
 
+/* The contents are always copied, even for arrays created from a GBytes: a
+ * GBytes is immutable, but the array can still be written to from JS.
+ * ByteArray.transferToGBytes() is the way to avoid the copy. */
 GBytes* gjs_byte_array_get_bytes(JS::HandleObject obj) {
     bool is_shared_memory;
     uint32_t len;
@@ -381,8 +580,10 @@ GByteArray* gjs_byte_array_get_byte_array(JS::HandleObject obj) {
 static JSFunctionSpec gjs_byte_array_module_funcs[] = {
     JS_FN("fromString", from_string_func, 2, 0),
     JS_FN("fromGBytes", from_gbytes_func, 1, 0),
+    JS_FN("fromMappedFile", from_mapped_file_func, 1, 0),
     JS_FN("toGBytes", to_gbytes_func, 1, 0),
     JS_FN("toString", to_string_func, 2, 0),
+    JS_FN("transferToGBytes", transfer_to_gbytes_func, 1, 0),
     JS_FS_END};
 
 bool
@@ -390,5 +591,9 @@ gjs_define_byte_array_stuff(JSContext              *cx,
                             JS::MutableHandleObject module)
 {
     module.set(JS_NewPlainObject(cx));
-    return JS_DefineFunctions(cx, module, gjs_byte_array_module_funcs);
+
+    JS::RootedObject proto(cx);
+    return JS_DefineFunctions(cx, module, gjs_byte_array_module_funcs) &&
+           gjs_text_decoder_define_proto(cx, module, &proto) &&
+           gjs_text_encoder_define_proto(cx, module, &proto);
 }
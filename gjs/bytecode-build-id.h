@@ -0,0 +1,46 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GJS_BYTECODE_BUILD_ID_H_
+#define GJS_BYTECODE_BUILD_ID_H_
+
+#include <string.h>  // for strlen
+
+#include <glib.h>
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/macros.h"
+
+/* XDR refuses to decode bytecode encoded with a different build ID. This is
+ * inline so that the gjs-compile-bytecode build tool, which doesn't link to
+ * libgjs, uses the same ID as the library. */
+GJS_USE
+static inline bool gjs_bytecode_get_build_id(JS::BuildIdCharVector* build_id) {
+    char id[128];
+    g_snprintf(id, sizeof(id), "gjs-%d-%s-%zu", GJS_VERSION,
+               JS_GetImplementationVersion(), sizeof(void*));
+    return build_id->append(id, strlen(id));
+}
+
+#endif  // GJS_BYTECODE_BUILD_ID_H_
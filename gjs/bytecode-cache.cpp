@@ -0,0 +1,389 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <config.h>  // for GJS_VERSION, HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>  // for memcmp, memcpy
+
+#include <string>  // for u16string
+
+#include <glib.h>
+#include <glib/gstdio.h>  // for g_stat
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/bytecode-build-id.h"
+#include "gjs/bytecode-cache.h"
+#include "gjs/context-private.h"
+#include "gjs/engine.h"
+#include "gjs/jsapi-util.h"
+#include "gjs/mem-private.h"
+#include "gjs/profiler-private.h"
+#include "util/log.h"
+
+/* Cache of compiled module bytecode, in SpiderMonkey's XDR format.
+ *
+ * Each module has one file in $XDG_CACHE_HOME/gjs, named after a hash of the
+ * module's path and the build ID, so a different GJS or SpiderMonkey build
+ * never finds the entries of another. The file starts with a CacheHeader that
+ * records the modification time, size, and a hash of the contents of the source
+ * file that the bytecode was compiled from; if any of those don't match the
+ * current source file, the entry is stale and gets replaced. */
+
+static const char CACHE_MAGIC[8] = {'G', 'J', 'S', 'X', 'D', 'R', '0', '2'};
+
+struct CacheHeader {
+    char magic[8];
+    uint64_t mtime;  // nanoseconds, where the file system records them
+    uint64_t size;
+    uint8_t content_hash[32];  // SHA-256
+};
+// The XDR data that follows the header must stay aligned
+static_assert(sizeof(CacheHeader) % 8 == 0, "CacheHeader size");
+
+static volatile int cache_hits = 0;
+static volatile int cache_misses = 0;
+static volatile int cache_stale = 0;
+static volatile int precompiled_hits = 0;
+
+using GjsAutoChecksum = GjsAutoPointer<GChecksum, GChecksum, g_checksum_free>;
+
+GJS_USE
+static bool cache_enabled(void) {
+    static const bool enabled = !g_getenv("GJS_DISABLE_BYTECODE_CACHE");
+    return enabled;
+}
+
+// With G_RESOURCE_OVERLAYS, GIO may serve a module's source from a local
+// directory instead of the resource, but the bytecode next to it would still
+// have been compiled from the original source
+GJS_USE
+static bool precompiled_enabled(void) {
+    static const bool enabled = !g_getenv("G_RESOURCE_OVERLAYS");
+    return enabled;
+}
+
+void gjs_bytecode_cache_init(JSContext* cx) {
+    JS::SetBuildIdOp(cx, gjs_bytecode_get_build_id);
+}
+
+GJS_USE
+static char* cache_file_for(const char* path) {
+    JS::BuildIdCharVector build_id;
+    if (!gjs_bytecode_get_build_id(&build_id))
+        return nullptr;
+
+    GjsAutoChecksum checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(checksum,
+                      reinterpret_cast<const unsigned char*>(build_id.begin()),
+                      build_id.length());
+    g_checksum_update(checksum, reinterpret_cast<const unsigned char*>(""), 1);
+    g_checksum_update(checksum, reinterpret_cast<const unsigned char*>(path),
+                      -1);
+
+    GjsAutoChar name =
+        g_strconcat(g_checksum_get_string(checksum), ".xdr", nullptr);
+    return g_build_filename(g_get_user_cache_dir(), "gjs", name.get(),
+                            nullptr);
+}
+
+GJS_USE
+static bool fill_header(CacheHeader* header, const char* path,
+                        const char* script, size_t script_len) {
+    GStatBuf stat_buf;
+    if (g_stat(path, &stat_buf) != 0)
+        return false;
+
+    memcpy(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    // Not just whole seconds, which would miss a file saved twice in a second
+    header->mtime =
+        uint64_t(stat_buf.st_mtime) * G_GUINT64_CONSTANT(1000000000);
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    header->mtime += stat_buf.st_mtim.tv_nsec;
+#endif
+    header->size = script_len;
+
+    GjsAutoChecksum checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(checksum, reinterpret_cast<const unsigned char*>(script),
+                      script_len);
+    size_t digest_len = sizeof(header->content_hash);
+    g_checksum_get_digest(checksum, header->content_hash, &digest_len);
+    return digest_len == sizeof(header->content_hash);
+}
+
+static void add_profiler_mark(JSContext* cx, int64_t start, const char* what,
+                              const char* path) {
+    GjsProfiler* profiler = GjsContextPrivate::from_cx(cx)->profiler();
+    if (!profiler)
+        return;
+
+    int64_t now = g_get_monotonic_time();
+    _gjs_profiler_add_mark(profiler, start * 1000L, (now - start) * 1000L,
+                           "GJS", what, path);
+}
+
+// Returns false without an exception pending if there was no usable entry
+GJS_USE
+static bool decode_from_cache(JSContext* cx, const char* cache_path,
+                              const CacheHeader& expected,
+                              JS::MutableHandleScript script_out) {
+    GError* error = nullptr;
+    GMappedFile* mapped = g_mapped_file_new(cache_path, false, &error);
+    if (!mapped) {
+        g_clear_error(&error);
+        return false;
+    }
+
+    GjsAutoPointer<GMappedFile, GMappedFile, g_mapped_file_unref> mapped_file =
+        mapped;
+    size_t len = g_mapped_file_get_length(mapped);
+    auto* contents =
+        reinterpret_cast<uint8_t*>(g_mapped_file_get_contents(mapped));
+
+    if (len <= sizeof(CacheHeader) ||
+        memcmp(contents, &expected, sizeof(CacheHeader)) != 0) {
+        g_atomic_int_inc(&cache_stale);
+        return false;
+    }
+
+    JS::TranscodeRange range(contents + sizeof(CacheHeader),
+                             len - sizeof(CacheHeader));
+    JS::TranscodeResult result = JS::DecodeScript(cx, range, script_out);
+    if (result != JS::TranscodeResult_Ok) {
+        // E.g. a build ID mismatch, or a truncated file
+        if (result == JS::TranscodeResult_Throw)
+            JS_ClearPendingException(cx);
+        g_atomic_int_inc(&cache_stale);
+        return false;
+    }
+
+    return true;
+}
+
+static void encode_to_cache(JSContext* cx, const char* cache_path,
+                            const CacheHeader& header,
+                            JS::HandleScript script) {
+    JS::TranscodeBuffer buffer;
+    if (!buffer.append(reinterpret_cast<const uint8_t*>(&header),
+                       sizeof(CacheHeader))) {
+        JS_ClearPendingException(cx);
+        return;
+    }
+
+    JS::TranscodeResult result = JS::EncodeScript(cx, buffer, script);
+    if (result != JS::TranscodeResult_Ok) {
+        if (result == JS::TranscodeResult_Throw)
+            JS_ClearPendingException(cx);
+        gjs_debug(GJS_DEBUG_IMPORTER, "Failed to encode bytecode for %s",
+                  cache_path);
+        return;
+    }
+
+    GjsAutoChar dir = g_path_get_dirname(cache_path);
+    GError* error = nullptr;
+    if (g_mkdir_with_parents(dir, 0755) != 0 ||
+        !g_file_set_contents(cache_path,
+                             reinterpret_cast<const char*>(buffer.begin()),
+                             buffer.length(), &error)) {
+        gjs_debug(GJS_DEBUG_IMPORTER, "Failed to write bytecode cache %s: %s",
+                  cache_path, error ? error->message : g_strerror(errno));
+        g_clear_error(&error);
+    }
+}
+
+/*
+ * gjs_use_lazy_source:
+ * @cx: the JS context
+ * @path: (nullable): local path of the module's source file
+ * @filename: name of the module in stack traces
+ * @shebang_len: number of characters cut off the start of the source
+ *
+ * Whether the module should be compiled with lazy source: the source hook can
+ * get the source back from the GResource or the file if it is needed, so the
+ * engine doesn't need to keep a copy. Always for modules in a GResource, and
+ * for module files if GjsContext:lazy-module-source is set. Not if a shebang
+ * line was cut off, since then the offsets wouldn't match.
+ */
+bool gjs_use_lazy_source(JSContext* cx, const char* path, const char* filename,
+                         size_t shebang_len) {
+    if (shebang_len > 0)
+        return false;
+    if (path)
+        return GjsContextPrivate::from_cx(cx)->lazy_module_source();
+    return g_str_has_prefix(filename, "resource://");
+}
+
+/*
+ * gjs_bytecode_decode_precompiled:
+ * @cx: the JS context
+ * @uri: URI of a script in a GResource
+ * @script_out: (out): the decoded script
+ *
+ * Looks for bytecode that was compiled from the script at @uri when GJS was
+ * built, stored in the GResource next to it with an ".xdr" suffix, and decodes
+ * it. The built-in modules are compiled by gjs-compile-bytecode, with lazy
+ * source, so that the source hook fetches the source code from the GResource
+ * if it is ever needed.
+ *
+ * Precompiled bytecode is not used at all if G_RESOURCE_OVERLAYS is set, since
+ * an overlay may replace the source that it was compiled from.
+ *
+ * Returns: false without an exception pending if there is no precompiled
+ * bytecode, or if it can't be used with this build of SpiderMonkey; in that
+ * case the caller should compile the source instead.
+ */
+bool gjs_bytecode_decode_precompiled(JSContext* cx, const char* uri,
+                                     JS::MutableHandleScript script_out) {
+    if (!g_str_has_prefix(uri, "resource://") || !precompiled_enabled())
+        return false;
+
+    GjsAutoChar xdr_uri = g_strconcat(uri, ".xdr", nullptr);
+    GjsAutoPointer<GBytes, GBytes, g_bytes_unref> bytes =
+        gjs_lookup_resource_data(xdr_uri, nullptr);
+    if (!bytes)
+        return false;
+
+    size_t len;
+    auto* data = static_cast<const uint8_t*>(g_bytes_get_data(bytes, &len));
+    // DecodeScript() doesn't write to the buffer, the range is just not const
+    JS::TranscodeRange range(const_cast<uint8_t*>(data), len);
+    JS::TranscodeResult result = JS::DecodeScript(cx, range, script_out);
+    if (result != JS::TranscodeResult_Ok) {
+        if (result == JS::TranscodeResult_Throw)
+            JS_ClearPendingException(cx);
+        gjs_debug(GJS_DEBUG_IMPORTER,
+                  "Precompiled bytecode for %s is unusable (%d), compiling "
+                  "from source",
+                  uri, result);
+        return false;
+    }
+
+    g_atomic_int_inc(&precompiled_hits);
+    gjs_debug(GJS_DEBUG_IMPORTER, "Using precompiled bytecode for %s", uri);
+    return true;
+}
+
+/*
+ * gjs_bytecode_cache_compile:
+ * @cx: the JS context
+ * @path: (nullable): path of the module's source file, or %NULL if it isn't a
+ *   local file; only local files are cached
+ * @script: the module's source code in UTF-8
+ * @script_len: length of @script in bytes
+ * @filename: name to use for the module in stack traces
+ * @script_out: (out): the compiled script
+ *
+ * Compiles a module's code for a non-syntactic scope, so that it can be executed
+ * with the module object in its scope chain. If the bytecode cache has an entry
+ * for @path that is up to date with @script, decodes it instead of compiling;
+ * otherwise compiles and writes the result to the cache. Modules that are not
+ * local files may have bytecode precompiled at build time, see
+ * gjs_bytecode_decode_precompiled().
+ *
+ * Returns: false if an exception is pending.
+ */
+bool gjs_bytecode_cache_compile(JSContext* cx, const char* path,
+                                const char* script, size_t script_len,
+                                const char* filename,
+                                JS::MutableHandleScript script_out) {
+    int64_t start = g_get_monotonic_time();
+    GjsAutoChar cache_path;
+    CacheHeader header;
+
+    if (path && cache_enabled() && fill_header(&header, path, script,
+                                               script_len)) {
+        cache_path = cache_file_for(path);
+        if (cache_path &&
+            decode_from_cache(cx, cache_path, header, script_out)) {
+            g_atomic_int_inc(&cache_hits);
+            // The entry may have been encoded with lazy source
+            GjsContextPrivate::from_cx(cx)->register_lazy_source(
+                filename, script, script_len);
+            gjs_debug(GJS_DEBUG_IMPORTER, "Bytecode cache hit for %s", path);
+            add_profiler_mark(cx, start, "Bytecode cache hit", path);
+            return true;
+        }
+    }
+
+    if (!path && gjs_bytecode_decode_precompiled(cx, filename, script_out))
+        return true;
+
+    std::u16string utf16_string = gjs_utf8_script_to_utf16(script, script_len);
+
+    unsigned start_line_number = 1;
+    size_t offset = gjs_unix_shebang_len(utf16_string, &start_line_number);
+
+    JS::SourceBufferHolder buf(utf16_string.c_str() + offset,
+                               utf16_string.size() - offset,
+                               JS::SourceBufferHolder::NoOwnership);
+
+    JS::CompileOptions options(cx);
+    options.setFileAndLine(filename, start_line_number);
+    if (gjs_use_lazy_source(cx, path, filename, offset)) {
+        options.setSourceIsLazy(true);
+        GJS_ADD_LAZY_SOURCE_BYTES(utf16_string.size() * sizeof(char16_t));
+        if (path)
+            GjsContextPrivate::from_cx(cx)->register_lazy_source(
+                filename, script, script_len);
+    }
+
+    if (!JS::CompileForNonSyntacticScope(cx, options, buf, script_out))
+        return false;
+
+    if (cache_path) {
+        g_atomic_int_inc(&cache_misses);
+        gjs_debug(GJS_DEBUG_IMPORTER, "Bytecode cache miss for %s", path);
+        // Encode before the script runs, while it is still pristine
+        encode_to_cache(cx, cache_path, header, script_out);
+        add_profiler_mark(cx, start, "Bytecode cache miss", path);
+    }
+
+    return true;
+}
+
+/*
+ * gjs_bytecode_cache_get_stats:
+ * @hits: (out): number of modules decoded from the cache
+ * @misses: (out): number of modules compiled and written to the cache
+ * @stale: (out): number of cache entries that were out of date or unusable
+ *
+ * Gets the cache statistics since the process started, for the tests.
+ */
+void gjs_bytecode_cache_get_stats(unsigned* hits, unsigned* misses,
+                                  unsigned* stale) {
+    *hits = g_atomic_int_get(&cache_hits);
+    *misses = g_atomic_int_get(&cache_misses);
+    *stale = g_atomic_int_get(&cache_stale);
+}
+
+void gjs_bytecode_cache_report(void) {
+    gjs_debug(GJS_DEBUG_MEMORY,
+              "  Bytecode cache: %d hits, %d misses, %d stale entries, %d "
+              "precompiled",
+              g_atomic_int_get(&cache_hits), g_atomic_int_get(&cache_misses),
+              g_atomic_int_get(&cache_stale),
+              g_atomic_int_get(&precompiled_hits));
+}
@@ -0,0 +1,55 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#ifndef GJS_BYTECODE_CACHE_H_
+#define GJS_BYTECODE_CACHE_H_
+
+#include <stddef.h>  // for size_t
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/macros.h"
+
+void gjs_bytecode_cache_init(JSContext* cx);
+
+GJS_USE
+bool gjs_use_lazy_source(JSContext* cx, const char* path, const char* filename,
+                         size_t shebang_len);
+
+GJS_USE
+bool gjs_bytecode_decode_precompiled(JSContext* cx, const char* uri,
+                                     JS::MutableHandleScript script_out);
+
+GJS_JSAPI_RETURN_CONVENTION
+bool gjs_bytecode_cache_compile(JSContext* cx, const char* path,
+                                const char* script, size_t script_len,
+                                const char* filename,
+                                JS::MutableHandleScript script_out);
+
+void gjs_bytecode_cache_get_stats(unsigned* hits, unsigned* misses,
+                                  unsigned* stale);
+
+void gjs_bytecode_cache_report(void);
+
+#endif  // GJS_BYTECODE_CACHE_H_
@@ -38,9 +38,19 @@
 #include <gjs/gjs.h>
 
 static char **include_path = NULL;
+static char **bundles = nullptr;
 static char **coverage_prefixes = NULL;
 static char *coverage_output_path = NULL;
 static char *profile_output_path = nullptr;
+static char* import_profile_path = nullptr;
+/* Value of the numeric profiler options when they are not given, so that
+ * an explicit 0 or negative value can be told apart and rejected */
+#define PROFILE_OPTION_UNSET G_MININT
+static int profile_rate = PROFILE_OPTION_UNSET;
+static int profile_flight_recorder = PROFILE_OPTION_UNSET;
+static int profile_long_frame = PROFILE_OPTION_UNSET;
+static gboolean profile_native_stacks = false;
+static double profile_allocations = PROFILE_OPTION_UNSET;
 static char *command = NULL;
 static gboolean print_version = false;
 static gboolean print_js_version = false;
@@ -58,10 +68,17 @@ static GOptionEntry entries[] = {
     { "coverage-prefix", 'C', 0, G_OPTION_ARG_STRING_ARRAY, &coverage_prefixes, "Add the prefix PREFIX to the list of files to generate coverage info for", "PREFIX" },
     { "coverage-output", 0, 0, G_OPTION_ARG_STRING, &coverage_output_path, "Write coverage output to a directory DIR. This option is mandatory when using --coverage-path", "DIR", },
     { "include-path", 'I', 0, G_OPTION_ARG_STRING_ARRAY, &include_path, "Add the directory DIR to the list of directories to search for js files.", "DIR" },
+    { "bundle", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &bundles, "Load the bundle FILE and search it for js files", "FILE" },
     { "profile", 0, G_OPTION_FLAG_OPTIONAL_ARG | G_OPTION_FLAG_FILENAME,
         G_OPTION_ARG_CALLBACK, reinterpret_cast<void *>(&parse_profile_arg),
         "Enable the profiler and write output to FILE (default: gjs-$PID.syscap)",
         "FILE" },
+    { "profile-rate", 0, 0, G_OPTION_ARG_INT, &profile_rate, "Sample the stack HZ times per second when profiling (default: 1000)", "HZ" },
+    { "profile-flight-recorder", 0, 0, G_OPTION_ARG_INT, &profile_flight_recorder, "Keep only the last SECONDS of the profile in memory, and write them out on SIGUSR2 or after a long frame", "SECONDS" },
+    { "profile-long-frame", 0, 0, G_OPTION_ARG_INT, &profile_long_frame, "Mark main loop iterations longer than MS milliseconds in the profile", "MS" },
+    { "profile-native-stacks", 0, 0, G_OPTION_ARG_NONE, &profile_native_stacks, "Sample native frames as well as JS frames when profiling" },
+    { "profile-allocations", 0, 0, G_OPTION_ARG_DOUBLE, &profile_allocations, "Sample JS allocations with the given PROBABILITY when profiling, and write them to FILE-allocations.folded", "PROBABILITY" },
+    { "import-profile", 0, 0, G_OPTION_ARG_FILENAME, &import_profile_path, "Write a report of how long each import took to FILE", "FILE" },
     { "debugger", 'd', 0, G_OPTION_ARG_NONE, &debugging, "Start in debug mode" },
     { NULL }
 };
@@ -108,6 +125,61 @@ strcatv(char **strv1,
     return retval;
 }
 
+/* Application bundles are GResource files, with the modules under this path.
+ * GResource files are memory-mapped, so the modules are read in place without
+ * opening each one, and processes running the same bundle share the pages.
+ * All bundles use the same prefix, so they are merged into one directory; GIO
+ * looks up a path in the most recently registered resource first, so for a
+ * module present in several bundles, the last --bundle wins. */
+#define BUNDLE_SEARCH_PATH "resource:///org/gnome/gjs/bundle"
+
+GJS_USE
+static bool profile_option_in_range(double value, double min, double max) {
+    return value == PROFILE_OPTION_UNSET || (value >= min && value <= max);
+}
+
+/* The profiler only checks its settings with g_return_if_fail(), so catch
+ * values it would not accept here, and exit with a usage error */
+static void check_profile_options(void) {
+    const char* message = nullptr;
+
+    if (!profile_option_in_range(profile_rate, 1, 10000))
+        message = "--profile-rate must be between 1 and 10000";
+    else if (!profile_option_in_range(profile_flight_recorder, 0, G_MAXINT))
+        message = "--profile-flight-recorder must not be negative";
+    else if (!profile_option_in_range(profile_long_frame, 0, G_MAXINT))
+        message = "--profile-long-frame must not be negative";
+    else if (!profile_option_in_range(profile_allocations, 0, 1))
+        message = "--profile-allocations must be between 0 and 1";
+
+    if (message) {
+        g_printerr("%s\n", message);
+        exit(1);
+    }
+}
+
+static void mount_bundles(void) {
+    if (!bundles)
+        return;
+
+    for (char** bundle = bundles; *bundle; bundle++) {
+        GError* error = nullptr;
+        GResource* resource = g_resource_load(*bundle, &error);
+        if (!resource) {
+            g_printerr("Failed to load bundle %s: %s\n", *bundle,
+                       error->message);
+            exit(1);
+        }
+        g_resources_register(resource);
+        g_resource_unref(resource);
+    }
+
+    char* bundle_path[] = {const_cast<char*>(BUNDLE_SEARCH_PATH), nullptr};
+    char** old_include_paths = include_path;
+    include_path = strcatv(old_include_paths, bundle_path);
+    g_strfreev(old_include_paths);
+}
+
 static gboolean parse_profile_arg(const char* option_name G_GNUC_UNUSED,
                                   const char* value, void*,
                                   GError** error_out G_GNUC_UNUSED) {
@@ -238,6 +310,13 @@ main(int argc, char **argv)
 
     /* Parse again, only the GJS options this time */
     include_path = NULL;
+    bundles = nullptr;
+    import_profile_path = nullptr;
+    profile_rate = PROFILE_OPTION_UNSET;
+    profile_flight_recorder = PROFILE_OPTION_UNSET;
+    profile_long_frame = PROFILE_OPTION_UNSET;
+    profile_native_stacks = false;
+    profile_allocations = PROFILE_OPTION_UNSET;
     coverage_prefixes = NULL;
     coverage_output_path = NULL;
     command = NULL;
@@ -261,6 +340,8 @@ main(int argc, char **argv)
         exit(0);
     }
 
+    check_profile_options();
+
     gjs_argc = g_strv_length(gjs_argv);
     if (command != NULL) {
         script = command;
@@ -288,6 +369,8 @@ main(int argc, char **argv)
     /* This should be removed after a suitable time has passed */
     check_script_args_for_stray_gjs_args(script_argc, script_argv);
 
+    mount_bundles();
+
     /* Check for GJS_TRACE_FD for sysprof profiling */
     const char* env_tracefd = g_getenv("GJS_TRACE_FD");
     int tracefd = -1;
@@ -342,6 +425,22 @@ main(int argc, char **argv)
         tracefd = -1;
     }
 
+    if (enable_profiler) {
+        GjsProfiler* profiler = gjs_context_get_profiler(js_context);
+        if (profile_rate > 0)
+            gjs_profiler_set_sample_rate(profiler, profile_rate);
+        if (profile_flight_recorder > 0)
+            gjs_profiler_set_flight_recorder(profiler, profile_flight_recorder);
+        if (profile_long_frame > 0)
+            gjs_profiler_set_long_frame_threshold(profiler, profile_long_frame);
+        gjs_profiler_set_native_stacks(profiler, profile_native_stacks);
+        if (profile_allocations > 0)
+            gjs_profiler_set_allocation_sampling(profiler, profile_allocations);
+    }
+
+    if (import_profile_path)
+        gjs_context_set_import_profile_output(js_context, import_profile_path);
+
     if (tracefd != -1) {
         close(tracefd);
         tracefd = -1;
@@ -380,7 +479,9 @@ main(int argc, char **argv)
 
     g_free(coverage_output_path);
     g_free(profile_output_path);
+    g_free(import_profile_path);
     g_strfreev(coverage_prefixes);
+    g_strfreev(bundles);
     if (coverage)
         g_object_unref(coverage);
     g_object_unref(js_context);
@@ -27,6 +27,7 @@
 #include <stdint.h>
 #include <sys/types.h>  // for ssize_t
 
+#include <string>
 #include <type_traits>  // for is_same
 #include <unordered_map>
 
@@ -38,6 +39,10 @@
 
 #include "gjs/atoms.h"
 #include "gjs/context.h"
+#include "gjs/engine.h"
+#include "gjs/gc-scheduler.h"
+#include "gjs/import-prefetch.h"
+#include "gjs/import-profile.h"
 #include "gjs/jsapi-util.h"
 #include "gjs/macros.h"
 #include "gjs/profiler.h"
@@ -52,6 +57,12 @@ using GTypeTable =
     JS::GCHashMap<GType, JS::Heap<JSObject*>, js::DefaultHasher<GType>,
                   js::SystemAllocPolicy>;
 
+// What a module file looked like when it was compiled with lazy source
+struct GjsLazySource {
+    size_t len;
+    uint32_t hash;
+};
+
 struct Dummy {};
 using GTypeNotUint64 =
     std::conditional_t<!std::is_same<GType, uint64_t>::value, GType, Dummy>;
@@ -78,15 +89,34 @@ class GjsContextPrivate {
 
     char** m_search_path;
 
-    unsigned m_auto_gc_id;
+    GjsGcScheduler m_gc_scheduler;
+    GjsGcPolicy m_gc_policy;
+
+    GjsImportPrefetcher m_import_prefetcher;
+    // Bumped to discard the importers' indexes of the search path
+    unsigned m_import_cache_generation;
+    GjsImportProfile m_import_profile;
+    // Number of struct types whose C arrays are marshalled as array views
+    unsigned m_struct_array_view_types;
+
+    // Set from construct properties before the constructor runs, and resolved
+    // in gjs_create_js_context()
+    GjsEngineTuning m_tuning;
 
     GjsAtoms* m_atoms;
 
     JobQueue m_job_queue;
     unsigned m_idle_drain_handler;
+    // Limits for draining the job queue from the main loop; 0 means no limit
+    unsigned m_job_time_budget;  // microseconds
+    unsigned m_job_count_budget;
 
     std::unordered_map<uint64_t, GjsAutoChar> m_unhandled_rejection_stacks;
 
+    // Module files compiled with lazy source, keyed on the file name that the
+    // engine passes to the source hook
+    std::unordered_map<std::string, GjsLazySource> m_lazy_sources;
+
     GjsProfiler* m_profiler;
 
     /* Environment preparer needed for debugger, taken from SpiderMonkey's
@@ -117,16 +147,15 @@ class GjsContextPrivate {
     bool m_destroying : 1;
     bool m_in_gc_sweep : 1;
     bool m_should_exit : 1;
-    bool m_force_gc : 1;
     bool m_draining_job_queue : 1;
     bool m_should_profile : 1;
     bool m_should_listen_sigusr2 : 1;
+    bool m_lazy_module_source : 1;
 
     int64_t m_sweep_begin_time;
 
-    void schedule_gc_internal(bool force_gc);
-    static gboolean trigger_gc_if_needed(void* data);
     static gboolean drain_job_queue_idle_handler(void* data);
+    GJS_JSAPI_RETURN_CONVENTION bool run_jobs_internal(bool use_budget);
     void warn_about_unhandled_promise_rejections(void);
     void reset_exit(void) {
         m_should_exit = false;
@@ -162,6 +191,46 @@ class GjsContextPrivate {
     void set_should_listen_sigusr2(bool value) {
         m_should_listen_sigusr2 = value;
     }
+    GJS_USE bool lazy_module_source(void) const {
+        return m_lazy_module_source;
+    }
+    void set_lazy_module_source(bool value) { m_lazy_module_source = value; }
+    void register_lazy_source(const char* filename, const char* script,
+                              size_t script_len);
+    GJS_USE bool lazy_source_matches(const char* filename, const char* script,
+                                     size_t script_len) const;
+    GJS_USE GjsGcPolicy gc_policy(void) const { return m_gc_policy; }
+    void set_gc_policy(GjsGcPolicy value) {
+        m_gc_policy = value;
+        // Before construction, the scheduler picks it up in the constructor
+        if (m_cx)
+            m_gc_scheduler.set_policy(value);
+    }
+    GJS_USE GjsGcScheduler& gc_scheduler(void) { return m_gc_scheduler; }
+    GJS_USE GjsImportPrefetcher& import_prefetcher(void) {
+        return m_import_prefetcher;
+    }
+    GJS_USE unsigned import_cache_generation(void) const {
+        return m_import_cache_generation;
+    }
+    void invalidate_import_cache(void) { m_import_cache_generation++; }
+    GJS_USE GjsImportProfile& import_profile(void) { return m_import_profile; }
+    GJS_USE bool any_struct_array_views(void) const {
+        return m_struct_array_view_types > 0;
+    }
+    void count_struct_array_views(bool enabled) {
+        if (enabled)
+            m_struct_array_view_types++;
+        else
+            m_struct_array_view_types--;
+    }
+    GJS_USE GjsEngineTuning& tuning(void) { return m_tuning; }
+    GJS_USE unsigned job_time_budget(void) const { return m_job_time_budget; }
+    void set_job_time_budget(unsigned value) { m_job_time_budget = value; }
+    GJS_USE unsigned job_count_budget(void) const {
+        return m_job_count_budget;
+    }
+    void set_job_count_budget(unsigned value) { m_job_count_budget = value; }
     GJS_USE bool is_owner_thread(void) const {
         return m_owner_thread == g_thread_self();
     }
@@ -191,13 +260,14 @@ class GjsContextPrivate {
                        const JS::HandleValueArray& args,
                        JS::MutableHandleValue rval);
 
-    void schedule_gc(void) { schedule_gc_internal(true); }
+    void schedule_gc(void) { m_gc_scheduler.schedule(true); }
     void schedule_gc_if_needed(void);
 
     void exit(uint8_t exit_code);
     GJS_USE bool should_exit(uint8_t* exit_code_p) const;
 
     GJS_JSAPI_RETURN_CONVENTION bool enqueue_job(JS::HandleObject job);
+    GJS_USE size_t job_queue_length(void) const { return m_job_queue.length(); }
     GJS_JSAPI_RETURN_CONVENTION bool run_jobs(void);
     void register_unhandled_promise_rejection(uint64_t id, GjsAutoChar&& stack);
     void unregister_unhandled_promise_rejection(uint64_t id);
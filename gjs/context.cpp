@@ -50,6 +50,7 @@
 
 #include "gjs/jsapi-wrapper.h"
 #include "js/GCHashTable.h"  // for WeakCache
+#include "mozilla/HashFunctions.h"  // for HashBytes
 
 #include "gi/object.h"
 #include "gi/private.h"
@@ -109,6 +110,49 @@ G_DEFINE_TYPE_WITH_PRIVATE(GjsContext, gjs_context, G_TYPE_OBJECT);
 _Pragma("GCC diagnostic pop")
 #endif
 
+GType gjs_gc_policy_get_type(void) {
+    static volatile GType g_type_id;
+
+    if (g_once_init_enter(&g_type_id)) {
+        static GEnumValue policies[] = {
+            { GJS_GC_POLICY_BALANCED, "GJS_GC_POLICY_BALANCED", "balanced" },
+            { GJS_GC_POLICY_LATENCY, "GJS_GC_POLICY_LATENCY", "latency" },
+            { GJS_GC_POLICY_THROUGHPUT, "GJS_GC_POLICY_THROUGHPUT",
+              "throughput" },
+            { GJS_GC_POLICY_LOW_MEMORY, "GJS_GC_POLICY_LOW_MEMORY",
+              "low-memory" },
+            { 0, nullptr, nullptr }
+        };
+
+        g_once_init_leave(&g_type_id,
+                          g_enum_register_static("GjsGcPolicy", policies));
+    }
+
+    return g_type_id;
+}
+
+GType gjs_engine_preset_get_type(void) {
+    static volatile GType g_type_id;
+
+    if (g_once_init_enter(&g_type_id)) {
+        static GEnumValue presets[] = {
+            { GJS_ENGINE_PRESET_DEFAULT, "GJS_ENGINE_PRESET_DEFAULT",
+              "default" },
+            { GJS_ENGINE_PRESET_SMALL_DEVICE, "GJS_ENGINE_PRESET_SMALL_DEVICE",
+              "small-device" },
+            { GJS_ENGINE_PRESET_DESKTOP_SHELL,
+              "GJS_ENGINE_PRESET_DESKTOP_SHELL", "desktop-shell" },
+            { GJS_ENGINE_PRESET_BATCH, "GJS_ENGINE_PRESET_BATCH", "batch" },
+            { 0, nullptr, nullptr }
+        };
+
+        g_once_init_leave(&g_type_id,
+                          g_enum_register_static("GjsEnginePreset", presets));
+    }
+
+    return g_type_id;
+}
+
 GjsContextPrivate* GjsContextPrivate::from_object(GObject* js_context) {
     g_return_val_if_fail(GJS_IS_CONTEXT(js_context), nullptr);
     return static_cast<GjsContextPrivate*>(
@@ -127,6 +171,19 @@ enum {
     PROP_PROGRAM_NAME,
     PROP_PROFILER_ENABLED,
     PROP_PROFILER_SIGUSR2,
+    PROP_GC_POLICY,
+    PROP_ENGINE_PRESET,
+    PROP_GC_NURSERY_BYTES,
+    PROP_GC_MAX_BYTES,
+    PROP_GC_MAX_MALLOC_BYTES,
+    PROP_GC_SLICE_BUDGET,
+    PROP_GC_HEAP_GROWTH,
+    PROP_JIT_BASELINE_THRESHOLD,
+    PROP_JIT_ION_THRESHOLD,
+    PROP_DISABLE_JIT,
+    PROP_JOB_QUEUE_TIME_BUDGET,
+    PROP_JOB_QUEUE_COUNT_BUDGET,
+    PROP_LAZY_MODULE_SOURCE,
 };
 
 static GMutex contexts_lock;
@@ -202,6 +259,39 @@ setup_dump_heap(void)
     }
 }
 
+static void install_tuning_property(GObjectClass* object_class,
+                                    unsigned prop_id, const char* name,
+                                    const char* nick, const char* blurb,
+                                    unsigned max = G_MAXUINT) {
+    GParamSpec* pspec = g_param_spec_uint(
+        name, nick, blurb, 0, max, 0,
+        GParamFlags(G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+    g_object_class_install_property(object_class, prop_id, pspec);
+    g_param_spec_unref(pspec);
+}
+
+GJS_USE
+static unsigned* tuning_field(GjsEngineTuning* tuning, unsigned prop_id) {
+    switch (prop_id) {
+    case PROP_GC_NURSERY_BYTES:
+        return &tuning->nursery_bytes;
+    case PROP_GC_MAX_BYTES:
+        return &tuning->max_bytes;
+    case PROP_GC_MAX_MALLOC_BYTES:
+        return &tuning->max_malloc_bytes;
+    case PROP_GC_SLICE_BUDGET:
+        return &tuning->slice_budget;
+    case PROP_GC_HEAP_GROWTH:
+        return &tuning->heap_growth;
+    case PROP_JIT_BASELINE_THRESHOLD:
+        return &tuning->baseline_threshold;
+    case PROP_JIT_ION_THRESHOLD:
+        return &tuning->ion_threshold;
+    default:
+        return nullptr;
+    }
+}
+
 static void
 gjs_context_init(GjsContext *js_context)
 {
@@ -276,6 +366,196 @@ gjs_context_class_init(GjsContextClass *klass)
     g_object_class_install_property(object_class, PROP_PROFILER_SIGUSR2, pspec);
     g_param_spec_unref(pspec);
 
+    /**
+     * GjsContext:gc-policy:
+     *
+     * How to schedule full garbage collections, on top of the ones that the JS
+     * engine does by itself. GJS periodically compares the size of the JS
+     * heap, the memory allocated for introspected structs, and the resident
+     * set size of the process, to their values after the last collection; and
+     * if one has grown past the policy's limit, collects in idle time. See
+     * #GjsGcPolicy for the available policies.
+     *
+     * This property may be changed at any time.
+     */
+    pspec = g_param_spec_enum("gc-policy", "GC policy",
+                              "How to schedule garbage collections",
+                              GJS_TYPE_GC_POLICY, GJS_GC_POLICY_BALANCED,
+                              GParamFlags(G_PARAM_READWRITE |
+                                          G_PARAM_EXPLICIT_NOTIFY));
+    g_object_class_install_property(object_class, PROP_GC_POLICY, pspec);
+    g_param_spec_unref(pspec);
+
+    /**
+     * GjsContext:engine-preset:
+     *
+     * A set of GC and JIT parameters suited to a kind of program. The other
+     * tuning properties, if set, take precedence over the preset, and
+     * environment variables take precedence over both: GJS_ENGINE_PRESET
+     * takes the nickname of a #GjsEnginePreset, and each tuning property
+     * has a corresponding variable named after it, such as
+     * GJS_GC_NURSERY_BYTES for #GjsContext:gc-nursery-bytes.
+     *
+     * Reading the tuning properties gives the values in effect.
+     */
+    pspec = g_param_spec_enum(
+        "engine-preset", "Engine preset", "Set of GC and JIT parameters to use",
+        GJS_TYPE_ENGINE_PRESET, GJS_ENGINE_PRESET_DEFAULT,
+        GParamFlags(G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+    g_object_class_install_property(object_class, PROP_ENGINE_PRESET, pspec);
+    g_param_spec_unref(pspec);
+
+    /**
+     * GjsContext:gc-nursery-bytes:
+     *
+     * Size of the nursery, where new objects are allocated, in bytes. 0 means
+     * the value from #GjsContext:engine-preset.
+     */
+    install_tuning_property(object_class, PROP_GC_NURSERY_BYTES,
+                            "gc-nursery-bytes", "GC nursery bytes",
+                            "Size of the GC nursery");
+
+    /**
+     * GjsContext:gc-max-bytes:
+     *
+     * Maximum size of the JS heap in bytes, or %G_MAXUINT for no limit. 0
+     * means the value from #GjsContext:engine-preset.
+     */
+    install_tuning_property(object_class, PROP_GC_MAX_BYTES, "gc-max-bytes",
+                            "GC max bytes", "Maximum size of the JS heap");
+
+    /**
+     * GjsContext:gc-max-malloc-bytes:
+     *
+     * Amount of memory that the JS engine may allocate with malloc() before
+     * triggering a GC. 0 means the value from #GjsContext:engine-preset.
+     */
+    install_tuning_property(object_class, PROP_GC_MAX_MALLOC_BYTES,
+                            "gc-max-malloc-bytes", "GC max malloc bytes",
+                            "Malloc bytes that trigger a GC");
+
+    /**
+     * GjsContext:gc-slice-budget:
+     *
+     * Time budget of an incremental GC slice that the JS engine starts by
+     * itself, in milliseconds. 0 means the value from
+     * #GjsContext:engine-preset.
+     */
+    install_tuning_property(object_class, PROP_GC_SLICE_BUDGET,
+                            "gc-slice-budget", "GC slice budget",
+                            "Duration of an incremental GC slice in ms");
+
+    /**
+     * GjsContext:gc-heap-growth:
+     *
+     * Percentage of the heap size after a GC at which the next GC is
+     * triggered, from 100 to 10000. 0 means the value from
+     * #GjsContext:engine-preset; the default and desktop shell presets let
+     * the JS engine vary it depending on how often GCs happen. Values below
+     * 100 are ignored with a warning.
+     */
+    install_tuning_property(object_class, PROP_GC_HEAP_GROWTH,
+                            "gc-heap-growth", "GC heap growth",
+                            "Heap growth in percent that triggers a GC",
+                            GJS_GC_HEAP_GROWTH_MAX);
+
+    /**
+     * GjsContext:jit-baseline-threshold:
+     *
+     * Number of times a function must run before it is compiled with the
+     * baseline JIT. 0 means the value from #GjsContext:engine-preset, or if
+     * that is also 0, the JS engine's default.
+     *
+     * Note that the JIT thresholds are process-wide, so they are shared with
+     * all other contexts.
+     */
+    install_tuning_property(object_class, PROP_JIT_BASELINE_THRESHOLD,
+                            "jit-baseline-threshold", "JIT baseline threshold",
+                            "Calls before baseline JIT compilation");
+
+    /**
+     * GjsContext:jit-ion-threshold:
+     *
+     * Number of times a function must run before it is compiled with the
+     * optimizing JIT. 0 means the value from #GjsContext:engine-preset, or if
+     * that is also 0, the JS engine's default. Process-wide, like
+     * #GjsContext:jit-baseline-threshold.
+     */
+    install_tuning_property(object_class, PROP_JIT_ION_THRESHOLD,
+                            "jit-ion-threshold", "JIT Ion threshold",
+                            "Calls before optimizing JIT compilation");
+
+    /**
+     * GjsContext:disable-jit:
+     *
+     * Set this property to run JS code only in the interpreter. Setting the
+     * GJS_DISABLE_JIT environment variable has the same effect.
+     */
+    pspec = g_param_spec_boolean(
+        "disable-jit", "Disable JIT", "Whether to turn off the JIT compilers",
+        FALSE, GParamFlags(G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+    g_object_class_install_property(object_class, PROP_DISABLE_JIT, pspec);
+    g_param_spec_unref(pspec);
+
+    /**
+     * GjsContext:job-queue-time-budget:
+     *
+     * How long, in microseconds, the main loop may spend running promise
+     * callbacks before yielding. The remaining callbacks run after pending
+     * input and painting have been handled. 0, the default, means run all
+     * callbacks in one go.
+     *
+     * Note that setting a budget means that promise callbacks queued at the
+     * same time may be separated by other main loop sources. Code that runs
+     * JS, such as gjs_context_eval(), still runs all callbacks before
+     * returning.
+     */
+    pspec = g_param_spec_uint(
+        "job-queue-time-budget", "Job queue time budget",
+        "Time in microseconds to spend on promise callbacks before yielding",
+        0, G_MAXUINT, 0, G_PARAM_READWRITE);
+    g_object_class_install_property(object_class, PROP_JOB_QUEUE_TIME_BUDGET,
+                                    pspec);
+    g_param_spec_unref(pspec);
+
+    /**
+     * GjsContext:job-queue-count-budget:
+     *
+     * Like #GjsContext:job-queue-time-budget, but limits the number of promise
+     * callbacks run before yielding. 0, the default, means no limit.
+     */
+    pspec = g_param_spec_uint(
+        "job-queue-count-budget", "Job queue count budget",
+        "Number of promise callbacks to run before yielding", 0, G_MAXUINT, 0,
+        G_PARAM_READWRITE);
+    g_object_class_install_property(object_class, PROP_JOB_QUEUE_COUNT_BUDGET,
+                                    pspec);
+    g_param_spec_unref(pspec);
+
+    /**
+     * GjsContext:lazy-module-source:
+     *
+     * Set this property to not keep the source code of modules in memory after
+     * compiling them. If the source is needed again, for example by
+     * Function.prototype.toString(), it is read again from the module's file
+     * or GResource. This saves memory in programs with a lot of code, but if a
+     * module's file changes on disk while the program runs, its source is no
+     * longer available: Function.prototype.toString() gives no source for
+     * its functions, and error messages don't show its source lines.
+     *
+     * Modules from GResources always behave like this. The value of this
+     * property is superseded by the GJS_LAZY_MODULE_SOURCE environment
+     * variable.
+     */
+    pspec = g_param_spec_boolean(
+        "lazy-module-source", "Lazy module source",
+        "Whether to read module source code again when needed instead of "
+        "keeping it in memory",
+        FALSE, GParamFlags(G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+    g_object_class_install_property(object_class, PROP_LAZY_MODULE_SOURCE,
+                                    pspec);
+    g_param_spec_unref(pspec);
+
     /* For GjsPrivate */
     {
 #ifdef G_OS_WIN32
@@ -381,10 +661,13 @@ void GjsContextPrivate::dispose(void) {
         ObjectInstance::prepare_shutdown();
 
         gjs_debug(GJS_DEBUG_CONTEXT, "Disabling auto GC");
-        if (m_auto_gc_id > 0) {
-            g_source_remove(m_auto_gc_id);
-            m_auto_gc_id = 0;
-        }
+        m_gc_scheduler.cancel();
+
+        gjs_debug(GJS_DEBUG_CONTEXT, "Discarding prefetched imports");
+        m_import_prefetcher.cancel();
+
+        gjs_debug(GJS_DEBUG_CONTEXT, "Writing import profile");
+        m_import_profile.write_report();
 
         gjs_debug(GJS_DEBUG_CONTEXT, "Ending trace on global object");
         JS_RemoveExtraGCRootsTracer(m_cx, &GjsContextPrivate::trace, this);
@@ -417,10 +700,14 @@ gjs_context_finalize(GObject *object)
 
     g_mutex_lock(&contexts_lock);
     all_contexts = g_list_remove(all_contexts, object);
+    bool last_context = !all_contexts;
     g_mutex_unlock(&contexts_lock);
 
     GjsContextPrivate* gjs = GjsContextPrivate::from_object(object);
     gjs->~GjsContextPrivate();
+
+    if (last_context)
+        gjs_gtype_info_cache_free();
     G_OBJECT_CLASS(gjs_context_parent_class)->finalize(object);
 }
 
@@ -450,9 +737,19 @@ gjs_context_constructed(GObject *object)
 GjsContextPrivate::GjsContextPrivate(JSContext* cx, GjsContext* public_context)
     : m_public_context(public_context),
       m_cx(cx),
+      m_gc_scheduler(cx),
+      m_import_prefetcher(cx),
+      m_import_cache_generation(0),
+      m_import_profile(cx),
+      m_struct_array_view_types(0),
       m_environment_preparer(cx) {
     m_owner_thread = g_thread_self();
 
+    m_gc_scheduler.set_policy(m_gc_policy);
+
+    if (g_getenv("GJS_LAZY_MODULE_SOURCE"))
+        m_lazy_module_source = true;
+
     const char *env_profiler = g_getenv("GJS_ENABLE_PROFILER");
     if (env_profiler || m_should_listen_sigusr2)
         m_should_profile = true;
@@ -516,6 +813,10 @@ GjsContextPrivate::GjsContextPrivate(JSContext* cx, GjsContext* public_context)
         g_error("Failed to define properties on global object");
     }
 
+    const char* import_trace = g_getenv("GJS_IMPORT_TRACE");
+    if (import_trace)
+        m_import_prefetcher.prefetch_trace(import_trace);
+
     JS_EndRequest(m_cx);
 }
 
@@ -531,6 +832,30 @@ gjs_context_get_property (GObject     *object,
     case PROP_PROGRAM_NAME:
         g_value_set_string(value, gjs->program_name());
         break;
+    case PROP_GC_POLICY:
+        g_value_set_enum(value, gjs->gc_policy());
+        break;
+    case PROP_ENGINE_PRESET:
+        g_value_set_enum(value, gjs->tuning().preset);
+        break;
+    case PROP_GC_NURSERY_BYTES:
+    case PROP_GC_MAX_BYTES:
+    case PROP_GC_MAX_MALLOC_BYTES:
+    case PROP_GC_SLICE_BUDGET:
+    case PROP_GC_HEAP_GROWTH:
+    case PROP_JIT_BASELINE_THRESHOLD:
+    case PROP_JIT_ION_THRESHOLD:
+        g_value_set_uint(value, *tuning_field(&gjs->tuning(), prop_id));
+        break;
+    case PROP_DISABLE_JIT:
+        g_value_set_boolean(value, gjs->tuning().disable_jit);
+        break;
+    case PROP_JOB_QUEUE_TIME_BUDGET:
+        g_value_set_uint(value, gjs->job_time_budget());
+        break;
+    case PROP_JOB_QUEUE_COUNT_BUDGET:
+        g_value_set_uint(value, gjs->job_count_budget());
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -558,6 +883,48 @@ gjs_context_set_property (GObject      *object,
     case PROP_PROFILER_SIGUSR2:
         gjs->set_should_listen_sigusr2(g_value_get_boolean(value));
         break;
+    case PROP_GC_POLICY: {
+        auto policy = GjsGcPolicy(g_value_get_enum(value));
+        if (policy != gjs->gc_policy()) {
+            gjs->set_gc_policy(policy);
+            g_object_notify_by_pspec(object, pspec);
+        }
+        break;
+    }
+    case PROP_ENGINE_PRESET:
+        gjs->tuning().preset = GjsEnginePreset(g_value_get_enum(value));
+        break;
+    case PROP_GC_HEAP_GROWTH: {
+        // The pspec can't exclude these, since 0 means the preset's value
+        unsigned heap_growth = g_value_get_uint(value);
+        if (heap_growth != 0 && heap_growth < GJS_GC_HEAP_GROWTH_MIN) {
+            g_warning("Ignoring gc-heap-growth %u, which must be at least %u",
+                      heap_growth, GJS_GC_HEAP_GROWTH_MIN);
+            break;
+        }
+        gjs->tuning().heap_growth = heap_growth;
+        break;
+    }
+    case PROP_GC_NURSERY_BYTES:
+    case PROP_GC_MAX_BYTES:
+    case PROP_GC_MAX_MALLOC_BYTES:
+    case PROP_GC_SLICE_BUDGET:
+    case PROP_JIT_BASELINE_THRESHOLD:
+    case PROP_JIT_ION_THRESHOLD:
+        *tuning_field(&gjs->tuning(), prop_id) = g_value_get_uint(value);
+        break;
+    case PROP_DISABLE_JIT:
+        gjs->tuning().disable_jit = g_value_get_boolean(value);
+        break;
+    case PROP_JOB_QUEUE_TIME_BUDGET:
+        gjs->set_job_time_budget(g_value_get_uint(value));
+        break;
+    case PROP_JOB_QUEUE_COUNT_BUDGET:
+        gjs->set_job_count_budget(g_value_get_uint(value));
+        break;
+    case PROP_LAZY_MODULE_SOURCE:
+        gjs->set_lazy_module_source(g_value_get_boolean(value));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -579,43 +946,19 @@ gjs_context_new_with_search_path(char** search_path)
                          NULL);
 }
 
-gboolean GjsContextPrivate::trigger_gc_if_needed(void* data) {
-    auto* gjs = static_cast<GjsContextPrivate*>(data);
-    gjs->m_auto_gc_id = 0;
-
-    if (gjs->m_force_gc)
-        JS_GC(gjs->m_cx);
-    else
-        gjs_gc_if_needed(gjs->m_cx);
-
-    gjs->m_force_gc = false;
-
-    return G_SOURCE_REMOVE;
-}
-
-void GjsContextPrivate::schedule_gc_internal(bool force_gc) {
-    m_force_gc |= force_gc;
-
-    if (m_auto_gc_id > 0)
-        return;
-
-    m_auto_gc_id = g_timeout_add_seconds_full(G_PRIORITY_LOW, 10,
-                                              trigger_gc_if_needed, this,
-                                              nullptr);
-}
-
 /*
  * GjsContextPrivate::schedule_gc_if_needed:
  *
  * Does a minor GC immediately if the JS engine decides one is needed, but also
- * schedules a full GC in the next idle time.
+ * schedules a check for whether a full GC is needed, which then happens in idle
+ * time according to the context's GC policy.
  */
 void GjsContextPrivate::schedule_gc_if_needed(void) {
     // We call JS_MaybeGC immediately, but defer a check for a full GC cycle
-    // to an idle handler.
+    // to the GC scheduler.
     JS_MaybeGC(m_cx);
 
-    schedule_gc_internal(false);
+    m_gc_scheduler.schedule(false);
 }
 
 void GjsContextPrivate::set_sweeping(bool value) {
@@ -625,6 +968,7 @@ void GjsContextPrivate::set_sweeping(bool value) {
 
         if (value) {
             m_sweep_begin_time = now;
+            _gjs_profiler_invalidate_labels(m_profiler);
         } else {
             if (m_sweep_begin_time != 0) {
                 _gjs_profiler_add_mark(this->m_profiler, m_sweep_begin_time,
@@ -638,6 +982,29 @@ void GjsContextPrivate::set_sweeping(bool value) {
     m_in_gc_sweep = value;
 }
 
+/*
+ * GjsContextPrivate::register_lazy_source:
+ *
+ * Records the length and a hash of the UTF-8 source of a module file that is
+ * compiled with lazy source. The engine slices the source that the source hook
+ * returns using the offsets from the compile, so the hook must not return
+ * contents that differ from these; see lazy_source_matches().
+ */
+void GjsContextPrivate::register_lazy_source(const char* filename,
+                                             const char* script,
+                                             size_t script_len) {
+    m_lazy_sources[filename] = {script_len,
+                                mozilla::HashBytes(script, script_len)};
+}
+
+bool GjsContextPrivate::lazy_source_matches(const char* filename,
+                                            const char* script,
+                                            size_t script_len) const {
+    auto it = m_lazy_sources.find(filename);
+    return it != m_lazy_sources.end() && it->second.len == script_len &&
+           it->second.hash == mozilla::HashBytes(script, script_len);
+}
+
 void GjsContextPrivate::exit(uint8_t exit_code) {
     g_assert(!m_should_exit);
     m_should_exit = true;
@@ -650,14 +1017,21 @@ bool GjsContextPrivate::should_exit(uint8_t* exit_code_p) const {
     return m_should_exit;
 }
 
+// Priority at which draining the job queue continues after running out of
+// budget; just after GTK's redraw priority (G_PRIORITY_HIGH_IDLE + 20), so that
+// input and painting can happen in between.
+static const int JOB_QUEUE_YIELD_PRIORITY = G_PRIORITY_HIGH_IDLE + 30;
+
 gboolean GjsContextPrivate::drain_job_queue_idle_handler(void* data) {
     auto* gjs = static_cast<GjsContextPrivate*>(data);
-    if (!gjs->run_jobs())
+    if (!gjs->run_jobs_internal(/* use_budget = */ true))
         gjs_log_exception(gjs->context());
     /* Uncatchable exceptions are swallowed here - no way to get a handle on
      * the main loop to exit it from this idle handler */
-    g_assert(((void)"GjsContextPrivate::run_jobs() should have emptied queue",
-              gjs->m_idle_drain_handler == 0));
+    g_assert(((void)"GjsContextPrivate::run_jobs() should have emptied queue "
+              "or rescheduled itself",
+              (gjs->m_idle_drain_handler == 0) ==
+                  (gjs->m_job_queue.length() == 0)));
     return G_SOURCE_REMOVE;
 }
 
@@ -692,6 +1066,21 @@ bool GjsContextPrivate::enqueue_job(JS::HandleObject job) {
  * otherwise true.
  */
 bool GjsContextPrivate::run_jobs(void) {
+    return run_jobs_internal(/* use_budget = */ false);
+}
+
+/*
+ * GjsContextPrivate::run_jobs_internal:
+ * @use_budget: whether to stop at the limits set by the job-queue-time-budget
+ *   and job-queue-count-budget properties
+ *
+ * Implementation of run_jobs(). When draining from the main loop, the queue
+ * may be drained in several parts if limits are set; after reaching a limit,
+ * the rest of the queue is left for an idle handler at a priority that lets
+ * input and painting go first. Callers that need the queue to be empty
+ * afterwards, such as gjs_context_eval(), don't use the budget.
+ */
+bool GjsContextPrivate::run_jobs_internal(bool use_budget) {
     bool retval = true;
 
     if (m_draining_job_queue || m_should_exit)
@@ -705,14 +1094,32 @@ bool GjsContextPrivate::run_jobs(void) {
     JS::HandleValueArray args(JS::HandleValueArray::empty());
     JS::RootedValue rval(m_cx);
 
+    int64_t start_time = g_get_monotonic_time();
+    int64_t deadline = G_MAXINT64;
+    size_t max_jobs = SIZE_MAX;
+    if (use_budget && m_job_time_budget > 0)
+        deadline = start_time + m_job_time_budget;
+    if (use_budget && m_job_count_budget > 0)
+        max_jobs = m_job_count_budget;
+    size_t n_run = 0;
+    bool yielded = false;
+
     /* Execute jobs in a loop until we've reached the end of the queue.
      * Since executing a job can trigger enqueueing of additional jobs,
      * it's crucial to recheck the queue length during each iteration. */
-    for (size_t ix = 0; ix < m_job_queue.length(); ix++) {
+    size_t ix;
+    for (ix = 0; ix < m_job_queue.length(); ix++) {
         /* A previous job might have set this flag. e.g., System.exit(). */
         if (m_should_exit)
             break;
 
+        // Always run at least one job, so that draining makes progress
+        if (n_run > 0 &&
+            (n_run >= max_jobs || g_get_monotonic_time() >= deadline)) {
+            yielded = true;
+            break;
+        }
+
         job = m_job_queue[ix];
 
         /* It's possible that job draining was interrupted prematurely,
@@ -723,6 +1130,7 @@ bool GjsContextPrivate::run_jobs(void) {
             continue;
 
         m_job_queue[ix] = nullptr;
+        n_run++;
         {
             JSAutoCompartment ac(m_cx, job);
             if (!JS::Call(m_cx, JS::UndefinedHandleValue, job, args, &rval)) {
@@ -745,11 +1153,30 @@ bool GjsContextPrivate::run_jobs(void) {
     }
 
     m_draining_job_queue = false;
-    m_job_queue.clear();
+
+    if (m_profiler && n_run > 0) {
+        int64_t now = g_get_monotonic_time();
+        GjsAutoChar message = g_strdup_printf(
+            "%zu jobs run, %zu left", n_run, m_job_queue.length() - ix);
+        _gjs_profiler_add_mark(m_profiler, start_time * 1000L,
+                               (now - start_time) * 1000L, "GJS",
+                               "Promise jobs", message);
+    }
+
     if (m_idle_drain_handler) {
         g_source_remove(m_idle_drain_handler);
         m_idle_drain_handler = 0;
     }
+
+    if (yielded) {
+        m_job_queue.erase(m_job_queue.begin(), m_job_queue.begin() + ix);
+        m_idle_drain_handler =
+            g_idle_add_full(JOB_QUEUE_YIELD_PRIORITY,
+                            drain_job_queue_idle_handler, this, nullptr);
+        return retval;
+    }
+
+    m_job_queue.clear();
     return retval;
 }
 
@@ -806,6 +1233,91 @@ gjs_context_gc (GjsContext  *context)
     JS_GC(gjs->context());
 }
 
+/**
+ * gjs_context_run_gc_slice:
+ * @context: a #GjsContext
+ * @budget_us: how long the slice may take, in microseconds
+ *
+ * Runs one slice of an incremental garbage collection, taking about
+ * @budget_us. If no collection is in progress, one is started if the
+ * #GjsContext:gc-policy calls for it; otherwise this returns right away.
+ *
+ * This is meant to be called from a frame clock, with the time left over in
+ * each frame, so that collections don't happen in the middle of a frame. The
+ * budget has a granularity of one millisecond.
+ *
+ * Returns: %TRUE if the collection needs more slices to finish, %FALSE if it
+ *   finished or no collection was needed
+ */
+bool gjs_context_run_gc_slice(GjsContext* context, int64_t budget_us) {
+    g_return_val_if_fail(budget_us > 0, false);
+
+    GjsContextPrivate* gjs = GjsContextPrivate::from_object(context);
+    return gjs->gc_scheduler().run_slice(budget_us);
+}
+
+/**
+ * gjs_context_prefetch_imports:
+ * @context: a #GjsContext
+ * @paths: (array zero-terminated=1) (element-type filename): local paths of
+ *   module files that are likely to be imported soon
+ *
+ * Starts reading and compiling the given modules in background threads, so
+ * that importing them later doesn't have to wait for the disk or the parser.
+ * This is useful at startup, to overlap loading all of a program's modules.
+ *
+ * Modules imported from a prefetched path don't go through the bytecode cache.
+ * Prefetching a module that ends up not being imported only wastes some work.
+ */
+void gjs_context_prefetch_imports(GjsContext* context,
+                                  const char* const* paths) {
+    g_return_if_fail(GJS_IS_CONTEXT(context));
+    g_return_if_fail(paths);
+
+    GjsContextPrivate* gjs = GjsContextPrivate::from_object(context);
+    gjs->import_prefetcher().prefetch(paths);
+}
+
+/**
+ * gjs_context_invalidate_import_cache:
+ * @context: a #GjsContext
+ *
+ * The importers remember the contents of the directories in their search path,
+ * so that each directory is only listed once. Local directories are listed
+ * again when their modification time changes, so modules that are added or
+ * removed there are picked up by the next import without calling this.
+ * Directories in GResources are assumed not to change; call this after
+ * registering a GResource that adds modules to a directory that has already
+ * been searched.
+ */
+void gjs_context_invalidate_import_cache(GjsContext* context) {
+    g_return_if_fail(GJS_IS_CONTEXT(context));
+
+    GjsContextPrivate* gjs = GjsContextPrivate::from_object(context);
+    gjs->invalidate_import_cache();
+}
+
+/**
+ * gjs_context_set_import_profile_output:
+ * @context: a #GjsContext
+ * @filename: (type filename) (nullable): file to write the report to
+ *
+ * Starts recording how long each import takes: looking up, reading, compiling,
+ * and executing modules, as well as loading native modules and GI namespaces.
+ * When @context is disposed, a report is written to @filename, listing the
+ * imports by the time spent in each of them and as a tree.
+ *
+ * The imports are also recorded in the profiler's capture while the profiler
+ * is running, whether or not this is called.
+ */
+void gjs_context_set_import_profile_output(GjsContext* context,
+                                           const char* filename) {
+    g_return_if_fail(GJS_IS_CONTEXT(context));
+
+    GjsContextPrivate* gjs = GjsContextPrivate::from_object(context);
+    gjs->import_profile().set_output(filename);
+}
+
 /**
  * gjs_context_get_all:
  *
@@ -29,6 +29,7 @@
 #endif
 
 #include <stdbool.h>    /* IWYU pragma: keep */
+#include <stdint.h>
 #include <sys/signal.h> /* for siginfo_t */
 
 #include <glib-object.h>
@@ -51,6 +52,54 @@ typedef struct _GjsContextClass GjsContextClass;
 
 GJS_EXPORT GJS_USE GType gjs_context_get_type(void) G_GNUC_CONST;
 
+/**
+ * GjsGcPolicy:
+ * @GJS_GC_POLICY_BALANCED: the default; collect when memory use has grown by a
+ *   quarter since the last collection, in short slices during idle time, and
+ *   release unused memory back to the system after each collection
+ * @GJS_GC_POLICY_LATENCY: tolerate more growth and keep GC slices short, so
+ *   that collections are less likely to cause dropped frames
+ * @GJS_GC_POLICY_THROUGHPUT: collect seldom, and in one go when the main loop
+ *   is idle, spending the least total time in GC
+ * @GJS_GC_POLICY_LOW_MEMORY: check often, collect on small amounts of growth,
+ *   and release unused memory back to the system after each collection
+ *
+ * Policies for scheduling garbage collections, see #GjsContext:gc-policy.
+ */
+typedef enum {
+    GJS_GC_POLICY_BALANCED,
+    GJS_GC_POLICY_LATENCY,
+    GJS_GC_POLICY_THROUGHPUT,
+    GJS_GC_POLICY_LOW_MEMORY,
+} GjsGcPolicy;
+
+GJS_EXPORT
+GType gjs_gc_policy_get_type(void);
+#define GJS_TYPE_GC_POLICY gjs_gc_policy_get_type()
+
+/**
+ * GjsEnginePreset:
+ * @GJS_ENGINE_PRESET_DEFAULT: the values GJS has always used
+ * @GJS_ENGINE_PRESET_SMALL_DEVICE: a small nursery and malloc limit, fixed
+ *   heap growth, and a high threshold for optimizing JIT compilation
+ * @GJS_ENGINE_PRESET_DESKTOP_SHELL: like the default, but with shorter GC
+ *   slices
+ * @GJS_ENGINE_PRESET_BATCH: a large nursery and heap, long GC slices, and
+ *   early JIT compilation, for scripts that don't interact with a user
+ *
+ * Sets of GC and JIT parameters, see #GjsContext:engine-preset.
+ */
+typedef enum {
+    GJS_ENGINE_PRESET_DEFAULT,
+    GJS_ENGINE_PRESET_SMALL_DEVICE,
+    GJS_ENGINE_PRESET_DESKTOP_SHELL,
+    GJS_ENGINE_PRESET_BATCH,
+} GjsEnginePreset;
+
+GJS_EXPORT
+GType gjs_engine_preset_get_type(void);
+#define GJS_TYPE_ENGINE_PRESET gjs_engine_preset_get_type()
+
 GJS_EXPORT GJS_USE GjsContext* gjs_context_new(void);
 GJS_EXPORT GJS_USE GjsContext* gjs_context_new_with_search_path(
     char** search_path);
@@ -84,6 +133,17 @@ void            gjs_context_maybe_gc              (GjsContext  *context);
 GJS_EXPORT
 void            gjs_context_gc                    (GjsContext  *context);
 
+GJS_EXPORT GJS_USE bool gjs_context_run_gc_slice(GjsContext* context,
+                                                 int64_t budget_us);
+
+GJS_EXPORT void gjs_context_prefetch_imports(GjsContext* context,
+                                             const char* const* paths);
+
+GJS_EXPORT void gjs_context_invalidate_import_cache(GjsContext* context);
+
+GJS_EXPORT void gjs_context_set_import_profile_output(GjsContext* context,
+                                                      const char* filename);
+
 GJS_EXPORT GJS_USE GjsProfiler* gjs_context_get_profiler(GjsContext* self);
 
 GJS_EXPORT GJS_USE bool gjs_profiler_chain_signal(GjsContext* context,
@@ -22,6 +22,7 @@
  */
 
 #include <stdint.h>
+#include <string.h>  // for strlen
 
 #ifdef G_OS_WIN32
 #    define WIN32_LEAN_AND_MEAN
@@ -38,10 +39,12 @@
 #include "mozilla/UniquePtr.h"
 
 #include "gi/object.h"
+#include "gjs/bytecode-cache.h"
 #include "gjs/context-private.h"
 #include "gjs/engine.h"
 #include "gjs/jsapi-util.h"
 #include "gjs/macros.h"
+#include "gjs/mem-private.h"
 #include "util/log.h"
 
 /* Implementations of locale-specific operations; these are used
@@ -176,13 +179,18 @@ static void gjs_finalize_callback(JSFreeOp*, JSFinalizeStatus status,
         gjs->set_sweeping(false);
 }
 
-static void on_garbage_collect(JSContext*, JSGCStatus status, void*) {
+static void on_garbage_collect(JSContext*, JSGCStatus status, void* data) {
     /* We finalize any pending toggle refs before doing any garbage collection,
      * so that we can collect the JS wrapper objects, and in order to minimize
      * the chances of objects having a pending toggle up queued when they are
      * garbage collected. */
     if (status == JSGC_BEGIN)
         gjs_object_clear_toggles();
+
+    // The GjsContextPrivate isn't constructed yet during gjs_create_js_context()
+    auto* gjs = static_cast<GjsContextPrivate*>(data);
+    if (status == JSGC_END && gjs->context())
+        gjs->gc_scheduler().collection_finished();
 }
 
 GJS_JSAPI_RETURN_CONVENTION
@@ -211,13 +219,28 @@ static void on_promise_unhandled_rejection(
     gjs->register_unhandled_promise_rejection(id, std::move(stack));
 }
 
+/*
+ * gjs_lookup_resource_data:
+ * @uri: a resource:// URI
+ * @error: return location for a #GError
+ *
+ * Looks up the contents of @uri in the registered GResources. Used for the
+ * built-in modules, and for modules and precompiled bytecode in bundles.
+ *
+ * Returns: (transfer full) (nullable): the contents, or %NULL with @error set
+ */
+GBytes* gjs_lookup_resource_data(const char* uri, GError** error) {
+    static const char scheme[] = "resource://";
+    g_assert(g_str_has_prefix(uri, scheme));
+    return g_resources_lookup_data(uri + strlen(scheme),
+                                   G_RESOURCE_LOOKUP_FLAGS_NONE, error);
+}
+
 bool gjs_load_internal_source(JSContext* cx, const char* filename,
                               JS::UniqueTwoByteChars* src, size_t* length) {
     GError* error = nullptr;
-    const char* path = filename + 11;  // len("resource://")
-    GjsAutoPointer<GBytes, GBytes, g_bytes_unref> script_bytes;
-    script_bytes =
-        g_resources_lookup_data(path, G_RESOURCE_LOOKUP_FLAGS_NONE, &error);
+    GjsAutoPointer<GBytes, GBytes, g_bytes_unref> script_bytes =
+        gjs_lookup_resource_data(filename, &error);
     if (!script_bytes)
         return gjs_throw_gerror_message(cx, error);
 
@@ -233,12 +256,56 @@ bool gjs_load_internal_source(JSContext* cx, const char* filename,
     return true;
 }
 
+// Modules compiled with lazy source, see GjsContext:lazy-module-source. The
+// engine slices the source using the offsets from the compile, without bounds
+// checks, so if the file has changed since then, this gives back no source at
+// all rather than the new contents.
+GJS_JSAPI_RETURN_CONVENTION
+static bool load_module_source(JSContext* cx, const char* filename,
+                               JS::UniqueTwoByteChars* src, size_t* length) {
+    GjsAutoUnref<GFile> file = g_file_parse_name(filename);
+    char* contents;
+    size_t len;
+    GError* error = nullptr;
+    if (!g_file_load_contents(file, nullptr, &contents, &len, nullptr, &error))
+        return gjs_throw_gerror_message(cx, error);
+
+    GjsAutoChar script = contents;
+    if (!GjsContextPrivate::from_cx(cx)->lazy_source_matches(filename, script,
+                                                             len)) {
+        gjs_debug(GJS_DEBUG_CONTEXT,
+                  "%s has changed since it was compiled, not using its source",
+                  filename);
+        src->reset();
+        *length = 0;
+        return true;
+    }
+
+    JS::ConstUTF8CharsZ utf8(script, len);
+    JS::TwoByteCharsZ chs = JS::UTF8CharsToNewTwoByteCharsZ(cx, utf8, length);
+    if (!chs)
+        return false;
+
+    src->reset(chs.get());
+    return true;
+}
+
 class GjsSourceHook : public js::SourceHook {
     bool load(JSContext* cx, const char* filename, char16_t** src,
               size_t* length) {
         JS::UniqueTwoByteChars chars;
-        if (!gjs_load_internal_source(cx, filename, &chars, length))
-            return false;
+        if (g_str_has_prefix(filename, "resource://")) {
+            if (!gjs_load_internal_source(cx, filename, &chars, length))
+                return false;
+        } else {
+            if (!load_module_source(cx, filename, &chars, length))
+                return false;
+        }
+        if (!chars) {
+            *src = nullptr;  // the engine treats the source as unavailable
+            return true;
+        }
+        g_atomic_int_inc(&gjs_lazy_source_reloads);
         *src = chars.release();  // caller owns, per documentation of SourceHook
         return true;
     }
@@ -292,9 +359,100 @@ public:
 static GjsInit gjs_is_inited;
 #endif
 
+static const unsigned MB = 1024 * 1024;
+
+// clang-format off
+static const GjsEngineTuning preset_tuning[] = {
+    // GJS_ENGINE_PRESET_DEFAULT: what GJS has always used
+    {GJS_ENGINE_PRESET_DEFAULT, JS::DefaultNurseryBytes, G_MAXUINT, 128 * MB,
+     10, G_MAXUINT, 0, 0, false},
+    // GJS_ENGINE_PRESET_SMALL_DEVICE: small nursery, GC early, JIT less
+    {GJS_ENGINE_PRESET_SMALL_DEVICE, 1 * MB, G_MAXUINT, 32 * MB,
+     5, 150, 0, 5000, false},
+    // GJS_ENGINE_PRESET_DESKTOP_SHELL: short slices to avoid dropped frames
+    {GJS_ENGINE_PRESET_DESKTOP_SHELL, JS::DefaultNurseryBytes, G_MAXUINT,
+     128 * MB, 5, G_MAXUINT, 0, 0, false},
+    // GJS_ENGINE_PRESET_BATCH: big heap, long slices, JIT early
+    {GJS_ENGINE_PRESET_BATCH, 4 * JS::DefaultNurseryBytes, G_MAXUINT,
+     512 * MB, 50, 300, 5, 200, false},
+};
+// clang-format on
+
+static void override_from_env(const char* name, unsigned* value,
+                              unsigned min = 0, unsigned max = G_MAXUINT) {
+    const char* env = g_getenv(name);
+    if (!env)
+        return;
+
+    char* end;
+    guint64 parsed = g_ascii_strtoull(env, &end, 10);
+    if (*env == '\0' || *end != '\0' || parsed > G_MAXUINT) {
+        g_warning("Ignoring invalid value '%s' for %s", env, name);
+        return;
+    }
+    if (parsed < min || parsed > max) {
+        g_warning("Ignoring value %s for %s, which must be between %u and %u",
+                  env, name, min, max);
+        return;
+    }
+    *value = parsed;
+}
+
+static void fill_from_preset(unsigned* value, unsigned preset_value) {
+    if (*value == 0)
+        *value = preset_value;
+}
+
+void gjs_engine_tuning_resolve(GjsEngineTuning* tuning) {
+    const char* env_preset = g_getenv("GJS_ENGINE_PRESET");
+    if (env_preset) {
+        GjsAutoTypeClass<GEnumClass> enum_class(GJS_TYPE_ENGINE_PRESET);
+        GEnumValue* value = g_enum_get_value_by_nick(enum_class, env_preset);
+        if (value)
+            tuning->preset = GjsEnginePreset(value->value);
+        else
+            g_warning("Ignoring unknown GJS_ENGINE_PRESET '%s'", env_preset);
+    }
+
+    override_from_env("GJS_GC_NURSERY_BYTES", &tuning->nursery_bytes);
+    override_from_env("GJS_GC_MAX_BYTES", &tuning->max_bytes);
+    override_from_env("GJS_GC_MAX_MALLOC_BYTES", &tuning->max_malloc_bytes);
+    override_from_env("GJS_GC_SLICE_BUDGET", &tuning->slice_budget);
+    override_from_env("GJS_GC_HEAP_GROWTH", &tuning->heap_growth,
+                      GJS_GC_HEAP_GROWTH_MIN, GJS_GC_HEAP_GROWTH_MAX);
+    override_from_env("GJS_JIT_BASELINE_THRESHOLD",
+                      &tuning->baseline_threshold);
+    override_from_env("GJS_JIT_ION_THRESHOLD", &tuning->ion_threshold);
+    if (g_getenv("GJS_DISABLE_JIT"))
+        tuning->disable_jit = true;
+
+    const GjsEngineTuning& preset = preset_tuning[tuning->preset];
+    fill_from_preset(&tuning->nursery_bytes, preset.nursery_bytes);
+    fill_from_preset(&tuning->max_bytes, preset.max_bytes);
+    fill_from_preset(&tuning->max_malloc_bytes, preset.max_malloc_bytes);
+    fill_from_preset(&tuning->slice_budget, preset.slice_budget);
+    fill_from_preset(&tuning->heap_growth, preset.heap_growth);
+    fill_from_preset(&tuning->baseline_threshold, preset.baseline_threshold);
+    fill_from_preset(&tuning->ion_threshold, preset.ion_threshold);
+
+    gjs_debug(GJS_DEBUG_CONTEXT,
+              "Engine tuning: preset %d, nursery %u bytes, max heap %u bytes, "
+              "max malloc %u bytes, GC slice %u ms, heap growth %u%%, JIT %s, "
+              "baseline threshold %u, Ion threshold %u",
+              tuning->preset, tuning->nursery_bytes, tuning->max_bytes,
+              tuning->max_malloc_bytes, tuning->slice_budget,
+              tuning->heap_growth, tuning->disable_jit ? "off" : "on",
+              tuning->baseline_threshold, tuning->ion_threshold);
+}
+
 JSContext* gjs_create_js_context(GjsContextPrivate* uninitialized_gjs) {
     g_assert(gjs_is_inited);
-    JSContext *cx = JS_NewContext(32 * 1024 * 1024 /* max bytes */);
+
+    // Construct properties were already stored in the GjsContextPrivate
+    GjsEngineTuning& tuning = uninitialized_gjs->tuning();
+    gjs_engine_tuning_resolve(&tuning);
+
+    JSContext* cx = JS_NewContext(tuning.max_bytes, tuning.nursery_bytes);
     if (!cx)
         return nullptr;
 
@@ -303,22 +461,28 @@ JSContext* gjs_create_js_context(GjsContextPrivate* uninitialized_gjs) {
         return nullptr;
     }
 
-    // commented are defaults in moz-24
     JS_SetNativeStackQuota(cx, 1024 * 1024);
-    JS_SetGCParameter(cx, JSGC_MAX_MALLOC_BYTES, 128 * 1024 * 1024);
-    JS_SetGCParameter(cx, JSGC_MAX_BYTES, -1);
+    gjs_bytecode_cache_init(cx);
+    JS_SetGCParameter(cx, JSGC_MAX_MALLOC_BYTES, tuning.max_malloc_bytes);
+    JS_SetGCParameter(cx, JSGC_MAX_BYTES, tuning.max_bytes);
     JS_SetGCParameter(cx, JSGC_MODE, JSGC_MODE_INCREMENTAL);
-    JS_SetGCParameter(cx, JSGC_SLICE_TIME_BUDGET, 10); /* ms */
-    // JS_SetGCParameter(cx, JSGC_HIGH_FREQUENCY_TIME_LIMIT, 1000); /* ms */
+    JS_SetGCParameter(cx, JSGC_SLICE_TIME_BUDGET, tuning.slice_budget);
     JS_SetGCParameter(cx, JSGC_DYNAMIC_MARK_SLICE, true);
     JS_SetGCParameter(cx, JSGC_DYNAMIC_HEAP_GROWTH, true);
-    // JS_SetGCParameter(cx, JSGC_LOW_FREQUENCY_HEAP_GROWTH, 150);
-    // JS_SetGCParameter(cx, JSGC_HIGH_FREQUENCY_HEAP_GROWTH_MIN, 150);
-    // JS_SetGCParameter(cx, JSGC_HIGH_FREQUENCY_HEAP_GROWTH_MAX, 300);
-    // JS_SetGCParameter(cx, JSGC_HIGH_FREQUENCY_LOW_LIMIT, 100);
-    // JS_SetGCParameter(cx, JSGC_HIGH_FREQUENCY_HIGH_LIMIT, 500);
-    // JS_SetGCParameter(cx, JSGC_ALLOCATION_THRESHOLD, 30);
-    // JS_SetGCParameter(cx, JSGC_DECOMMIT_THRESHOLD, 32);
+    if (tuning.heap_growth != G_MAXUINT) {
+        g_assert(tuning.heap_growth >= GJS_GC_HEAP_GROWTH_MIN &&
+                 tuning.heap_growth <= GJS_GC_HEAP_GROWTH_MAX);
+        // Without dynamic heap growth, the engine ignores these and always
+        // uses a factor of 3, so pin all of the factors that it chooses from
+        // to the same value instead. Max first, since it also lowers the
+        // minimum if needed.
+        JS_SetGCParameter(cx, JSGC_HIGH_FREQUENCY_HEAP_GROWTH_MAX,
+                          tuning.heap_growth);
+        JS_SetGCParameter(cx, JSGC_HIGH_FREQUENCY_HEAP_GROWTH_MIN,
+                          tuning.heap_growth);
+        JS_SetGCParameter(cx, JSGC_LOW_FREQUENCY_HEAP_GROWTH,
+                          tuning.heap_growth);
+    }
 
     /* set ourselves as the private data */
     JS_SetContextPrivate(cx, uninitialized_gjs);
@@ -334,10 +498,11 @@ JSContext* gjs_create_js_context(GjsContextPrivate* uninitialized_gjs) {
                                            uninitialized_gjs);
 
     /* We use this to handle "lazy sources" that SpiderMonkey doesn't need to
-     * keep in memory. Most sources should be kept in memory, but we can skip
-     * doing that for the compartment bootstrap code, as it is already in memory
+     * keep in memory. By default, only code from GResources is compiled like
+     * that, such as the compartment bootstrap code, as it is already in memory
      * in the form of a GResource. Instead we use the "source hook" to
-     * retrieve it. */
+     * retrieve it. With GjsContext:lazy-module-source, module files are also
+     * read again by the hook. */
     auto hook = mozilla::MakeUnique<GjsSourceHook>();
     js::SetSourceHook(cx, std::move(hook));
 
@@ -347,7 +512,7 @@ JSContext* gjs_create_js_context(GjsContextPrivate* uninitialized_gjs) {
         JS::ContextOptionsRef(cx).setExtraWarnings(true);
     }
 
-    bool enable_jit = !(g_getenv("GJS_DISABLE_JIT"));
+    bool enable_jit = !tuning.disable_jit;
     if (enable_jit) {
         gjs_debug(GJS_DEBUG_CONTEXT, "Enabling JIT");
     }
@@ -356,5 +521,13 @@ JSContext* gjs_create_js_context(GjsContextPrivate* uninitialized_gjs) {
         .setBaseline(enable_jit)
         .setAsmJS(enable_jit);
 
+    // These are process-wide in SpiderMonkey, so the last context wins
+    if (tuning.baseline_threshold != 0)
+        JS_SetGlobalJitCompilerOption(cx, JSJITCOMPILER_BASELINE_WARMUP_TRIGGER,
+                                      tuning.baseline_threshold);
+    if (tuning.ion_threshold != 0)
+        JS_SetGlobalJitCompilerOption(cx, JSJITCOMPILER_ION_WARMUP_TRIGGER,
+                                      tuning.ion_threshold);
+
     return cx;
 }
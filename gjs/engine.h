@@ -26,12 +26,45 @@
 
 #include <stddef.h>  // for size_t
 
+#include <glib.h>
+
 #include "gjs/jsapi-wrapper.h"
 
+#include "gjs/context.h"
+
 class GjsContextPrivate;
 
+/*
+ * GjsEngineTuning:
+ *
+ * GC and JIT parameters for a new JS context. A value of 0 means "use the
+ * preset's value". gjs_engine_tuning_resolve() replaces those, and applies
+ * overrides from the environment, so that afterwards every field holds the
+ * value in effect; except that a JIT threshold of 0 then means SpiderMonkey's
+ * built-in default.
+ */
+struct GjsEngineTuning {
+    GjsEnginePreset preset;
+    unsigned nursery_bytes;
+    unsigned max_bytes;  // G_MAXUINT means unlimited
+    unsigned max_malloc_bytes;
+    unsigned slice_budget;  // ms
+    unsigned heap_growth;   // percent; G_MAXUINT means dynamic
+    unsigned baseline_threshold;
+    unsigned ion_threshold;
+    bool disable_jit;
+};
+
+// Range of heap growth percentages that SpiderMonkey accepts
+#define GJS_GC_HEAP_GROWTH_MIN 100
+#define GJS_GC_HEAP_GROWTH_MAX 10000
+
+void gjs_engine_tuning_resolve(GjsEngineTuning* tuning);
+
 JSContext* gjs_create_js_context(GjsContextPrivate* uninitialized_gjs);
 
+GBytes* gjs_lookup_resource_data(const char* uri, GError** error);
+
 bool gjs_load_internal_source(JSContext* cx, const char* filename,
                               JS::UniqueTwoByteChars* src, size_t* length);
 
@@ -0,0 +1,323 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <stdio.h>  // for sscanf
+
+#include <algorithm>  // for max
+
+#ifdef __linux__
+#    include <fcntl.h>   // for open, O_RDONLY, O_CLOEXEC
+#    include <unistd.h>  // for pread, close, sysconf
+#endif
+
+#include <glib.h>
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/gc-scheduler.h"
+#include "gjs/mem-private.h"
+#include "util/log.h"
+
+// Don't consider growth of less than this; otherwise a handful of structs
+// allocated right after a collection would trigger the next one.
+static const size_t MIN_GROWTH = 1024 * 1024;
+
+// Rate limit synchronous collections in collect_if_needed() to at most one per
+// 5 frames. One frame is 16666 microseconds (1000000/60)
+static const int64_t MIN_CHECK_INTERVAL = 5 * 16666;
+
+// clang-format off
+const GjsGcScheduler::Params GjsGcScheduler::policy_params[] = {
+    /* GJS_GC_POLICY_BALANCED */   {10, 1.25, 10, GC_SHRINK},
+    /* GJS_GC_POLICY_LATENCY */    {10, 1.5,  5,  GC_NORMAL},
+    /* GJS_GC_POLICY_THROUGHPUT */ {30, 2.0,  0,  GC_NORMAL},
+    /* GJS_GC_POLICY_LOW_MEMORY */ {2,  1.1,  10, GC_SHRINK},
+};
+// clang-format on
+
+GjsGcScheduler::GjsGcScheduler(JSContext* cx)
+    : m_cx(cx),
+      m_policy(GJS_GC_POLICY_BALANCED),
+      m_check_id(0),
+      m_slice_id(0),
+      m_heap_baseline(0),
+      m_wrapper_baseline(0),
+      m_rss_baseline(0),
+      m_last_check_time(0),
+      m_statm_fd(-1),
+      m_force(false) {
+#ifdef __linux__
+    // Keep the file open; reading it again with pread() is cheap, unlike
+    // parsing /proc/self/stat from a fresh g_file_get_contents() every time
+    m_statm_fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+#endif
+}
+
+GjsGcScheduler::~GjsGcScheduler(void) {
+    cancel();
+#ifdef __linux__
+    if (m_statm_fd >= 0)
+        close(m_statm_fd);
+#endif
+}
+
+void GjsGcScheduler::set_policy(GjsGcPolicy policy) {
+    g_return_if_fail(policy >= GJS_GC_POLICY_BALANCED &&
+                     policy <= GJS_GC_POLICY_LOW_MEMORY);
+
+    if (policy == m_policy)
+        return;
+
+    gjs_debug(GJS_DEBUG_CONTEXT, "GC policy changed from %d to %d", m_policy,
+              policy);
+    m_policy = policy;
+
+    // The check interval may have changed
+    if (m_check_id > 0) {
+        g_source_remove(m_check_id);
+        m_check_id = 0;
+        schedule(false);
+    }
+}
+
+size_t GjsGcScheduler::heap_bytes(void) const {
+    return JS_GetGCParameter(m_cx, JSGC_BYTES);
+}
+
+size_t GjsGcScheduler::rss_bytes(void) const {
+#ifdef __linux__
+    if (m_statm_fd < 0)
+        return 0;
+
+    char buf[128];
+    ssize_t len = pread(m_statm_fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+        return 0;
+    buf[len] = '\0';
+
+    // See "man proc"; the second field is the resident set size in pages
+    unsigned long vm_pages, rss_pages;
+    if (sscanf(buf, "%lu %lu", &vm_pages, &rss_pages) != 2)
+        return 0;
+
+    static const long page_size = sysconf(_SC_PAGESIZE);
+    return rss_pages * page_size;
+#else
+    return 0;
+#endif
+}
+
+// Whether a measurement has grown past its trigger. If it has shrunk well below
+// the last baseline (e.g. by memory being released in the background after a
+// collection) the baseline is lowered, so that the trigger follows it.
+GJS_USE
+static bool grown_past_trigger(size_t current, size_t* baseline,
+                               double growth_factor) {
+    if (current > *baseline * growth_factor + MIN_GROWTH)
+        return true;
+    if (current < *baseline * 0.75)
+        *baseline = current;
+    return false;
+}
+
+bool GjsGcScheduler::needs_gc(void) {
+    double factor = params().growth_factor;
+
+    // The baselines start at 0, so the first check always collects. In theory
+    // using RSS is bad if we get swapped out, since we may be overzealous in
+    // GC, but on the other hand, if swapping is going on, better to GC.
+    size_t heap = heap_bytes();
+    size_t wrappers = GJS_GET_WRAPPER_BYTES();
+    size_t rss = rss_bytes();
+    bool heap_grew = grown_past_trigger(heap, &m_heap_baseline, factor);
+    bool wrappers_grew =
+        grown_past_trigger(wrappers, &m_wrapper_baseline, factor);
+    bool rss_grew = grown_past_trigger(rss, &m_rss_baseline, factor);
+
+    if (heap_grew || wrappers_grew || rss_grew)
+        gjs_debug(GJS_DEBUG_CONTEXT,
+                  "GC needed: JS heap %zu bytes%s, wrappers %zu bytes%s, RSS "
+                  "%zu bytes%s",
+                  heap, heap_grew ? " (grew)" : "", wrappers,
+                  wrappers_grew ? " (grew)" : "", rss,
+                  rss_grew ? " (grew)" : "");
+
+    return heap_grew || wrappers_grew || rss_grew;
+}
+
+/*
+ * GjsGcScheduler::schedule:
+ * @force: whether to do a collection regardless of memory use
+ *
+ * Arranges for memory use to be checked after the policy's interval, and for a
+ * collection to be done in idle time if needed. Does nothing if a check or a
+ * collection is already pending.
+ */
+void GjsGcScheduler::schedule(bool force) {
+    m_force |= force;
+
+    if (m_check_id > 0 || m_slice_id > 0)
+        return;
+
+    m_check_id = g_timeout_add_seconds_full(
+        G_PRIORITY_LOW, params().check_interval, on_check_timeout, this,
+        nullptr);
+}
+
+gboolean GjsGcScheduler::on_check_timeout(void* data) {
+    auto* self = static_cast<GjsGcScheduler*>(data);
+    self->m_check_id = 0;
+
+    if (self->m_force || self->needs_gc())
+        self->begin_collection();
+
+    self->m_force = false;
+    return G_SOURCE_REMOVE;
+}
+
+void GjsGcScheduler::begin_collection(void) {
+    if (m_slice_id > 0)
+        return;
+
+    m_slice_id = g_idle_add_full(G_PRIORITY_LOW, on_slice_idle, this, nullptr);
+}
+
+gboolean GjsGcScheduler::on_slice_idle(void* data) {
+    auto* self = static_cast<GjsGcScheduler*>(data);
+    JSContext* cx = self->m_cx;
+    const Params& params = self->params();
+
+    JSAutoRequest ar(cx);
+
+    JS::PrepareForFullGC(cx);
+    if (params.slice_budget == 0) {
+        JS::GCForReason(cx, params.kind, JS::gcreason::API);
+    } else {
+        if (JS::IsIncrementalGCInProgress(cx))
+            JS::IncrementalGCSlice(cx, JS::gcreason::API, params.slice_budget);
+        else
+            JS::StartIncrementalGC(cx, params.kind, JS::gcreason::API,
+                                   params.slice_budget);
+    }
+
+    if (JS::IsIncrementalGCInProgress(cx))
+        return G_SOURCE_CONTINUE;
+
+    self->m_slice_id = 0;
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * GjsGcScheduler::collect_if_needed:
+ *
+ * Does a full collection right away if memory use has grown past the policy's
+ * trigger. Rate limited, so that it can be called from a frame clock.
+ */
+void GjsGcScheduler::collect_if_needed(void) {
+    int64_t now = g_get_monotonic_time();
+    if (now - m_last_check_time < MIN_CHECK_INTERVAL)
+        return;
+    m_last_check_time = now;
+
+    if (!needs_gc())
+        return;
+
+    JS::PrepareForFullGC(m_cx);
+    JS::GCForReason(m_cx, params().kind, JS::gcreason::API);
+}
+
+/*
+ * GjsGcScheduler::run_slice:
+ * @budget_us: time budget for the slice, in microseconds
+ *
+ * Runs one slice of the collection in progress. If there is none, starts one if
+ * the scheduler was waiting for idle time to do so, or if memory use has grown
+ * past the policy's trigger; the latter is rate limited like
+ * collect_if_needed(), so this can be called every frame.
+ *
+ * SpiderMonkey measures slice budgets in milliseconds, so @budget_us is rounded
+ * down to a whole number of milliseconds, but not below 1.
+ *
+ * Returns: whether the collection needs more slices to finish.
+ */
+bool GjsGcScheduler::run_slice(int64_t budget_us) {
+    int64_t budget = std::max(budget_us / 1000, int64_t(1));
+
+    JSAutoRequest ar(m_cx);
+
+    if (JS::IsIncrementalGCInProgress(m_cx)) {
+        JS::PrepareForFullGC(m_cx);
+        JS::IncrementalGCSlice(m_cx, JS::gcreason::API, budget);
+    } else {
+        if (m_slice_id == 0 && !m_force) {
+            int64_t now = g_get_monotonic_time();
+            if (now - m_last_check_time < MIN_CHECK_INTERVAL)
+                return false;
+            m_last_check_time = now;
+
+            if (!needs_gc())
+                return false;
+        }
+
+        m_force = false;
+        JS::PrepareForFullGC(m_cx);
+        JS::StartIncrementalGC(m_cx, params().kind, JS::gcreason::API, budget);
+    }
+
+    if (JS::IsIncrementalGCInProgress(m_cx))
+        return true;
+
+    // Finished within the budget; no need for the idle handler any more
+    if (m_slice_id > 0) {
+        g_source_remove(m_slice_id);
+        m_slice_id = 0;
+    }
+    return false;
+}
+
+/*
+ * GjsGcScheduler::collection_finished:
+ *
+ * Called at the end of every collection, including the ones the JS engine
+ * starts by itself, to record the measurements against which growth is
+ * compared.
+ */
+void GjsGcScheduler::collection_finished(void) {
+    m_heap_baseline = heap_bytes();
+    m_wrapper_baseline = GJS_GET_WRAPPER_BYTES();
+    m_rss_baseline = rss_bytes();
+}
+
+void GjsGcScheduler::cancel(void) {
+    if (m_check_id > 0) {
+        g_source_remove(m_check_id);
+        m_check_id = 0;
+    }
+    if (m_slice_id > 0) {
+        g_source_remove(m_slice_id);
+        m_slice_id = 0;
+    }
+    m_force = false;
+}
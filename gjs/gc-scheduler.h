@@ -0,0 +1,102 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GJS_GC_SCHEDULER_H_
+#define GJS_GC_SCHEDULER_H_
+
+#include <stddef.h>  // for size_t
+#include <stdint.h>
+
+#include <glib.h>
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/context.h"
+#include "gjs/macros.h"
+
+/*
+ * GjsGcScheduler:
+ *
+ * Decides when to do full garbage collections, on top of the ones that the JS
+ * engine schedules by itself. The engine only knows about the size of the JS
+ * heap, but a small JS wrapper can keep alive a large amount of memory on the
+ * C side, so this also takes into account the memory that GJS allocates for
+ * introspected structs, and the resident set size of the process.
+ *
+ * Memory use is checked periodically on a low-priority timeout. When one of the
+ * measurements has grown by more than the policy allows since the end of the
+ * last collection, a collection is run in incremental slices from a
+ * low-priority idle handler, so that it only proceeds when the main loop has
+ * nothing else to do.
+ */
+class GjsGcScheduler {
+    JSContext* m_cx;
+    GjsGcPolicy m_policy;
+
+    unsigned m_check_id;  // timeout source, checks if a collection is needed
+    unsigned m_slice_id;  // idle source, runs slices of a pending collection
+
+    // Measurements at the end of the last collection
+    size_t m_heap_baseline;
+    size_t m_wrapper_baseline;
+    size_t m_rss_baseline;
+
+    int64_t m_last_check_time;
+    int m_statm_fd;
+
+    bool m_force : 1;
+
+    struct Params {
+        unsigned check_interval;  // seconds
+        double growth_factor;
+        int64_t slice_budget;  // ms; 0 means non-incremental
+        JSGCInvocationKind kind;
+    };
+    static const Params policy_params[];
+    GJS_USE const Params& params(void) const {
+        return policy_params[m_policy];
+    }
+
+    GJS_USE size_t heap_bytes(void) const;
+    GJS_USE size_t rss_bytes(void) const;
+    GJS_USE bool needs_gc(void);
+    void begin_collection(void);
+
+    static gboolean on_check_timeout(void* data);
+    static gboolean on_slice_idle(void* data);
+
+ public:
+    explicit GjsGcScheduler(JSContext* cx);
+    ~GjsGcScheduler(void);
+
+    GJS_USE GjsGcPolicy policy(void) const { return m_policy; }
+    void set_policy(GjsGcPolicy policy);
+
+    void schedule(bool force);
+    void collect_if_needed(void);
+    GJS_USE bool run_slice(int64_t budget_us);
+    void collection_finished(void);
+    void cancel(void);
+};
+
+#endif  // GJS_GC_SCHEDULER_H_
@@ -30,6 +30,7 @@
 #include "gjs/jsapi-wrapper.h"
 
 #include "gjs/atoms.h"
+#include "gjs/bytecode-cache.h"
 #include "gjs/context-private.h"
 #include "gjs/engine.h"
 #include "gjs/global.h"
@@ -46,19 +47,22 @@ run_bootstrap(JSContext       *cx,
 
     JSAutoCompartment ac(cx, global);
 
-    JS::CompileOptions options(cx);
-    options.setUTF8(true)
-           .setFileAndLine(uri, 1)
-           .setSourceIsLazy(true);
-
-    JS::UniqueTwoByteChars script;
-    size_t script_len;
-    if (!gjs_load_internal_source(cx, uri.get(), &script, &script_len))
-        return false;
-
     JS::RootedScript compiled_script(cx);
-    if (!JS::Compile(cx, options, script.get(), script_len, &compiled_script))
-        return false;
+    if (!gjs_bytecode_decode_precompiled(cx, uri, &compiled_script)) {
+        JS::CompileOptions options(cx);
+        options.setUTF8(true)
+               .setFileAndLine(uri, 1)
+               .setSourceIsLazy(true);
+
+        JS::UniqueTwoByteChars script;
+        size_t script_len;
+        if (!gjs_load_internal_source(cx, uri.get(), &script, &script_len))
+            return false;
+
+        if (!JS::Compile(cx, options, script.get(), script_len,
+                         &compiled_script))
+            return false;
+    }
 
     JS::RootedValue ignored(cx);
     return JS::CloneAndExecuteScript(cx, compiled_script, &ignored);
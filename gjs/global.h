@@ -36,6 +36,8 @@ typedef enum {
     GJS_GLOBAL_SLOT_PROTOTYPE_repo,
     GJS_GLOBAL_SLOT_PROTOTYPE_byte_array,
     GJS_GLOBAL_SLOT_PROTOTYPE_importer,
+    GJS_GLOBAL_SLOT_PROTOTYPE_text_decoder,
+    GJS_GLOBAL_SLOT_PROTOTYPE_text_encoder,
     GJS_GLOBAL_SLOT_PROTOTYPE_cairo_context,
     GJS_GLOBAL_SLOT_PROTOTYPE_cairo_gradient,
     GJS_GLOBAL_SLOT_PROTOTYPE_cairo_image_surface,
@@ -0,0 +1,387 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <config.h>
+
+#include <stddef.h>  // for size_t
+
+#include <string>
+#include <utility>  // for move
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/bytecode-cache.h"
+#include "gjs/context-private.h"
+#include "gjs/import-prefetch.h"
+#include "gjs/jsapi-util.h"
+#include "gjs/mem-private.h"
+#include "util/log.h"
+
+// Modules that were imported from a prefetched script, and those that were
+// prefetched but had to be compiled by the importer after all
+static volatile int prefetch_hits = 0;
+static volatile int prefetch_failures = 0;
+
+struct GjsImportPrefetcher::Entry {
+    enum State { READING, READ, COMPILING, COMPILED, FAILED };
+
+    GjsImportPrefetcher* prefetcher;
+    std::string path;
+    State state;
+
+    GjsAutoChar contents;
+    size_t len;
+
+    // Must stay alive while SpiderMonkey is compiling from it
+    std::u16string source;
+    GjsAutoChar filename;
+    void* token;
+
+    Entry(GjsImportPrefetcher* p, const char* file_path)
+        : prefetcher(p), path(file_path), state(READING), len(0),
+          token(nullptr) {}
+};
+
+GjsImportPrefetcher::GjsImportPrefetcher(JSContext* cx)
+    : m_cx(cx), m_read_pool(nullptr), m_start_id(0) {
+    g_mutex_init(&m_lock);
+    g_cond_init(&m_cond);
+}
+
+GjsImportPrefetcher::~GjsImportPrefetcher(void) {
+    cancel();
+    g_cond_clear(&m_cond);
+    g_mutex_clear(&m_lock);
+}
+
+/*
+ * GjsImportPrefetcher::prefetch:
+ * @paths: %NULL-terminated array of local paths of module files
+ *
+ * Starts reading and compiling the given modules in the background. Paths that
+ * are already being prefetched are ignored.
+ */
+void GjsImportPrefetcher::prefetch(const char* const* paths) {
+    if (!m_read_pool) {
+        m_read_pool = g_thread_pool_new(read_func, this, g_get_num_processors(),
+                                        false, nullptr);
+    }
+
+    for (const char* const* path = paths; *path; path++) {
+        if (m_entries.count(*path) > 0)
+            continue;
+
+        auto* entry = new Entry(this, *path);
+        m_entries.emplace(*path, std::unique_ptr<Entry>(entry));
+        g_thread_pool_push(m_read_pool, entry, nullptr);
+    }
+
+    gjs_debug(GJS_DEBUG_IMPORTER, "Prefetching %zu modules", m_entries.size());
+}
+
+/*
+ * GjsImportPrefetcher::prefetch_trace:
+ * @trace_file: file with one module path per line
+ *
+ * Prefetches the modules recorded in @trace_file by a previous run, if it
+ * exists, and starts recording the modules imported in this run to write back
+ * to it.
+ */
+void GjsImportPrefetcher::prefetch_trace(const char* trace_file) {
+    m_trace_file = g_strdup(trace_file);
+
+    char* contents;
+    if (!g_file_get_contents(trace_file, &contents, nullptr, nullptr))
+        return;
+
+    GjsAutoStrv paths = g_strsplit(contents, "\n", -1);
+    g_free(contents);
+
+    // Skip the empty line after the last newline
+    GjsAutoStrv nonempty = g_new0(char*, g_strv_length(paths) + 1);
+    size_t n_nonempty = 0;
+    for (char** path = paths; *path; path++) {
+        if (**path)
+            nonempty[n_nonempty++] = g_strdup(*path);
+    }
+
+    prefetch(nonempty);
+}
+
+/* Records an imported module for the import trace, if one is being kept */
+void GjsImportPrefetcher::record(const char* path) {
+    if (m_trace_file && path)
+        m_trace.emplace_back(path);
+}
+
+void GjsImportPrefetcher::write_trace(void) {
+    if (!m_trace_file)
+        return;
+
+    std::string contents;
+    for (const std::string& path : m_trace) {
+        contents += path;
+        contents += '\n';
+    }
+
+    GError* error = nullptr;
+    if (!g_file_set_contents(m_trace_file, contents.c_str(), contents.size(),
+                             &error)) {
+        g_warning("Failed to write import trace %s: %s", m_trace_file.get(),
+                  error->message);
+        g_error_free(error);
+    }
+    m_trace_file.reset();
+    m_trace.clear();
+}
+
+// Runs on the thread pool
+void GjsImportPrefetcher::read_func(void* data, void* user_data) {
+    auto* entry = static_cast<Entry*>(data);
+    auto* self = static_cast<GjsImportPrefetcher*>(user_data);
+
+    char* contents;
+    size_t len;
+    bool ok = g_file_get_contents(entry->path.c_str(), &contents, &len, nullptr);
+
+    g_mutex_lock(&self->m_lock);
+    if (ok) {
+        entry->contents = contents;
+        entry->len = len;
+        entry->state = Entry::READ;
+        self->m_ready.push_back(entry);
+        if (self->m_start_id == 0)
+            self->m_start_id = g_idle_add_full(G_PRIORITY_HIGH_IDLE,
+                                               on_start_idle, self, nullptr);
+    } else {
+        entry->state = Entry::FAILED;
+    }
+    g_cond_broadcast(&self->m_cond);
+    g_mutex_unlock(&self->m_lock);
+}
+
+// Runs on a SpiderMonkey helper thread
+void GjsImportPrefetcher::on_compiled(void* token, void* data) {
+    auto* entry = static_cast<Entry*>(data);
+    GjsImportPrefetcher* self = entry->prefetcher;
+
+    g_mutex_lock(&self->m_lock);
+    entry->token = token;
+    entry->state = Entry::COMPILED;
+    g_cond_broadcast(&self->m_cond);
+    g_mutex_unlock(&self->m_lock);
+}
+
+gboolean GjsImportPrefetcher::on_start_idle(void* data) {
+    auto* self = static_cast<GjsImportPrefetcher*>(data);
+
+    g_mutex_lock(&self->m_lock);
+    self->m_start_id = 0;
+    g_mutex_unlock(&self->m_lock);
+
+    JSObject* global = GjsContextPrivate::from_cx(self->m_cx)->global();
+    if (global) {
+        JSAutoRequest ar(self->m_cx);
+        JSAutoCompartment ac(self->m_cx, global);
+        self->start_compiles();
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Hands a file that has been read to SpiderMonkey's helper threads, compiling
+ * it the same way as gjs_bytecode_cache_compile() would. Must be called on the
+ * main thread, in a compartment. */
+void GjsImportPrefetcher::start_compile(Entry* entry) {
+    entry->source = gjs_utf8_script_to_utf16(entry->contents, entry->len);
+
+    unsigned start_line_number = 1;
+    size_t offset = gjs_unix_shebang_len(entry->source, &start_line_number);
+
+    GjsAutoUnref<GFile> file = g_file_new_for_path(entry->path.c_str());
+    entry->filename = g_file_get_parse_name(file);
+
+    JS::CompileOptions options(m_cx);
+    options.setFileAndLine(entry->filename, start_line_number)
+        .setNonSyntacticScope(true);
+    if (gjs_use_lazy_source(m_cx, entry->path.c_str(), entry->filename,
+                            offset)) {
+        options.setSourceIsLazy(true);
+        GJS_ADD_LAZY_SOURCE_BYTES(entry->source.size() * sizeof(char16_t));
+        GjsContextPrivate::from_cx(m_cx)->register_lazy_source(
+            entry->filename, entry->contents, entry->len);
+    }
+    entry->contents.reset();
+    // SpiderMonkey would otherwise refuse to compile small files off thread,
+    // but here we want the main thread to be free for other work regardless
+    options.forceAsync = true;
+
+    const char16_t* chars = entry->source.c_str() + offset;
+    size_t len = entry->source.size() - offset;
+
+    bool can_compile = JS::CanCompileOffThread(m_cx, options, len);
+
+    // Don't hold the lock while calling into SpiderMonkey, since on_compiled()
+    // may be called with SpiderMonkey's helper thread lock held
+    g_mutex_lock(&m_lock);
+    entry->state = can_compile ? Entry::COMPILING : Entry::FAILED;
+    g_mutex_unlock(&m_lock);
+
+    if (can_compile &&
+        !JS::CompileOffThread(m_cx, options, chars, len, on_compiled, entry)) {
+        JS_ClearPendingException(m_cx);
+        g_mutex_lock(&m_lock);
+        entry->state = Entry::FAILED;
+        g_mutex_unlock(&m_lock);
+    }
+}
+
+/* Starts compiling the files that were read since the last call. Must be
+ * called on the main thread, in a compartment. */
+void GjsImportPrefetcher::start_compiles(void) {
+    std::vector<Entry*> ready;
+
+    g_mutex_lock(&m_lock);
+    ready.swap(m_ready);
+    g_mutex_unlock(&m_lock);
+
+    for (Entry* entry : ready)
+        start_compile(entry);
+}
+
+/*
+ * GjsImportPrefetcher::take:
+ * @path: local path of the module file
+ * @script_out: (out): the compiled script, or %nullptr
+ *
+ * If @path was prefetched, waits for its compilation to finish and returns the
+ * script, which can only be taken once. If @path was not prefetched, or could
+ * not be compiled off the main thread, @script_out is set to %nullptr and the
+ * caller should compile the module itself.
+ *
+ * Returns: false if an exception is pending, e.g. a syntax error in the module.
+ */
+bool GjsImportPrefetcher::take(const char* path,
+                               JS::MutableHandleScript script_out) {
+    script_out.set(nullptr);
+
+    if (m_entries.empty())
+        return true;
+
+    // Any import is a good opportunity to keep the pipeline going
+    start_compiles();
+
+    auto it = m_entries.find(path);
+    if (it == m_entries.end())
+        return true;
+
+    std::unique_ptr<Entry> entry = std::move(it->second);
+    m_entries.erase(it);
+
+    // Off-thread parsing is held up while an incremental GC is collecting
+    // atoms, and would never finish while we block the main thread waiting
+    // for it
+    if (JS::IsIncrementalGCInProgress(m_cx))
+        JS::FinishIncrementalGC(m_cx, JS::gcreason::API);
+
+    Entry::State state;
+    for (;;) {
+        g_mutex_lock(&m_lock);
+        while (entry->state == Entry::READING ||
+               entry->state == Entry::COMPILING)
+            g_cond_wait(&m_cond, &m_lock);
+        state = entry->state;
+        g_mutex_unlock(&m_lock);
+
+        // Read in the meantime, but not yet started; this also takes it out
+        // of m_ready, so that it is not left there after it is freed
+        if (state != Entry::READ)
+            break;
+        start_compiles();
+    }
+
+    if (state != Entry::COMPILED) {
+        gjs_debug(GJS_DEBUG_IMPORTER, "Prefetching %s failed", path);
+        g_atomic_int_inc(&prefetch_failures);
+        return true;
+    }
+
+    gjs_debug(GJS_DEBUG_IMPORTER, "Using prefetched script for %s", path);
+    g_atomic_int_inc(&prefetch_hits);
+    script_out.set(JS::FinishOffThreadScript(m_cx, entry->token));
+    return !!script_out;
+}
+
+/*
+ * GjsImportPrefetcher::cancel:
+ *
+ * Discards all prefetched scripts that were not taken, and writes the import
+ * trace if one is being kept. Must be called before the JS context is
+ * destroyed.
+ */
+void GjsImportPrefetcher::cancel(void) {
+    if (m_read_pool) {
+        // Drop the reads that have not started yet, wait for the others
+        g_thread_pool_free(m_read_pool, true, true);
+        m_read_pool = nullptr;
+    }
+
+    g_mutex_lock(&m_lock);
+    if (m_start_id > 0) {
+        g_source_remove(m_start_id);
+        m_start_id = 0;
+    }
+    m_ready.clear();
+    for (auto& it : m_entries) {
+        Entry* entry = it.second.get();
+        while (entry->state == Entry::COMPILING)
+            g_cond_wait(&m_cond, &m_lock);
+        if (entry->state == Entry::COMPILED) {
+            g_mutex_unlock(&m_lock);
+            JS::CancelOffThreadScript(m_cx, entry->token);
+            g_mutex_lock(&m_lock);
+        }
+    }
+    g_mutex_unlock(&m_lock);
+
+    m_entries.clear();
+    write_trace();
+}
+
+/*
+ * gjs_import_prefetch_get_stats:
+ * @hits: (out): number of modules imported from a prefetched script
+ * @failures: (out): number of prefetched modules that could not be read or
+ *   compiled in the background, and were compiled by the importer instead
+ *
+ * Gets the prefetch statistics of all contexts since the process started, for
+ * the tests.
+ */
+void gjs_import_prefetch_get_stats(unsigned* hits, unsigned* failures) {
+    *hits = g_atomic_int_get(&prefetch_hits);
+    *failures = g_atomic_int_get(&prefetch_failures);
+}
@@ -0,0 +1,104 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#ifndef GJS_IMPORT_PREFETCH_H_
+#define GJS_IMPORT_PREFETCH_H_
+
+#include <memory>  // for unique_ptr
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glib.h>
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/jsapi-util.h"
+#include "gjs/macros.h"
+
+/*
+ * GjsImportPrefetcher:
+ *
+ * Reads and compiles modules in the background before they are imported, so
+ * that at startup the I/O and parsing of many modules can overlap with each
+ * other and with running the program, instead of happening one after another
+ * inside the importer.
+ *
+ * Files are read on a thread pool, and as soon as the main thread gets a chance
+ * (from an idle handler, or when any module is imported) their compilation is
+ * handed to SpiderMonkey's helper threads with JS::CompileOffThread(). When the
+ * importer gets to a prefetched module, take() waits for its compilation to
+ * finish instead of compiling it on the main thread.
+ *
+ * If the GJS_IMPORT_TRACE environment variable is set to a file name, the
+ * modules listed in that file are prefetched when the context is created, and
+ * the modules that were actually imported are written back to it when the
+ * context is destroyed, so that the next run can prefetch them.
+ */
+class GjsImportPrefetcher {
+    struct Entry;
+
+    JSContext* m_cx;
+    GThreadPool* m_read_pool;
+
+    // Protects the state of the entries, m_ready, and m_start_id
+    GMutex m_lock;
+    GCond m_cond;
+    unsigned m_start_id;  // idle source, starts compiling files that were read
+
+    // Entries that were read and whose compilation has not been started; an
+    // entry is in here exactly as long as it is in the READ state
+    std::vector<Entry*> m_ready;
+
+    // Only accessed on the main thread
+    std::unordered_map<std::string, std::unique_ptr<Entry>> m_entries;
+
+    GjsAutoChar m_trace_file;
+    std::vector<std::string> m_trace;
+
+    void start_compile(Entry* entry);
+    void start_compiles(void);
+    void write_trace(void);
+
+    static void read_func(void* data, void* user_data);
+    static void on_compiled(void* token, void* data);
+    static gboolean on_start_idle(void* data);
+
+ public:
+    explicit GjsImportPrefetcher(JSContext* cx);
+    ~GjsImportPrefetcher(void);
+
+    void prefetch(const char* const* paths);
+    void prefetch_trace(const char* trace_file);
+    void record(const char* path);
+
+    GJS_JSAPI_RETURN_CONVENTION
+    bool take(const char* path, JS::MutableHandleScript script_out);
+
+    void cancel(void);
+};
+
+void gjs_import_prefetch_get_stats(unsigned* hits, unsigned* failures);
+
+#endif  // GJS_IMPORT_PREFETCH_H_
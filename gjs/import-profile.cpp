@@ -0,0 +1,206 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <config.h>
+
+#include <algorithm>  // for sort
+
+#include <glib.h>
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/context-private.h"
+#include "gjs/import-profile.h"
+#include "gjs/profiler-private.h"
+#include "util/log.h"
+
+static const char* kind_names[] = {"module", "native", "gi", "info"};
+static const char* phase_names[] = {"Import lookup", "Import read",
+                                    "Import compile", "Import execute",
+                                    "Import load typelib"};
+static const char* kind_mark_names[] = {"Import module", "Import native module",
+                                        "Import GI namespace",
+                                        "Define GI info"};
+
+bool GjsImportProfile::enabled(void) const {
+    if (m_output)
+        return true;
+    GjsProfiler* profiler = GjsContextPrivate::from_cx(m_cx)->profiler();
+    return profiler && _gjs_profiler_is_running(profiler);
+}
+
+void GjsImportProfile::set_output(const char* filename) {
+    m_output = g_strdup(filename);
+}
+
+void GjsImportProfile::add_mark(int64_t start, int64_t duration,
+                                const char* what, const char* name) {
+    GjsProfiler* profiler = GjsContextPrivate::from_cx(m_cx)->profiler();
+    if (profiler)
+        _gjs_profiler_add_mark(profiler, start * 1000L, duration * 1000L,
+                               "GJS", what, name);
+}
+
+size_t GjsImportProfile::begin(Kind kind, const char* name) {
+    Event event;
+    event.name = name;
+    event.kind = kind;
+    event.depth = m_open.size();
+    event.start = g_get_monotonic_time();
+    event.duration = 0;
+    event.children = 0;
+    std::fill(event.phases, event.phases + N_PHASES, 0);
+    event.index = NOT_RECORDED;
+
+    // Without a report to write, the marks are all that is needed, so nothing
+    // is kept after the event ends. Otherwise reserve its place in the report,
+    // which lists events in the order in which they began.
+    if (m_output) {
+        event.index = m_events.size();
+        m_events.emplace_back();
+    }
+
+    m_open.push_back(std::move(event));
+    return m_open.size() - 1;
+}
+
+void GjsImportProfile::end(size_t depth) {
+    // Events end in the reverse order that they began, even on errors, since
+    // they are scoped
+    g_assert(m_open.size() == depth + 1);
+    Event& event = m_open.back();
+    event.duration = g_get_monotonic_time() - event.start;
+
+    if (depth > 0)
+        m_open[depth - 1].children += event.duration;
+
+    add_mark(event.start, event.duration, kind_mark_names[event.kind],
+             event.name.c_str());
+
+    if (event.index != NOT_RECORDED)
+        m_events[event.index] = std::move(event);
+    m_open.pop_back();
+}
+
+void GjsImportProfile::add_phase(Phase phase, int64_t start,
+                                 int64_t duration) {
+    if (m_open.empty())
+        return;
+
+    Event& event = m_open.back();
+    event.phases[phase] += duration;
+    add_mark(start, duration, phase_names[phase], event.name.c_str());
+}
+
+static double ms(int64_t usec) { return usec / 1000.0; }
+
+/*
+ * GjsImportProfile::write_report:
+ *
+ * Writes the events recorded so far to the output file, if one was set: first
+ * sorted by the time spent in each event itself, not counting nested events,
+ * then as a tree in the order in which they happened.
+ */
+void GjsImportProfile::write_report(void) {
+    if (!m_output)
+        return;
+
+    GString* report = g_string_new(nullptr);
+    int64_t total = 0;
+    for (const Event& event : m_events) {
+        if (event.depth == 0)
+            total += event.duration;
+    }
+    g_string_append_printf(report, "Import profile: %zu events, %.3f ms\n\n",
+                           m_events.size(), ms(total));
+
+    std::vector<const Event*> sorted;
+    for (const Event& event : m_events)
+        sorted.push_back(&event);
+    std::sort(sorted.begin(), sorted.end(), [](const Event* a, const Event* b) {
+        return a->duration - a->children > b->duration - b->children;
+    });
+
+    g_string_append(report, "By self time (ms):\n");
+    g_string_append_printf(report, "%9s %9s %9s %9s %9s %9s %9s  %-6s %s\n",
+                           "self", "total", "lookup", "read", "compile",
+                           "execute", "typelib", "kind", "name");
+    for (const Event* event : sorted) {
+        g_string_append_printf(
+            report, "%9.3f %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f  %-6s %s\n",
+            ms(event->duration - event->children), ms(event->duration),
+            ms(event->phases[LOOKUP]), ms(event->phases[READ]),
+            ms(event->phases[COMPILE]), ms(event->phases[EXECUTE]),
+            ms(event->phases[LOAD_TYPELIB]), kind_names[event->kind],
+            event->name.c_str());
+    }
+
+    g_string_append(report, "\nTree (total ms):\n");
+    for (const Event& event : m_events) {
+        g_string_append_printf(report, "%9.3f  %*s%s %s\n", ms(event.duration),
+                               event.depth * 2, "", kind_names[event.kind],
+                               event.name.c_str());
+    }
+
+    GError* error = nullptr;
+    if (!g_file_set_contents(m_output, report->str, report->len, &error)) {
+        g_warning("Failed to write import profile %s: %s", m_output.get(),
+                  error->message);
+        g_error_free(error);
+    } else {
+        gjs_debug(GJS_DEBUG_IMPORTER, "Wrote import profile to %s",
+                  m_output.get());
+    }
+
+    g_string_free(report, true);
+}
+
+GjsAutoImportEvent::GjsAutoImportEvent(JSContext* cx,
+                                       GjsImportProfile::Kind kind,
+                                       const char* name)
+    : m_profile(&GjsContextPrivate::from_cx(cx)->import_profile()), m_event(0) {
+    if (m_profile->enabled())
+        m_event = m_profile->begin(kind, name);
+    else
+        m_profile = nullptr;
+}
+
+GjsAutoImportPhase::GjsAutoImportPhase(JSContext* cx,
+                                       GjsImportProfile::Phase phase)
+    : m_profile(&GjsContextPrivate::from_cx(cx)->import_profile()),
+      m_phase(phase),
+      m_start(0) {
+    if (m_profile->enabled())
+        m_start = g_get_monotonic_time();
+    else
+        m_profile = nullptr;
+}
+
+/* Ends the phase before going out of scope */
+void GjsAutoImportPhase::stop(void) {
+    if (!m_profile)
+        return;
+    m_profile->add_phase(m_phase, m_start, g_get_monotonic_time() - m_start);
+    m_profile = nullptr;
+}
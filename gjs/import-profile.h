@@ -0,0 +1,119 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#ifndef GJS_IMPORT_PROFILE_H_
+#define GJS_IMPORT_PROFILE_H_
+
+#include <stddef.h>  // for size_t
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/jsapi-util.h"
+#include "gjs/macros.h"
+
+/*
+ * GjsImportProfile:
+ *
+ * Records how long each import takes, to find out which imports make startup
+ * slow. Every module, native module, GI namespace, and GI info definition is an
+ * event, nested inside the event that was running when it started; for modules
+ * the time is further split into looking up, reading, compiling, and executing
+ * the file, and for GI namespaces into loading the typelib and running the
+ * overrides. The execute phase includes the time taken by nested events.
+ *
+ * The events are added to the profiler's capture as marks, if the profiler is
+ * running. Only if an output file was set, e.g. with the --import-profile
+ * option of the gjs console, are they also kept after they end, to be written
+ * as a report on destruction.
+ */
+class GjsImportProfile {
+ public:
+    enum Kind { MODULE, NATIVE_MODULE, NAMESPACE, INFO };
+    enum Phase { LOOKUP, READ, COMPILE, EXECUTE, LOAD_TYPELIB, N_PHASES };
+
+ private:
+    struct Event {
+        std::string name;
+        Kind kind;
+        unsigned depth;
+        int64_t start;
+        int64_t duration;
+        int64_t children;  // total duration of nested events
+        int64_t phases[N_PHASES];
+        size_t index;  // in m_events, or NOT_RECORDED
+    };
+    static constexpr size_t NOT_RECORDED = SIZE_MAX;
+
+    JSContext* m_cx;
+    GjsAutoChar m_output;
+    std::vector<Event> m_events;  // all events in order, only if m_output
+    std::vector<Event> m_open;    // stack of events that haven't ended
+
+    void add_mark(int64_t start, int64_t duration, const char* what,
+                  const char* name);
+
+ public:
+    explicit GjsImportProfile(JSContext* cx) : m_cx(cx) {}
+
+    GJS_USE bool enabled(void) const;
+    void set_output(const char* filename);
+
+    GJS_USE size_t begin(Kind kind, const char* name);
+    void end(size_t depth);
+    void add_phase(Phase phase, int64_t start, int64_t duration);
+
+    void write_report(void);
+};
+
+/* Times an import event for as long as it is in scope */
+class GjsAutoImportEvent {
+    GjsImportProfile* m_profile;
+    size_t m_event;
+
+ public:
+    GjsAutoImportEvent(JSContext* cx, GjsImportProfile::Kind kind,
+                       const char* name);
+    ~GjsAutoImportEvent(void) {
+        if (m_profile)
+            m_profile->end(m_event);
+    }
+};
+
+/* Times a phase of the innermost event for as long as it is in scope */
+class GjsAutoImportPhase {
+    GjsImportProfile* m_profile;
+    GjsImportProfile::Phase m_phase;
+    int64_t m_start;
+
+ public:
+    GjsAutoImportPhase(JSContext* cx, GjsImportProfile::Phase phase);
+    ~GjsAutoImportPhase(void) { stop(); }
+    void stop(void);
+};
+
+#endif  // GJS_IMPORT_PROFILE_H_
@@ -21,6 +21,9 @@
  * IN THE SOFTWARE.
  */
 
+#include <config.h>  // for HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+
+#include <stdint.h>
 #include <string.h>  // for size_t, strcmp, strlen
 
 #ifdef G_OS_WIN32
@@ -28,13 +31,16 @@
 #    include <windows.h>
 #endif
 
-#include <memory>   // for allocator_traits<>::value_type
+#include <memory>  // for allocator_traits<>::value_type, unique_ptr
+#include <string>
+#include <unordered_map>
 #include <utility>  // for move
 #include <vector>   // for vector
 
 #include <gio/gio.h>
 #include <glib-object.h>
 #include <glib.h>
+#include <glib/gstdio.h>  // for g_stat
 
 #include "gjs/jsapi-wrapper.h"
 #include "mozilla/UniquePtr.h"
@@ -42,6 +48,7 @@
 #include "gjs/atoms.h"
 #include "gjs/context-private.h"
 #include "gjs/global.h"
+#include "gjs/import-profile.h"
 #include "gjs/importer.h"
 #include "gjs/jsapi-class.h"
 #include "gjs/jsapi-util.h"
@@ -55,9 +62,46 @@
 
 static char **gjs_search_path = NULL;
 
-typedef struct {
+/* Index of the entries in one search path directory. Listing the directory
+ * once is much cheaper than querying the file system for __init__.js, a
+ * subdirectory, and a module file in every directory of the search path, for
+ * every import; it also remembers which names are not there.
+ *
+ * For local directories, the modification time of the directory is checked
+ * once per import, which is a single stat() however many names that import
+ * looks up, so that modules that are added or removed while the program runs
+ * are picked up by the next import. Directories in GResources are assumed not
+ * to change. */
+struct ImporterDirIndex {
+    std::unordered_map<std::string, GFileType> entries;
+    GjsAutoChar path;  // local path, or null for a GResource
+    int64_t mtime;     // nanoseconds, or -1 if the directory didn't exist
+    // If the directory changed in the same second that it was listed, a file
+    // system that only records whole seconds might not show a later change
+    bool racy;
+    unsigned checked_serial;  // Importer::import_serial when last checked
+
+    ImporterDirIndex() : mtime(-1), racy(false), checked_serial(0) {}
+};
+
+struct Importer {
     bool is_root;
-} Importer;
+
+    // Keyed by search path entry. Discarded when the context's import cache
+    // generation changes, see gjs_context_invalidate_import_cache()
+    std::unordered_map<std::string, std::unique_ptr<ImporterDirIndex>>
+        dir_index;
+    unsigned index_generation;
+    // Bumped for every import, so that each index is checked once per import
+    unsigned import_serial;
+
+    explicit Importer(bool root)
+        : is_root(root), index_generation(0), import_serial(0) {}
+};
+
+static volatile int dir_index_listings = 0;
+static volatile int dir_index_hits = 0;
+static volatile int dir_index_negative_hits = 0;
 
 typedef struct {
     GPtrArray *elements;
@@ -297,6 +341,7 @@ gjs_import_native_module(JSContext       *cx,
 {
     gjs_debug(GJS_DEBUG_IMPORTER, "Importing '%s'", parse_name);
 
+    GjsAutoImportEvent event(cx, GjsImportProfile::NATIVE_MODULE, parse_name);
     JS::RootedObject module(cx);
     return gjs_load_native_module(cx, parse_name, &module) &&
            define_meta_properties(cx, module, nullptr, parse_name, importer) &&
@@ -406,6 +451,111 @@ static bool load_module_elements(JSContext* cx, JS::HandleObject in_object,
     return true;
 }
 
+/* Modification time of a local directory in nanoseconds, or -1 if it doesn't
+ * exist */
+GJS_USE
+static int64_t dir_mtime(const char* path) {
+    GStatBuf stat_buf;
+    if (g_stat(path, &stat_buf) != 0)
+        return -1;
+
+    int64_t mtime = int64_t(stat_buf.st_mtime) * 1000000000;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    mtime += stat_buf.st_mtim.tv_nsec;
+#endif
+    return mtime;
+}
+
+GJS_USE
+static bool dir_index_is_fresh(const ImporterDirIndex& index) {
+    if (!index.path)
+        return true;
+    return !index.racy && dir_mtime(index.path) == index.mtime;
+}
+
+GJS_USE
+static ImporterDirIndex* list_search_dir(const char* dirname) {
+    auto* index = new ImporterDirIndex();
+
+    /* new_for_commandline_arg handles resource:/// paths */
+    GjsAutoUnref<GFile> dir = g_file_new_for_commandline_arg(dirname);
+
+    // Before listing, so that a change during the listing is noticed later
+    index->path = g_file_get_path(dir);
+    if (index->path) {
+        index->mtime = dir_mtime(index->path);
+        index->racy = index->mtime != -1 &&
+                      index->mtime / 1000000000 >=
+                          g_get_real_time() / G_USEC_PER_SEC;
+    }
+
+    GjsAutoUnref<GFileEnumerator> direnum = g_file_enumerate_children(
+        dir, "standard::name,standard::type", G_FILE_QUERY_INFO_NONE, nullptr,
+        nullptr);
+
+    while (direnum) {
+        GFileInfo* info;
+        if (!g_file_enumerator_iterate(direnum, &info, nullptr, nullptr,
+                                       nullptr) ||
+            !info)
+            break;
+
+        index->entries.emplace(g_file_info_get_name(info),
+                               g_file_info_get_file_type(info));
+    }
+
+    g_atomic_int_inc(&dir_index_listings);
+    gjs_debug(GJS_DEBUG_IMPORTER, "Listed search path directory %s: %zu entries",
+              dirname, index->entries.size());
+    return index;
+}
+
+/* Returns the type of @name in the search path directory @dirname, or
+ * G_FILE_TYPE_UNKNOWN if it doesn't exist, using the importer's index of the
+ * directory. */
+GJS_USE
+static GFileType lookup_in_search_dir(JSContext* cx, Importer* priv,
+                                      const char* dirname, const char* name) {
+    // A name with a separator isn't an entry of the directory itself; this
+    // can't happen through normal imports, but don't get it wrong
+    if (strchr(name, '/') || strchr(name, G_DIR_SEPARATOR)) {
+        GjsAutoChar full_path = g_build_filename(dirname, name, nullptr);
+        GjsAutoUnref<GFile> file = g_file_new_for_commandline_arg(full_path);
+        return g_file_query_file_type(file, G_FILE_QUERY_INFO_NONE, nullptr);
+    }
+
+    unsigned generation =
+        GjsContextPrivate::from_cx(cx)->import_cache_generation();
+    if (priv->index_generation != generation) {
+        priv->dir_index.clear();
+        priv->index_generation = generation;
+    }
+
+    std::unique_ptr<ImporterDirIndex>& index = priv->dir_index[dirname];
+    if (!index || (index->checked_serial != priv->import_serial &&
+                   !dir_index_is_fresh(*index)))
+        index.reset(list_search_dir(dirname));
+    index->checked_serial = priv->import_serial;
+
+    auto entry = index->entries.find(name);
+    if (entry == index->entries.end()) {
+        g_atomic_int_inc(&dir_index_negative_hits);
+        return G_FILE_TYPE_UNKNOWN;
+    }
+
+    g_atomic_int_inc(&dir_index_hits);
+    return entry->second;
+}
+
+void gjs_importer_cache_report(void) {
+    gjs_debug(GJS_DEBUG_MEMORY,
+              "  Import directory index: %d listings, %d hits, %d negative "
+              "hits",
+              g_atomic_int_get(&dir_index_listings),
+              g_atomic_int_get(&dir_index_hits),
+              g_atomic_int_get(&dir_index_negative_hits));
+}
+
 /* If error, returns false. If not found, returns true but does not touch
  * the value at *result. If found, returns true and sets *result = true.
  */
@@ -476,13 +626,35 @@ import_file_on_module(JSContext       *context,
     return retval;
 }
 
+/* Dotted path of the module, e.g. "ui.main", to tell apart modules with the
+ * same name in the import profile */
+GJS_JSAPI_RETURN_CONVENTION
+static bool import_profile_name(JSContext* cx, JS::HandleObject importer,
+                                const char* name, GjsAutoChar* profile_name) {
+    const GjsAtoms& atoms = GjsContextPrivate::atoms(cx);
+    JS::RootedValue parent_path(cx);
+    if (!JS_GetPropertyById(cx, importer, atoms.module_path(), &parent_path))
+        return false;
+
+    if (!parent_path.isString()) {
+        *profile_name = g_strdup(name);
+        return true;
+    }
+
+    JS::UniqueChars parent_path_str;
+    if (!gjs_string_to_utf8(cx, parent_path, &parent_path_str))
+        return false;
+    *profile_name = g_strdup_printf("%s.%s", parent_path_str.get(), name);
+    return true;
+}
+
 GJS_JSAPI_RETURN_CONVENTION
 static bool do_import(JSContext* context, JS::HandleObject obj, Importer* priv,
                       JS::HandleId id) {
     JS::RootedObject search_path(context);
     guint32 search_path_len;
     guint32 i;
-    bool exists, is_array;
+    bool is_array;
     const GjsAtoms& atoms = GjsContextPrivate::atoms(context);
 
     if (!gjs_object_require_property(context, obj, "importer",
@@ -519,11 +691,22 @@ static bool do_import(JSContext* context, JS::HandleObject obj, Importer* priv,
         return true;
     }
 
+    GjsAutoChar profile_name;
+    if (GjsContextPrivate::from_cx(context)->import_profile().enabled() &&
+        !import_profile_name(context, obj, name.get(), &profile_name))
+        return false;
+    GjsAutoImportEvent event(context, GjsImportProfile::MODULE,
+                             profile_name ? profile_name.get() : name.get());
+
     GjsAutoChar filename = g_strdup_printf("%s.js", name.get());
     std::vector<GjsAutoChar> directories;
     JS::RootedValue elem(context);
     JS::RootedString str(context);
 
+    // Ends when a module is found, before loading it
+    GjsAutoImportPhase lookup(context, GjsImportProfile::LOOKUP);
+    priv->import_serial++;
+
     for (i = 0; i < search_path_len; ++i) {
         elem.setUndefined();
         if (!JS_GetElement(context, search_path, i, &elem)) {
@@ -550,20 +733,30 @@ static bool do_import(JSContext* context, JS::HandleObject obj, Importer* priv,
         if (dirname[0] == '\0')
             continue;
 
-        /* Try importing __init__.js and loading the symbol from it */
+        /* Try importing __init__.js and loading the symbol from it. If an
+         * __init__.js was already loaded from an earlier directory, it is
+         * used for all of them. */
         bool found = false;
-        if (!import_symbol_from_init_js(context, obj, dirname.get(), name.get(),
-                                        &found))
+        bool has_init;
+        if (!JS_HasPropertyById(context, obj, atoms.module_init(), &has_init))
+            return false;
+        if (!has_init)
+            has_init = lookup_in_search_dir(context, priv, dirname.get(),
+                                            MODULE_INIT_FILENAME) !=
+                       G_FILE_TYPE_UNKNOWN;
+        if (has_init)
+            lookup.stop();
+        if (has_init && !import_symbol_from_init_js(context, obj, dirname.get(),
+                                                    name.get(), &found))
             return false;
         if (found)
             return true;
 
         /* Second try importing a directory (a sub-importer) */
-        GjsAutoChar full_path =
-            g_build_filename(dirname.get(), name.get(), nullptr);
-        GjsAutoUnref<GFile> gfile = g_file_new_for_commandline_arg(full_path);
-
-        if (g_file_query_file_type(gfile, (GFileQueryInfoFlags) 0, NULL) == G_FILE_TYPE_DIRECTORY) {
+        if (lookup_in_search_dir(context, priv, dirname.get(), name.get()) ==
+            G_FILE_TYPE_DIRECTORY) {
+            GjsAutoChar full_path =
+                g_build_filename(dirname.get(), name.get(), nullptr);
             gjs_debug(GJS_DEBUG_IMPORTER,
                       "Adding directory '%s' to child importer '%s'",
                       full_path.get(), name.get());
@@ -580,16 +773,18 @@ static bool do_import(JSContext* context, JS::HandleObject obj, Importer* priv,
             continue;
 
         /* Third, if it's not a directory, try importing a file */
-        full_path = g_build_filename(dirname.get(), filename.get(), nullptr);
-        gfile = g_file_new_for_commandline_arg(full_path);
-        exists = g_file_query_exists(gfile, NULL);
-
-        if (!exists) {
+        if (lookup_in_search_dir(context, priv, dirname.get(),
+                                 filename.get()) == G_FILE_TYPE_UNKNOWN) {
             gjs_debug(GJS_DEBUG_IMPORTER, "JS import '%s' not found in %s",
                       name.get(), dirname.get());
             continue;
         }
 
+        GjsAutoChar full_path =
+            g_build_filename(dirname.get(), filename.get(), nullptr);
+        GjsAutoUnref<GFile> gfile = g_file_new_for_commandline_arg(full_path);
+
+        lookup.stop();
         if (import_file_on_module(context, obj, id, name.get(), gfile)) {
             gjs_debug(GJS_DEBUG_IMPORTER, "successfully imported module '%s'",
                       name.get());
@@ -603,6 +798,8 @@ static bool do_import(JSContext* context, JS::HandleObject obj, Importer* priv,
         return false;
     }
 
+    lookup.stop();
+
     if (!directories.empty()) {
         /* NULL-terminate the char** */
         const char **full_paths = g_new0(const char *, directories.size() + 1);
@@ -806,7 +1003,7 @@ static void importer_finalize(JSFreeOp*, JSObject* obj) {
         return; /* we are the prototype, not a real instance */
 
     GJS_DEC_COUNTER(importer);
-    g_slice_free(Importer, priv);
+    delete priv;
 }
 
 /* The bizarre thing about this vtable is that it applies to both
@@ -854,8 +1051,7 @@ importer_new(JSContext *context,
     if (!importer)
         return nullptr;
 
-    priv = g_slice_new0(Importer);
-    priv->is_root = is_root;
+    priv = new Importer(is_root);
 
     GJS_INC_COUNTER(importer);
 
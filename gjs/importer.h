@@ -37,4 +37,6 @@ bool gjs_import_native_module(JSContext       *cx,
                               JS::HandleObject importer,
                               const char      *name);
 
+void gjs_importer_cache_report(void);
+
 #endif  // GJS_IMPORTER_H_
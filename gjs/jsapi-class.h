@@ -129,7 +129,8 @@ static inline JSObject* gjs_no_parent_get_proto(JSContext*) { return nullptr; }
  */
 #define GJS_DEFINE_PROTO(tn, cn, flags)                            \
 GJS_NATIVE_CONSTRUCTOR_DECLARE(cn);                                \
-_GJS_DEFINE_PROTO_FULL(tn, cn, gjs_##cn##_constructor, G_TYPE_NONE, flags)
+_GJS_DEFINE_PROTO_FULL(tn, cn, no_parent, gjs_##cn##_constructor,  \
+                       G_TYPE_NONE, flags)
 
 /**
  * GJS_DEFINE_PROTO_ABSTRACT:
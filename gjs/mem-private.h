@@ -68,4 +68,22 @@ GJS_DECLARE_COUNTER(union_prototype)
 
 #define GJS_GET_COUNTER(name) g_atomic_int_get(&gjs_counter_##name.value)
 
+// Bytes that GJS itself has allocated for the C side of introspected wrappers,
+// which the JS engine doesn't know about. Used in GC scheduling.
+extern volatile gssize gjs_wrapper_bytes;
+
+#define GJS_ADD_WRAPPER_BYTES(n) \
+    g_atomic_pointer_add(&gjs_wrapper_bytes, gssize(n))
+#define GJS_GET_WRAPPER_BYTES() size_t(g_atomic_pointer_get(&gjs_wrapper_bytes))
+
+// Source code of modules that the JS engine didn't keep in memory, because it
+// was compiled with lazy source; and how often it was read again on demand
+extern volatile gssize gjs_lazy_source_bytes;
+extern volatile int gjs_lazy_source_reloads;
+
+#define GJS_ADD_LAZY_SOURCE_BYTES(n) \
+    g_atomic_pointer_add(&gjs_lazy_source_bytes, gssize(n))
+#define GJS_GET_LAZY_SOURCE_BYTES() \
+    size_t(g_atomic_pointer_get(&gjs_lazy_source_bytes))
+
 #endif  // GJS_MEM_PRIVATE_H_
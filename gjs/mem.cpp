@@ -23,6 +23,9 @@
 
 #include <glib.h>
 
+#include "gi/repo.h"
+#include "gjs/bytecode-cache.h"
+#include "gjs/importer.h"
 #include "gjs/mem-private.h"
 #include "gjs/mem.h"
 #include "util/log.h"
@@ -54,6 +57,10 @@ GJS_DEFINE_COUNTER(repo)
 GJS_DEFINE_COUNTER(union_instance)
 GJS_DEFINE_COUNTER(union_prototype)
 
+volatile gssize gjs_wrapper_bytes = 0;
+volatile gssize gjs_lazy_source_bytes = 0;
+volatile int gjs_lazy_source_reloads = 0;
+
 #define GJS_LIST_COUNTER(name) \
     & gjs_counter_ ## name
 
@@ -109,6 +116,18 @@ gjs_memory_report(const char *where,
               "  %d objects currently alive",
               GJS_GET_COUNTER(everything));
 
+    gjs_debug(GJS_DEBUG_MEMORY, "  %zu bytes allocated for wrappers",
+              GJS_GET_WRAPPER_BYTES());
+    gjs_debug(GJS_DEBUG_MEMORY,
+              "  %zu bytes of module source not kept in memory, read again "
+              "%d times",
+              GJS_GET_LAZY_SOURCE_BYTES(),
+              g_atomic_int_get(&gjs_lazy_source_reloads));
+
+    gjs_gtype_info_cache_report();
+    gjs_bytecode_cache_report();
+    gjs_importer_cache_report();
+
     if (GJS_GET_COUNTER(everything) > 0) {
         for (i = 0; i < n_counters; ++i) {
             gjs_debug(GJS_DEBUG_MEMORY, "    %24s = %d", counters[i]->name,
@@ -21,17 +21,18 @@
  * IN THE SOFTWARE.
  */
 
-#include <stddef.h>     // for size_t
-#include <sys/types.h>  // for ssize_t
-
-#include <string>  // for u16string
+#include <stddef.h>  // for size_t
 
 #include <gio/gio.h>
 #include <glib.h>
 
 #include "gjs/jsapi-wrapper.h"
 
+#include "gjs/bytecode-cache.h"
 #include "gjs/context-private.h"
+#include "gjs/engine.h"
+#include "gjs/import-prefetch.h"
+#include "gjs/import-profile.h"
 #include "gjs/jsapi-util.h"
 #include "gjs/mem-private.h"
 #include "gjs/module.h"
@@ -90,33 +91,37 @@ class GjsModule {
         return true;
     }
 
-    /* Carries out the actual execution of the module code */
+    /* Carries out the actual execution of the module code. @path is the
+     * local path of the source file if there is one, for the bytecode cache */
     GJS_JSAPI_RETURN_CONVENTION
     bool evaluate_import(JSContext* cx, JS::HandleObject module,
-                         const char* script, ssize_t script_len,
-                         const char* filename) {
-        std::u16string utf16_string =
-            gjs_utf8_script_to_utf16(script, script_len);
-
-        unsigned start_line_number = 1;
-        size_t offset = gjs_unix_shebang_len(utf16_string, &start_line_number);
+                         const char* script, size_t script_len,
+                         const char* filename, const char* path) {
+        JS::RootedScript compiled(cx);
+        GjsAutoImportPhase phase(cx, GjsImportProfile::COMPILE);
+        if (!gjs_bytecode_cache_compile(cx, path, script, script_len, filename,
+                                        &compiled))
+            return false;
+        phase.stop();
 
-        JS::SourceBufferHolder buf(utf16_string.c_str() + offset,
-                                   utf16_string.size() - offset,
-                                   JS::SourceBufferHolder::NoOwnership);
+        return execute_import(cx, module, compiled);
+    }
 
+    /* Runs the compiled module code with the module object in scope */
+    GJS_JSAPI_RETURN_CONVENTION
+    bool execute_import(JSContext* cx, JS::HandleObject module,
+                        JS::HandleScript compiled) {
         JS::AutoObjectVector scope_chain(cx);
         if (!scope_chain.append(module)) {
             JS_ReportOutOfMemory(cx);
             return false;
         }
 
-        JS::CompileOptions options(cx);
-        options.setFileAndLine(filename, start_line_number);
-
         JS::RootedValue ignored_retval(cx);
-        if (!JS::Evaluate(cx, scope_chain, options, buf, &ignored_retval))
+        GjsAutoImportPhase phase(cx, GjsImportProfile::EXECUTE);
+        if (!JS_ExecuteScript(cx, scope_chain, compiled, &ignored_retval))
             return false;
+        phase.stop();
 
         GjsContextPrivate* gjs = GjsContextPrivate::from_cx(cx);
         gjs->schedule_gc_if_needed();
@@ -133,7 +138,42 @@ class GjsModule {
                 JS::HandleObject module,
                 GFile           *file)
     {
+        GjsAutoChar local_path = g_file_get_path(file);
+
+        /* The module may already have been compiled in the background */
+        GjsImportPrefetcher& prefetcher =
+            GjsContextPrivate::from_cx(cx)->import_prefetcher();
+        prefetcher.record(local_path);
+        if (local_path) {
+            JS::RootedScript prefetched(cx);
+            GjsAutoImportPhase phase(cx, GjsImportProfile::COMPILE);
+            if (!prefetcher.take(local_path, &prefetched))
+                return false;
+            phase.stop();
+            if (prefetched)
+                return execute_import(cx, module, prefetched);
+        }
+
         GError *error = nullptr;
+        GjsAutoChar full_path = g_file_get_parse_name(file);
+        GjsAutoImportPhase read_phase(cx, GjsImportProfile::READ);
+
+        /* Modules in a GResource, e.g. an application bundle, are used in
+         * place without copying them out of the mapped file */
+        if (g_file_has_uri_scheme(file, "resource")) {
+            GjsAutoPointer<GBytes, GBytes, g_bytes_unref> bytes =
+                gjs_lookup_resource_data(full_path, &error);
+            if (!bytes)
+                return gjs_throw_gerror_message(cx, error);
+
+            size_t script_len;
+            auto* script =
+                static_cast<const char*>(g_bytes_get_data(bytes, &script_len));
+            read_phase.stop();
+            return evaluate_import(cx, module, script, script_len, full_path,
+                                   nullptr);
+        }
+
         char *unowned_script;
         size_t script_len = 0;
 
@@ -143,9 +183,10 @@ class GjsModule {
 
         GjsAutoChar script = unowned_script;  /* steals ownership */
         g_assert(script);
+        read_phase.stop();
 
-        GjsAutoChar full_path = g_file_get_parse_name(file);
-        return evaluate_import(cx, module, script, script_len, full_path);
+        return evaluate_import(cx, module, script, script_len, full_path,
+                               local_path);
     }
 
     /* JSClass operations */
@@ -37,6 +37,8 @@ void _gjs_profiler_add_mark(GjsProfiler* self, int64_t time, int64_t duration,
                             const char* group, const char* name,
                             const char* message);
 
+void _gjs_profiler_invalidate_labels(GjsProfiler* self);
+
 GJS_USE
 bool _gjs_profiler_is_running(GjsProfiler *self);
 
@@ -21,7 +21,7 @@
  * IN THE SOFTWARE.
  */
 
-#include <config.h>  // for ENABLE_PROFILER, HAVE_SYS_SYSCALL_H, HAVE_UNISTD_H
+#include <config.h>  // for ENABLE_PROFILER, HAVE_MALLINFO, ...
 
 #include <sys/signal.h>  // for siginfo_t, sigevent, ...
 
@@ -31,15 +31,21 @@
 #ifdef ENABLE_PROFILER
 #    include <alloca.h>
 #    include <errno.h>
+#    include <malloc.h>   // for mallinfo
+#    include <pthread.h>  // for pthread_sigmask
 #    include <signal.h>  // for sigaction, SIGPROF, sigemptyset
 #    include <stddef.h>  // for size_t
 #    include <stdint.h>
 #    include <stdio.h>      // for sscanf
 #    include <string.h>     // for memcpy, strlen
+#    ifdef HAVE_MEMFD_CREATE
+#        include <sys/mman.h>  // for memfd_create, MFD_CLOEXEC
+#    endif
 #    include <sys/time.h>   // for CLOCK_MONOTONIC
 #    include <sys/types.h>  // for timer_t
 #    include <syscall.h>    // for __NR_gettid
 #    include <time.h>       // for itimerspec, timer_delete, ...
+#    include <ucontext.h>   // for ucontext_t, REG_RBP, ...
 #    ifdef HAVE_SYS_SYSCALL_H
 #        include <sys/syscall.h>  // IWYU pragma: keep
 #    endif
@@ -49,15 +55,21 @@
 #    ifdef G_OS_UNIX
 #        include <glib-unix.h>
 #    endif
+#    include <glib/gstdio.h>  // for g_unlink
 #    include <sysprof-capture.h>
 #endif
 
 #include "gjs/jsapi-wrapper.h"  // IWYU pragma: keep
 #include "js/ProfilingStack.h"  // for EnableContextProfilingStack, ...
 
+#include "gi/toggle.h"
+#include "gjs/allocation-sampler.h"
+#include "gjs/context-private.h"
 #include "gjs/context.h"
+#include "gjs/error-types.h"
 #include "gjs/jsapi-util.h"
 #include "gjs/macros.h"
+#include "gjs/mem-private.h"
 #include "gjs/profiler-private.h"  // IWYU pragma: keep
 #include "gjs/profiler.h"
 
@@ -89,13 +101,83 @@
  * As much of this code has to run from signal handlers, it is very
  * important that we don't use anything that can malloc() or lock, or
  * deadlocks are very likely. Most of GjsProfilerCapture is signal-safe.
+ *
+ * In flight recorder mode, the samples are written to two anonymous in-memory
+ * files instead of the output file. Every time the configured period elapses,
+ * the older one is thrown away and a new one is started, so that between one
+ * and two periods' worth of samples are kept. Dumping the recording
+ * concatenates both into a new output file.
+ *
+ * The capture writer is not reentrant, so the main thread blocks SIGPROF
+ * whenever it writes marks or counters to a live capture, or swaps or reads
+ * the captures, so that the signal handler never sees a half-written frame.
  */
 
-#define SAMPLES_PER_SEC G_GUINT64_CONSTANT(1000)
+#define DEFAULT_SAMPLES_PER_SEC 1000
 #define NSEC_PER_SEC G_GUINT64_CONSTANT(1000000000)
 
+/* Size of the label table; must be a power of 2 */
+#define LABEL_TABLE_BITS 12
+#define LABEL_TABLE_SIZE (1u << LABEL_TABLE_BITS)
+/* Number of slots to look at before giving up on a label */
+#define LABEL_TABLE_MAX_PROBES 16
+
+/* Maximum number of native frames to record per sample */
+#define MAX_NATIVE_FRAMES 128
+
+/* How often the counters are written */
+#define COUNTER_INTERVAL_MS 100
+
 G_DEFINE_POINTER_TYPE(GjsProfiler, gjs_profiler)
 
+#ifdef ENABLE_PROFILER
+enum GjsProfilerCounter {
+    COUNTER_JS_HEAP,
+    COUNTER_MALLOC,
+    COUNTER_WRAPPER_BYTES,
+    COUNTER_OBJECTS,
+    COUNTER_BOXED,
+    COUNTER_CLOSURES,
+    COUNTER_FUNCTIONS,
+    COUNTER_TOGGLE_QUEUE,
+    COUNTER_JOB_QUEUE,
+    N_COUNTERS
+};
+
+// clang-format off
+static const struct {
+    const char* name;
+    const char* description;
+} counter_info[N_COUNTERS] = {
+    {"JS heap", "Bytes in the JS garbage-collected heap"},
+    {"Malloc", "Bytes allocated with malloc()"},
+    {"Wrapper memory", "Bytes allocated for introspected structs"},
+    {"Objects", "GObject wrappers alive"},
+    {"Boxed", "Boxed wrappers alive"},
+    {"Closures", "Closures alive"},
+    {"Functions", "Introspected function wrappers alive"},
+    {"Toggle queue", "Toggle notifications waiting"},
+    {"Promise jobs", "Promise jobs waiting to run"},
+};
+// clang-format on
+
+/*
+ * GjsProfilerLabel:
+ *
+ * A slot in the table that maps the label and dynamic string pointers of a
+ * pseudo-stack entry to the jitmap address that was added to the capture for
+ * them, so that the SIGPROF handler doesn't have to build the string and look
+ * it up in the capture's jitmap again on every sample. The slot is only valid
+ * if its generation is the profiler's current one.
+ */
+struct GjsProfilerLabel {
+    const char* label;
+    const char* dynamic_string;
+    SysprofCaptureAddress address;
+    unsigned generation;
+};
+#endif  /* ENABLE_PROFILER */
+
 struct _GjsProfiler {
 #ifdef ENABLE_PROFILER
     /* The stack for the JSContext profiler to use for current stack
@@ -126,10 +208,93 @@ struct _GjsProfiler {
 
     /* GLib signal handler ID for SIGUSR2 */
     unsigned sigusr2_id;
+
+    /* In flight recorder mode, the capture of the previous period */
+    SysprofCaptureWriter* previous_capture;
+
+    /* In flight recorder mode, the timeout that starts a new period, and the
+     * SIGUSR2 handler that dumps the recording, unless sigusr2_id is set */
+    unsigned rotate_id;
+    unsigned dump_sigusr2_id;
+
+    /* Watches for long main loop iterations */
+    GSource* frame_watch;
+
+    /* Monotonic time of the last dump, in microseconds */
+    int64_t last_dump_time;
+
+    /* Preallocated, so that the SIGPROF handler can fill it in. The handler
+     * is the only writer; other code only increments the generation, which
+     * empties the table, whenever the jitmap addresses or the strings that
+     * the pointers point to may have become invalid. */
+    GjsProfilerLabel* labels;
+    unsigned label_generation;
+    unsigned labels_seen_generation;  // generation that n_labels counts
+
+    /* Label table statistics, since the profiler was started */
+    unsigned n_labels;
+    unsigned n_label_hits;
+    unsigned n_label_misses;
+    unsigned n_label_overflows;
+
+    /* Bounds of the JS thread's stack, for checking frame pointers */
+    uintptr_t stack_low;
+    uintptr_t stack_high;
+
+    /* Timeout that writes the counters */
+    unsigned counters_id;
+
+    /* Incremented every time the samples start going to a new capture. Counter
+     * IDs belong to a capture, so the counters are defined again in the new
+     * one when counters_generation doesn't match. */
+    unsigned capture_generation;
+    unsigned counters_generation;
+    unsigned first_counter_id;
+
+    /* Collections started since the profiler was started, and the counter
+     * IDs in the current capture, for each reason that has occurred */
+    unsigned gc_reason_counts[JS::gcreason::NUM_REASONS];
+    unsigned gc_reason_counter_ids[JS::gcreason::NUM_REASONS];
+    JS::GCSliceCallback previous_gc_slice_callback;
+
+    /* Created the first time allocation sampling starts */
+    GjsAllocationSampler* allocation_sampler;
+
+    /* Timeout that drains the allocation log while sampling allocations */
+    unsigned drain_allocations_id;
+
+    /* Set by the SIGPROF handler when a sample could not be written. The
+     * handler only disarms the timer; the profiler is stopped from the main
+     * loop, since stopping it runs JS and allocates memory. */
+    int capture_failed;
 #endif  /* ENABLE_PROFILER */
 
+    /* Probability of sampling a JS allocation, or 0 if disabled */
+    double allocation_probability;
+
+    /* Sampling frequency */
+    unsigned samples_per_sec;
+
+    /* Length of a flight recorder period in seconds, or 0 if disabled */
+    unsigned flight_recorder_secs;
+
+    /* Main loop iterations longer than this are marked, or 0 if disabled */
+    unsigned long_frame_ms;
+
+    /* Number of flight recordings dumped so far */
+    unsigned n_dumps;
+
     /* If we are currently sampling */
     unsigned running : 1;
+
+    /* If the samples are going to the flight recorder */
+    unsigned flight_recording : 1;
+
+    /* If native frames are sampled as well as the pseudo-stack */
+    unsigned native_stacks : 1;
+
+    /* If the allocation log has overflowed since sampling started */
+    unsigned allocations_overflowed : 1;
 };
 
 static GjsContext *profiling_context;
@@ -146,9 +311,8 @@ static GjsContext *profiling_context;
  *   should abort.
  */
 GJS_USE
-static bool
-gjs_profiler_extract_maps(GjsProfiler *self)
-{
+static bool gjs_profiler_extract_maps(GjsProfiler* self,
+                                      SysprofCaptureWriter* capture) {
     int64_t now = g_get_monotonic_time() * 1000L;
 
     g_assert(((void) "Profiler must be set up before extracting maps", self));
@@ -182,13 +346,345 @@ gjs_profiler_extract_maps(GjsProfiler *self)
             inode = 0;
         }
 
-        if (!sysprof_capture_writer_add_map(self->capture, now, -1, self->pid,
-                                            start, end, offset, inode, file))
+        if (!sysprof_capture_writer_add_map(capture, now, -1, self->pid, start,
+                                            end, offset, inode, file))
             return false;
     }
 
     return true;
 }
+
+/*
+ * gjs_profiler_output_base:
+ *
+ * Returns: (transfer full): the path of the output file without the .syscap
+ *   extension, for naming the other files that the profiler writes.
+ */
+GJS_USE
+static char* gjs_profiler_output_base(GjsProfiler* self) {
+    char* base = g_strdup(self->filename);
+    if (!base)
+        return g_strdup_printf("gjs-%jd", intmax_t(self->pid));
+    if (g_str_has_suffix(base, ".syscap"))
+        base[strlen(base) - strlen(".syscap")] = '\0';
+    return base;
+}
+
+/*
+ * gjs_profiler_new_flight_capture:
+ *
+ * Creates a capture for one flight recorder period, backed by an anonymous
+ * file, and writes the mapped sections to it so that it can be symbolized
+ * without the periods that came before it.
+ *
+ * Returns: the new capture, or %NULL on failure.
+ */
+GJS_USE
+static SysprofCaptureWriter* gjs_profiler_new_flight_capture(
+    GjsProfiler* self) {
+#ifdef HAVE_MEMFD_CREATE
+    int fd = memfd_create("gjs-flight-recorder", MFD_CLOEXEC);
+#else
+    char* path;
+    int fd = g_file_open_tmp("gjs-flight-recorder-XXXXXX", &path, nullptr);
+    if (fd != -1) {
+        g_unlink(path);
+        g_free(path);
+    }
+#endif
+    if (fd == -1)
+        return nullptr;
+
+    SysprofCaptureWriter* capture = sysprof_capture_writer_new_from_fd(fd, 0);
+    if (!capture) {
+        close(fd);
+        return nullptr;
+    }
+
+    if (!gjs_profiler_extract_maps(self, capture)) {
+        sysprof_capture_writer_unref(capture);
+        return nullptr;
+    }
+
+    return capture;
+}
+
+/* Keeps SIGPROF from being delivered to this thread while a capture is being
+ * written to, swapped or read, so that the handler doesn't write to it at the
+ * same time */
+class GjsAutoBlockSigprof {
+    sigset_t m_old_mask;
+
+ public:
+    GjsAutoBlockSigprof(void) {
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGPROF);
+        pthread_sigmask(SIG_BLOCK, &mask, &m_old_mask);
+    }
+    ~GjsAutoBlockSigprof(void) {
+        pthread_sigmask(SIG_SETMASK, &m_old_mask, nullptr);
+    }
+};
+
+static void gjs_profiler_define_counter(GjsProfiler* self, int64_t now,
+                                        unsigned id, const char* category,
+                                        const char* name,
+                                        const char* description) {
+    SysprofCaptureCounter counter = {};
+    g_strlcpy(counter.category, category, sizeof(counter.category));
+    g_strlcpy(counter.name, name, sizeof(counter.name));
+    g_strlcpy(counter.description, description, sizeof(counter.description));
+    counter.id = id;
+    counter.type = SYSPROF_CAPTURE_COUNTER_INT64;
+    sysprof_capture_writer_define_counters(self->capture, now, -1, self->pid,
+                                           &counter, 1);
+}
+
+GJS_USE
+static int64_t gjs_profiler_malloc_bytes(void) {
+#if defined(HAVE_MALLINFO2)
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#elif defined(HAVE_MALLINFO)
+    // The fields are int, and wrap around past 2 GB
+    struct mallinfo info = mallinfo();
+    return unsigned(info.uordblks) + unsigned(info.hblkhd);
+#else
+    return 0;
+#endif
+}
+
+/*
+ * gjs_profiler_write_counters:
+ *
+ * Writes the current values of the GJS runtime counters to the capture, so
+ * that memory use and queue lengths show up on the same timeline as the
+ * samples. Collections are counted per reason; a counter for a reason is only
+ * defined once the first collection for that reason has happened.
+ */
+static gboolean gjs_profiler_write_counters(void* data) {
+    auto* self = static_cast<GjsProfiler*>(data);
+
+    if (g_atomic_int_get(&self->capture_failed)) {
+        g_warning("Failed to write a profiler sample, stopping the profiler");
+        self->counters_id = 0;
+        gjs_profiler_stop(self);
+        return G_SOURCE_REMOVE;
+    }
+
+    GjsContextPrivate* gjs = GjsContextPrivate::from_object(profiling_context);
+    int64_t now = g_get_monotonic_time() * 1000L;
+
+    SysprofCaptureCounterValue values[N_COUNTERS];
+    values[COUNTER_JS_HEAP].v64 = JS_GetGCParameter(self->cx, JSGC_BYTES);
+    values[COUNTER_MALLOC].v64 = gjs_profiler_malloc_bytes();
+    values[COUNTER_WRAPPER_BYTES].v64 = GJS_GET_WRAPPER_BYTES();
+    values[COUNTER_OBJECTS].v64 = GJS_GET_COUNTER(object_instance);
+    values[COUNTER_BOXED].v64 = GJS_GET_COUNTER(boxed_instance);
+    values[COUNTER_CLOSURES].v64 = GJS_GET_COUNTER(closure);
+    values[COUNTER_FUNCTIONS].v64 = GJS_GET_COUNTER(function);
+    values[COUNTER_TOGGLE_QUEUE].v64 = ToggleQueue::get_default().size();
+    values[COUNTER_JOB_QUEUE].v64 = gjs->job_queue_length();
+
+    GjsAutoBlockSigprof block;
+
+    if (self->counters_generation != self->capture_generation) {
+        self->counters_generation = self->capture_generation;
+        self->first_counter_id =
+            sysprof_capture_writer_request_counter(self->capture, N_COUNTERS);
+        for (unsigned ix = 0; ix < N_COUNTERS; ix++)
+            gjs_profiler_define_counter(self, now, self->first_counter_id + ix,
+                                        "GJS", counter_info[ix].name,
+                                        counter_info[ix].description);
+        memset(self->gc_reason_counter_ids, 0,
+               sizeof(self->gc_reason_counter_ids));
+    }
+
+    unsigned ids[N_COUNTERS];
+    for (unsigned ix = 0; ix < N_COUNTERS; ix++)
+        ids[ix] = self->first_counter_id + ix;
+    sysprof_capture_writer_set_counters(self->capture, now, -1, self->pid,
+                                        ids, values, N_COUNTERS);
+
+    for (unsigned reason = 0; reason < JS::gcreason::NUM_REASONS; reason++) {
+        if (self->gc_reason_counts[reason] == 0)
+            continue;
+
+        unsigned& id = self->gc_reason_counter_ids[reason];
+        if (id == 0) {
+            id = sysprof_capture_writer_request_counter(self->capture, 1);
+            gjs_profiler_define_counter(
+                self, now, id, "GJS GC",
+                JS::gcreason::ExplainReason(JS::gcreason::Reason(reason)),
+                "Collections started for this reason");
+        }
+
+        SysprofCaptureCounterValue count;
+        count.v64 = self->gc_reason_counts[reason];
+        sysprof_capture_writer_set_counters(self->capture, now, -1, self->pid,
+                                            &id, &count, 1);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void gjs_profiler_gc_slice(JSContext* cx, JS::GCProgress progress,
+                                  const JS::GCDescription& desc) {
+    GjsProfiler* self = gjs_context_get_profiler(profiling_context);
+    if (!self)
+        return;
+
+    if (progress == JS::GC_CYCLE_BEGIN &&
+        desc.reason_ < JS::gcreason::NUM_REASONS)
+        self->gc_reason_counts[desc.reason_]++;
+
+    if (self->previous_gc_slice_callback)
+        self->previous_gc_slice_callback(cx, progress, desc);
+}
+
+static void gjs_profiler_log_allocation_exception(GjsProfiler* self,
+                                                  const char* message) {
+    JSAutoRequest ar(self->cx);
+    JSAutoCompartment ac(self->cx, gjs_get_import_global(self->cx));
+    gjs_log_exception(self->cx);
+    g_warning("%s", message);
+}
+
+static void gjs_profiler_warn_allocations_overflowed(GjsProfiler* self,
+                                                     bool overflowed) {
+    if (overflowed && !self->allocations_overflowed) {
+        g_warning("Some allocation samples were lost; try a lower sampling "
+                  "probability");
+        self->allocations_overflowed = true;
+    }
+}
+
+static gboolean gjs_profiler_drain_allocations(void* data) {
+    auto* self = static_cast<GjsProfiler*>(data);
+
+    bool overflowed;
+    if (!self->allocation_sampler->drain(&overflowed)) {
+        gjs_profiler_log_allocation_exception(
+            self, "Failed to continue sampling allocations");
+        return G_SOURCE_CONTINUE;
+    }
+
+    gjs_profiler_warn_allocations_overflowed(self, overflowed);
+    return G_SOURCE_CONTINUE;
+}
+
+static void gjs_profiler_start_allocation_sampling(GjsProfiler* self) {
+    if (!self->allocation_sampler)
+        self->allocation_sampler = new GjsAllocationSampler(self->cx);
+
+    if (!self->allocation_sampler->start(self->allocation_probability)) {
+        gjs_profiler_log_allocation_exception(
+            self, "Failed to start sampling allocations");
+        return;
+    }
+
+    self->allocations_overflowed = false;
+    self->drain_allocations_id =
+        g_timeout_add_seconds(1, gjs_profiler_drain_allocations, self);
+}
+
+/*
+ * gjs_profiler_write_allocations:
+ * @base: the output file name without its extension
+ * @stacks: the allocation samples, in the collapsed stack format
+ *
+ * Writes @stacks to a file named after @base, e.g.
+ * `gjs-$PID-allocations.folded`.
+ */
+static void gjs_profiler_write_allocations(const char* base,
+                                           const char* stacks) {
+    GjsAutoChar path = g_strdup_printf("%s-allocations.folded", base);
+    GError* error = nullptr;
+    if (!g_file_set_contents(path, stacks, -1, &error)) {
+        g_warning("Failed to write allocation samples: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    g_message("Allocation samples written to %s", path.get());
+}
+
+/*
+ * gjs_profiler_stop_allocation_sampling:
+ *
+ * Writes the allocation samples to a file named after the output file, unless
+ * in flight recorder mode, where they are only written by gjs_profiler_dump().
+ */
+static void gjs_profiler_stop_allocation_sampling(GjsProfiler* self) {
+    g_source_remove(self->drain_allocations_id);
+    self->drain_allocations_id = 0;
+
+    JS::UniqueChars stacks;
+    if (!self->allocation_sampler->stop(&stacks)) {
+        gjs_profiler_log_allocation_exception(
+            self, "Failed to stop sampling allocations");
+        return;
+    }
+
+    if (self->flight_recording)
+        return;
+
+    GjsAutoChar base = gjs_profiler_output_base(self);
+    gjs_profiler_write_allocations(base, stacks.get());
+}
+
+static gboolean gjs_profiler_rotate(void* data) {
+    auto* self = static_cast<GjsProfiler*>(data);
+
+    SysprofCaptureWriter* capture = gjs_profiler_new_flight_capture(self);
+    if (!capture) {
+        // Keep recording into the current period rather than losing it
+        g_warning("Failed to start a new flight recorder period");
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (self->drain_allocations_id != 0) {
+        bool overflowed;
+        if (self->allocation_sampler->rotate(&overflowed))
+            gjs_profiler_warn_allocations_overflowed(self, overflowed);
+        else
+            gjs_profiler_log_allocation_exception(
+                self, "Failed to continue sampling allocations");
+    }
+
+    GjsAutoBlockSigprof block;
+    g_clear_pointer(&self->previous_capture, sysprof_capture_writer_unref);
+    self->previous_capture = self->capture;
+    self->capture = capture;
+    self->capture_generation++;
+    // The jitmap addresses belong to the old capture
+    g_atomic_int_inc(&self->label_generation);
+
+    return G_SOURCE_CONTINUE;
+}
+
+/*
+ * gjs_profiler_report_labels:
+ *
+ * Adds a mark with the label table statistics to the capture. If the table was
+ * too full to hold some labels, those had to be looked up the slow way on every
+ * sample, so that is logged as well.
+ */
+static void gjs_profiler_report_labels(GjsProfiler* self) {
+    GjsAutoChar message = g_strdup_printf(
+        "%u of %u slots used, %u hits, %u misses, %u overflows",
+        self->n_labels, LABEL_TABLE_SIZE, self->n_label_hits,
+        self->n_label_misses, self->n_label_overflows);
+    _gjs_profiler_add_mark(self, g_get_monotonic_time() * 1000L, 0, "GJS",
+                           "Label table", message);
+
+    if (self->n_label_overflows > 0)
+        g_message("Profiler label table was full for %u of %u frames",
+                  self->n_label_overflows,
+                  self->n_label_hits + self->n_label_misses +
+                      self->n_label_overflows);
+}
 #endif  /* ENABLE_PROFILER */
 
 /*
@@ -234,8 +730,11 @@ _gjs_profiler_new(GjsContext *context)
 #ifdef ENABLE_PROFILER
     self->cx = static_cast<JSContext *>(gjs_context_get_native_context(context));
     self->pid = getpid();
+    self->labels = g_new0(GjsProfilerLabel, LABEL_TABLE_SIZE);
+    self->label_generation = 1;  // the zeroed slots are not valid
 #endif
     self->fd = -1;
+    self->samples_per_sec = DEFAULT_SAMPLES_PER_SEC;
 
     profiling_context = context;
 
@@ -265,6 +764,8 @@ _gjs_profiler_free(GjsProfiler *self)
     g_clear_pointer(&self->filename, g_free);
 #ifdef ENABLE_PROFILER
     g_clear_pointer(&self->capture, sysprof_capture_writer_unref);
+    g_free(self->labels);
+    delete self->allocation_sampler;
 
     if (self->fd != -1)
         close(self->fd);
@@ -291,10 +792,125 @@ _gjs_profiler_is_running(GjsProfiler *self)
 
 #ifdef ENABLE_PROFILER
 
+/*
+ * gjs_profiler_find_label:
+ *
+ * Looks up the label table slot for a pseudo-stack entry's label and dynamic
+ * string. Signal-safe.
+ *
+ * Returns: the slot holding the jitmap address, if its generation is
+ *   @generation; otherwise a free slot to store it in, or %NULL if all the
+ *   slots that the entry may go in are taken.
+ */
+GJS_USE
+static GjsProfilerLabel* gjs_profiler_find_label(GjsProfiler* self,
+                                                 const char* label,
+                                                 const char* dynamic_string,
+                                                 unsigned generation) {
+    uint64_t hash = (uint64_t(uintptr_t(label)) * 31) ^
+                    uint64_t(uintptr_t(dynamic_string));
+    hash *= G_GUINT64_CONSTANT(0x9e3779b97f4a7c15);
+    size_t ix = hash >> (64 - LABEL_TABLE_BITS);
+
+    for (unsigned probe = 0; probe < LABEL_TABLE_MAX_PROBES; probe++) {
+        GjsProfilerLabel* slot = &self->labels[ix];
+        if (slot->generation != generation)
+            return slot;
+        if (slot->label == label && slot->dynamic_string == dynamic_string)
+            return slot;
+        ix = (ix + 1) & (LABEL_TABLE_SIZE - 1);
+    }
+
+    return nullptr;
+}
+
+/*
+ * gjs_profiler_walk_native_stack:
+ * @ucontext: the context of the thread at the time of the signal
+ * @addrs: (out): return location for the instruction pointers
+ * @keys: (out): return location for the stack addresses of the frames
+ * @max: size of @addrs and @keys
+ *
+ * Follows the chain of frame pointers from the interrupted code, innermost
+ * frame first. This only gives useful results for code that is compiled with
+ * frame pointers, and stops where the chain is broken. Every frame pointer is
+ * checked to be further up the stack than the previous one and within the
+ * thread's stack before it is followed, so this never reads memory that isn't
+ * mapped, and is signal-safe.
+ *
+ * For each frame, its frame pointer is stored in @keys; an entry on the
+ * pseudo-stack whose stack address is below that was pushed by that frame or a
+ * frame called from it.
+ *
+ * Returns: the number of frames stored.
+ */
+GJS_USE
+static unsigned gjs_profiler_walk_native_stack(GjsProfiler* self,
+                                               void* ucontext,
+                                               SysprofCaptureAddress* addrs,
+                                               uintptr_t* keys, unsigned max) {
+    if (!ucontext)
+        return 0;
+
+    auto* mcontext = &static_cast<ucontext_t*>(ucontext)->uc_mcontext;
+    uintptr_t pc, sp, fp;
+#if defined(__x86_64__)
+    pc = mcontext->gregs[REG_RIP];
+    sp = mcontext->gregs[REG_RSP];
+    fp = mcontext->gregs[REG_RBP];
+#elif defined(__i386__)
+    pc = mcontext->gregs[REG_EIP];
+    sp = mcontext->gregs[REG_ESP];
+    fp = mcontext->gregs[REG_EBP];
+#elif defined(__aarch64__)
+    pc = mcontext->pc;
+    sp = mcontext->sp;
+    fp = mcontext->regs[29];
+#else
+    (void)mcontext;
+    (void)self;
+    (void)addrs;
+    (void)keys;
+    (void)max;
+    return 0;
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+    // Not on the thread's stack, e.g. running on an alternate signal stack
+    if (sp < self->stack_low || sp >= self->stack_high)
+        return 0;
+
+    // All three architectures store the caller's frame pointer at the frame
+    // pointer, followed by the return address
+    static const uintptr_t record_size = 2 * sizeof(uintptr_t);
+    unsigned n_frames = 0;
+    uintptr_t low = sp;
+    while (n_frames < max) {
+        bool fp_valid = fp >= low && fp <= self->stack_high - record_size &&
+                        fp % sizeof(uintptr_t) == 0;
+        addrs[n_frames] = SysprofCaptureAddress(pc);
+        keys[n_frames] = fp_valid ? fp : self->stack_high;
+        n_frames++;
+
+        if (!fp_valid)
+            break;
+
+        const uintptr_t* record = reinterpret_cast<uintptr_t*>(fp);
+        pc = record[1];
+        if (pc == 0)
+            break;
+        low = fp + record_size;
+        fp = record[0];
+    }
+
+    return n_frames;
+#endif
+}
+
 static void
 gjs_profiler_sigprof(int        signum,
                      siginfo_t *info,
-                     void      *unused)
+                     void      *ucontext)
 {
     GjsProfiler *self = gjs_context_get_profiler(profiling_context);
 
@@ -310,7 +926,8 @@ gjs_profiler_sigprof(int        signum,
      * that is not okay to do, is *malloc*.
      */
 
-    if (!self || info->si_code != SI_TIMER)
+    if (!self || info->si_code != SI_TIMER ||
+        g_atomic_int_get(&self->capture_failed))
         return;
 
     uint32_t depth = self->stack.stackSize();
@@ -327,11 +944,41 @@ gjs_profiler_sigprof(int        signum,
         // cppcheck-suppress allocaCalled
         static_cast<SysprofCaptureAddress*>(alloca(sizeof *addrs * depth));
 
+    /* Stack addresses of the entries, for placing the native frames between
+     * them. JS entries don't have one, so they get that of the entry that
+     * was pushed before them, normally js::RunScript. */
+    uintptr_t* keys = nullptr;
+    uintptr_t key = UINTPTR_MAX;
+    if (self->native_stacks)
+        // cppcheck-suppress allocaCalled
+        keys = static_cast<uintptr_t*>(alloca(sizeof *keys * depth));
+
+    unsigned generation = g_atomic_int_get(&self->label_generation);
+    if (generation != self->labels_seen_generation) {
+        self->labels_seen_generation = generation;
+        self->n_labels = 0;
+    }
+
     for (uint32_t ix = 0; ix < depth; ix++) {
         js::ProfileEntry& entry = self->stack.entries[ix];
         const char *label = entry.label();
         const char *dynamic_string = entry.dynamicString();
         uint32_t flipped = depth - 1 - ix;
+
+        if (keys) {
+            if (!entry.isJs() && entry.stackAddress())
+                key = uintptr_t(entry.stackAddress());
+            keys[flipped] = key;
+        }
+
+        GjsProfilerLabel* slot =
+            gjs_profiler_find_label(self, label, dynamic_string, generation);
+        if (slot && slot->generation == generation) {
+            addrs[flipped] = slot->address;
+            self->n_label_hits++;
+            continue;
+        }
+
         size_t label_length = strlen(label);
 
         /*
@@ -380,18 +1027,134 @@ gjs_profiler_sigprof(int        signum,
          * a stack address of "this", which is not terribly useful since
          * everything will show up as [stack] when building callgraphs.
          */
-        if (final_string[0] != '\0')
-            addrs[flipped] =
-                sysprof_capture_writer_add_jitmap(self->capture, final_string);
-        else
+        if (final_string[0] == '\0') {
             addrs[flipped] = SysprofCaptureAddress(entry.stackAddress());
+            continue;
+        }
+
+        addrs[flipped] =
+            sysprof_capture_writer_add_jitmap(self->capture, final_string);
+
+        if (slot) {
+            slot->label = label;
+            slot->dynamic_string = dynamic_string;
+            slot->address = addrs[flipped];
+            slot->generation = generation;
+            self->n_labels++;
+            self->n_label_misses++;
+        } else {
+            self->n_label_overflows++;
+        }
+    }
+
+    SysprofCaptureAddress* sample = addrs;
+    unsigned sample_depth = depth;
+
+    if (self->native_stacks) {
+        SysprofCaptureAddress native_addrs[MAX_NATIVE_FRAMES];
+        uintptr_t native_keys[MAX_NATIVE_FRAMES];
+        unsigned n_native = gjs_profiler_walk_native_stack(
+            self, ucontext, native_addrs, native_keys, MAX_NATIVE_FRAMES);
+
+        if (n_native > 0) {
+            sample =
+                // cppcheck-suppress allocaCalled
+                static_cast<SysprofCaptureAddress*>(
+                    alloca(sizeof *sample * (depth + n_native)));
+
+            /* Both lists go from the innermost frame outwards, that is, up
+             * the stack, so merge them by stack address */
+            unsigned js_ix = 0, native_ix = 0;
+            sample_depth = 0;
+            while (js_ix < depth || native_ix < n_native) {
+                if (native_ix < n_native &&
+                    (js_ix == depth || native_keys[native_ix] < keys[js_ix]))
+                    sample[sample_depth++] = native_addrs[native_ix++];
+                else
+                    sample[sample_depth++] = addrs[js_ix++];
+            }
+        }
     }
 
     if (!sysprof_capture_writer_add_sample(self->capture, now, -1, self->pid,
-                                           -1, addrs, depth))
-        gjs_profiler_stop(self);
+                                           -1, sample, sample_depth)) {
+        /* Stopping the profiler is not safe here; disarm the timer and leave
+         * the rest to gjs_profiler_write_counters() on the main loop */
+        struct itimerspec its = {};
+        timer_settime(self->timer, 0, &its, nullptr);
+        g_atomic_int_set(&self->capture_failed, 1);
+    }
+}
+
+static gboolean gjs_profiler_sigusr2(void* data);
+
+/*
+ * GjsFrameWatch:
+ *
+ * A source that is never dispatched, but is prepared and checked on every
+ * iteration of the main loop. The time between the check after polling and the
+ * next prepare is the time spent dispatching other sources, that is, how long
+ * the main loop was busy in that iteration.
+ */
+struct GjsFrameWatch {
+    GSource base;
+    GjsProfiler* profiler;
+    int64_t wake_time;
+};
+
+static void gjs_profiler_frame_finished(GjsProfiler* self, int64_t begin,
+                                        int64_t end) {
+    int64_t duration = end - begin;
+    if (duration < int64_t(self->long_frame_ms) * 1000)
+        return;
+
+    _gjs_profiler_add_mark(self, begin * 1000, duration * 1000, "GJS",
+                           "Long frame", nullptr);
+
+    // One dump per period at most; the next one would mostly repeat it
+    int64_t period = int64_t(self->flight_recorder_secs) * G_USEC_PER_SEC;
+    if (!self->flight_recording ||
+        (self->last_dump_time != 0 && end - self->last_dump_time < period))
+        return;
+
+    GError* error = nullptr;
+    if (!gjs_profiler_dump(self, &error)) {
+        g_warning("Failed to dump flight recording: %s", error->message);
+        g_error_free(error);
+    }
+}
+
+static gboolean gjs_profiler_frame_watch_prepare(GSource* source,
+                                                 int* timeout) {
+    auto* watch = reinterpret_cast<GjsFrameWatch*>(source);
+    *timeout = -1;
+
+    if (watch->wake_time != 0) {
+        gjs_profiler_frame_finished(watch->profiler, watch->wake_time,
+                                    g_get_monotonic_time());
+        watch->wake_time = 0;
+    }
+    return false;
+}
+
+static gboolean gjs_profiler_frame_watch_check(GSource* source) {
+    reinterpret_cast<GjsFrameWatch*>(source)->wake_time =
+        g_get_monotonic_time();
+    return false;
+}
+
+static gboolean gjs_profiler_frame_watch_dispatch(GSource*, GSourceFunc,
+                                                  void*) {
+    return G_SOURCE_CONTINUE;
 }
 
+static GSourceFuncs frame_watch_funcs = {
+    gjs_profiler_frame_watch_prepare,
+    gjs_profiler_frame_watch_check,
+    gjs_profiler_frame_watch_dispatch,
+    nullptr,
+};
+
 #endif  /* ENABLE_PROFILER */
 
 /**
@@ -403,6 +1166,13 @@ gjs_profiler_sigprof(int        signum,
  * This will enable the underlying JS profiler and register a POSIX timer to
  * deliver SIGPROF on the configured sampling frequency.
  *
+ * While the profiler runs, it also records counters for the JS heap size, memory
+ * allocated with malloc(), the numbers of live wrappers, the lengths of the
+ * toggle and promise job queues, and the number of collections by reason.
+ *
+ * If a flight recorder period was set with gjs_profiler_set_flight_recorder(),
+ * the samples are kept in memory until gjs_profiler_dump() is called.
+ *
  * To reduce sampling overhead, #GjsProfiler stashes information about the
  * profile to be calculated once the profiler has been disabled. Calling
  * gjs_profiler_stop() will result in that delayed work to be completed.
@@ -425,7 +1195,16 @@ gjs_profiler_start(GjsProfiler *self)
     struct itimerspec its = { 0 };
     struct itimerspec old_its;
 
-    if (self->fd != -1) {
+    self->flight_recording = self->flight_recorder_secs > 0;
+    if (self->flight_recording && self->fd != -1) {
+        g_warning("Flight recorder mode is not supported when writing to a "
+                  "file descriptor");
+        self->flight_recording = false;
+    }
+
+    if (self->flight_recording) {
+        self->capture = gjs_profiler_new_flight_capture(self);
+    } else if (self->fd != -1) {
         self->capture = sysprof_capture_writer_new_from_fd(self->fd, 0);
         self->fd = -1;
     } else {
@@ -441,15 +1220,17 @@ gjs_profiler_start(GjsProfiler *self)
         return;
     }
 
-    /* Automatically flush to be resilient against SIGINT, etc */
-    sysprof_capture_writer_set_flush_delay(self->capture,
-                                           g_main_context_get_thread_default(),
-                                           FLUSH_DELAY_SECONDS);
+    if (!self->flight_recording) {
+        /* Automatically flush to be resilient against SIGINT, etc */
+        sysprof_capture_writer_set_flush_delay(
+            self->capture, g_main_context_get_thread_default(),
+            FLUSH_DELAY_SECONDS);
 
-    if (!gjs_profiler_extract_maps(self)) {
-        g_warning("Failed to extract proc maps");
-        g_clear_pointer(&self->capture, sysprof_capture_writer_unref);
-        return;
+        if (!gjs_profiler_extract_maps(self, self->capture)) {
+            g_warning("Failed to extract proc maps");
+            g_clear_pointer(&self->capture, sysprof_capture_writer_unref);
+            return;
+        }
     }
 
     /* Setup our signal handler for SIGPROF delivery */
@@ -483,11 +1264,36 @@ gjs_profiler_start(GjsProfiler *self)
         return;
     }
 
+    self->stack_low = self->stack_high = 0;
+    if (self->native_stacks) {
+        pthread_attr_t attr;
+        void* stack_addr;
+        size_t stack_size;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+            if (pthread_attr_getstack(&attr, &stack_addr, &stack_size) == 0) {
+                self->stack_low = uintptr_t(stack_addr);
+                self->stack_high = self->stack_low + stack_size;
+            }
+            pthread_attr_destroy(&attr);
+        }
+        if (self->stack_high == 0)
+            g_warning("Failed to find the stack of the JS thread; not "
+                      "sampling native frames");
+    }
+
+    /* The jitmap addresses in the label table and the counter IDs belong to
+     * the previous capture */
+    g_atomic_int_inc(&self->label_generation);
+    self->capture_generation++;
+    memset(self->gc_reason_counts, 0, sizeof(self->gc_reason_counts));
+    g_atomic_int_set(&self->capture_failed, 0);
+    self->n_label_hits = self->n_label_misses = self->n_label_overflows = 0;
+
     /* Calculate sampling interval */
-    its.it_interval.tv_sec = 0;
-    its.it_interval.tv_nsec = NSEC_PER_SEC / SAMPLES_PER_SEC;
-    its.it_value.tv_sec = 0;
-    its.it_value.tv_nsec = NSEC_PER_SEC / SAMPLES_PER_SEC;
+    uint64_t interval = NSEC_PER_SEC / self->samples_per_sec;
+    its.it_interval.tv_sec = interval / NSEC_PER_SEC;
+    its.it_interval.tv_nsec = interval % NSEC_PER_SEC;
+    its.it_value = its.it_interval;
 
     /* Now start this timer */
     if (timer_settime(self->timer, 0, &its, &old_its) != 0) {
@@ -505,7 +1311,39 @@ gjs_profiler_start(GjsProfiler *self)
     /* Start recording stack info */
     js::EnableContextProfilingStack(self->cx, true);
 
-    g_message("Profiler started");
+    self->previous_gc_slice_callback =
+        JS::SetGCSliceCallback(self->cx, gjs_profiler_gc_slice);
+    self->counters_id = g_timeout_add(COUNTER_INTERVAL_MS,
+                                      gjs_profiler_write_counters, self);
+
+    if (self->allocation_probability > 0)
+        gjs_profiler_start_allocation_sampling(self);
+
+    if (self->flight_recording) {
+        self->rotate_id = g_timeout_add_seconds(self->flight_recorder_secs,
+                                                gjs_profiler_rotate, self);
+        if (self->sigusr2_id == 0)
+            self->dump_sigusr2_id = g_unix_signal_add(
+                SIGUSR2, gjs_profiler_sigusr2, profiling_context);
+    }
+
+    if (self->long_frame_ms > 0) {
+        self->frame_watch =
+            g_source_new(&frame_watch_funcs, sizeof(GjsFrameWatch));
+        reinterpret_cast<GjsFrameWatch*>(self->frame_watch)->profiler = self;
+        /* Highest priority, so that it's prepared and checked on every
+         * iteration, even when other sources are ready */
+        g_source_set_priority(self->frame_watch, G_MININT);
+        g_source_set_name(self->frame_watch, "GJS profiler frame watch");
+        g_source_attach(self->frame_watch,
+                        g_main_context_get_thread_default());
+    }
+
+    if (self->flight_recording)
+        g_message("Profiler started, keeping the last %u to %u seconds",
+                  self->flight_recorder_secs, 2 * self->flight_recorder_secs);
+    else
+        g_message("Profiler started");
 
 #else  /* !ENABLE_PROFILER */
 
@@ -532,7 +1370,8 @@ gjs_profiler_start(GjsProfiler *self)
 void
 gjs_profiler_stop(GjsProfiler *self)
 {
-    /* Note: can be called from a signal handler */
+    /* Note: must not be called from a signal handler; it runs JS to stop
+     * sampling allocations */
 
     g_assert(self);
 
@@ -548,9 +1387,34 @@ gjs_profiler_stop(GjsProfiler *self)
     js::EnableContextProfilingStack(self->cx, false);
     js::SetContextProfilingStack(self->cx, nullptr);
 
+    JS::SetGCSliceCallback(self->cx, self->previous_gc_slice_callback);
+    self->previous_gc_slice_callback = nullptr;
+
+    if (self->counters_id != 0) {
+        g_source_remove(self->counters_id);
+        self->counters_id = 0;
+    }
+    if (self->drain_allocations_id != 0)
+        gjs_profiler_stop_allocation_sampling(self);
+    if (self->rotate_id != 0) {
+        g_source_remove(self->rotate_id);
+        self->rotate_id = 0;
+    }
+    if (self->dump_sigusr2_id != 0) {
+        g_source_remove(self->dump_sigusr2_id);
+        self->dump_sigusr2_id = 0;
+    }
+    if (self->frame_watch) {
+        g_source_destroy(self->frame_watch);
+        g_clear_pointer(&self->frame_watch, g_source_unref);
+    }
+
+    gjs_profiler_report_labels(self);
     sysprof_capture_writer_flush(self->capture);
 
     g_clear_pointer(&self->capture, sysprof_capture_writer_unref);
+    g_clear_pointer(&self->previous_capture, sysprof_capture_writer_unref);
+    self->flight_recording = false;
 
     g_message("Profiler stopped");
 
@@ -568,10 +1432,18 @@ gjs_profiler_sigusr2(void *data)
     GjsProfiler *current_profiler = gjs_context_get_profiler(context);
 
     if (current_profiler) {
-        if (_gjs_profiler_is_running(current_profiler))
+        if (current_profiler->flight_recording) {
+            GError* error = nullptr;
+            if (!gjs_profiler_dump(current_profiler, &error)) {
+                g_warning("Failed to dump flight recording: %s",
+                          error->message);
+                g_error_free(error);
+            }
+        } else if (_gjs_profiler_is_running(current_profiler)) {
             gjs_profiler_stop(current_profiler);
-        else
+        } else {
             gjs_profiler_start(current_profiler);
+        }
     }
 
     return G_SOURCE_CONTINUE;
@@ -585,7 +1457,8 @@ gjs_profiler_sigusr2(void *data)
  *
  * If you want to simply allow profiling of your process with minimal
  * fuss, simply call gjs_profiler_setup_signals(). This will allow
- * enabling and disabling the profiler with SIGUSR2. You must call
+ * enabling and disabling the profiler with SIGUSR2, or dumping the recording
+ * while the profiler runs in flight recorder mode. You must call
  * this from main() immediately when your program starts and must not
  * block SIGUSR2 from your signal mask.
  *
@@ -682,12 +1555,34 @@ void _gjs_profiler_add_mark(GjsProfiler* self, gint64 time_nsec,
 
 #ifdef ENABLE_PROFILER
     if (self->running && self->capture != nullptr) {
+        GjsAutoBlockSigprof block;
         sysprof_capture_writer_add_mark(self->capture, time_nsec, -1, self->pid,
                                         duration_nsec, group, name, message);
     }
 #endif
 }
 
+/*
+ * _gjs_profiler_invalidate_labels:
+ * @self: A #GjsProfiler
+ *
+ * Empties the table that the SIGPROF handler uses to avoid building the names
+ * of stack frames over again. It is keyed on the addresses of the strings,
+ * which may be freed and reused for other strings when scripts are finalized,
+ * so this must be called when the garbage collector starts sweeping. Scripts
+ * that are swept can't be on the stack anymore, so the table can't pick up
+ * their strings again after that.
+ *
+ * Safe to call while the profiler is running.
+ */
+void _gjs_profiler_invalidate_labels(GjsProfiler* self) {
+    g_return_if_fail(self);
+
+#ifdef ENABLE_PROFILER
+    g_atomic_int_inc(&self->label_generation);
+#endif
+}
+
 void gjs_profiler_set_fd(GjsProfiler* self, int fd) {
     g_return_if_fail(self);
     g_return_if_fail(!self->filename);
@@ -701,3 +1596,208 @@ void gjs_profiler_set_fd(GjsProfiler* self, int fd) {
     }
 #endif
 }
+
+/**
+ * gjs_profiler_set_sample_rate:
+ * @self: A #GjsProfiler
+ * @samples_per_sec: sampling frequency, between 1 and 10000
+ *
+ * Sets how many times per second the JS stack is sampled. The default is 1000.
+ * Lower rates make the profiler cheaper to leave running for a long time, at
+ * the cost of detail.
+ */
+void gjs_profiler_set_sample_rate(GjsProfiler* self, unsigned samples_per_sec) {
+    g_return_if_fail(self);
+    g_return_if_fail(!self->running);
+    g_return_if_fail(samples_per_sec > 0 && samples_per_sec <= 10000);
+
+    self->samples_per_sec = samples_per_sec;
+}
+
+/**
+ * gjs_profiler_set_native_stacks:
+ * @self: A #GjsProfiler
+ * @enabled: whether to sample native frames
+ *
+ * Makes the profiler sample the native stack as well as the JS stack, so that
+ * the C functions that JS code calls into show up in the profile under their
+ * JS callers, and vice versa.
+ *
+ * The native stack is found by following frame pointers. Code that was built
+ * without them (for example, with `-fomit-frame-pointer`, which many
+ * distributions use by default) breaks the chain, and the frames outside it
+ * are missing from the samples. Only x86, x86-64, and AArch64 are supported.
+ */
+void gjs_profiler_set_native_stacks(GjsProfiler* self, gboolean enabled) {
+    g_return_if_fail(self);
+    g_return_if_fail(!self->running);
+
+    self->native_stacks = !!enabled;
+}
+
+/**
+ * gjs_profiler_set_allocation_sampling:
+ * @self: A #GjsProfiler
+ * @probability: chance that a JS allocation is sampled, between 0 and 1, or 0
+ *   to disable
+ *
+ * Makes the profiler sample JS allocations, along with the JS stack at the time
+ * of the allocation, using the allocation log of the Debugger API. When the
+ * profiler stops, the samples are written to a file named after the file set
+ * with gjs_profiler_set_filename(), for example
+ * `gjs-$PID-allocations.folded`. In flight recorder mode, they are written
+ * along with each dump instead, for example to `gjs-$PID-1-allocations.folded`,
+ * and only cover the same periods as the dump. The file is in the collapsed
+ * stack format
+ * that flame graph tools read, weighted by the estimated number of bytes
+ * allocated, and ends each stack with the class of the allocated objects.
+ *
+ * Tracking allocation sites slows down all allocations, so use a small
+ * probability such as 0.01 unless you need every allocation.
+ */
+void gjs_profiler_set_allocation_sampling(GjsProfiler* self,
+                                          double probability) {
+    g_return_if_fail(self);
+    g_return_if_fail(!self->running);
+    g_return_if_fail(probability >= 0 && probability <= 1);
+
+    self->allocation_probability = probability;
+}
+
+/**
+ * gjs_profiler_set_flight_recorder:
+ * @self: A #GjsProfiler
+ * @seconds: length of the recording to keep, or 0 to disable
+ *
+ * Makes the profiler keep its samples in memory instead of writing them out,
+ * and throw away those older than @seconds, so that it can be left running
+ * indefinitely. (Depending on when it is dumped, up to twice as many seconds
+ * may be kept.) Call gjs_profiler_dump() to write the recording to a file.
+ * The recording is also dumped when SIGUSR2 is received, and, if
+ * gjs_profiler_set_long_frame_threshold() was called, after a long main loop
+ * iteration.
+ *
+ * Each dump is written to a new file, named after the file set with
+ * gjs_profiler_set_filename() with a number appended, for example
+ * `gjs-$PID-1.syscap`. If gjs_profiler_set_allocation_sampling() was called,
+ * the allocation samples are written next to it, for example to
+ * `gjs-$PID-1-allocations.folded`. Nothing is written when the profiler is
+ * stopped.
+ *
+ * Flight recorder mode is ignored when writing to a file descriptor set with
+ * gjs_profiler_set_fd().
+ */
+void gjs_profiler_set_flight_recorder(GjsProfiler* self, unsigned seconds) {
+    g_return_if_fail(self);
+    g_return_if_fail(!self->running);
+
+    self->flight_recorder_secs = seconds;
+}
+
+/**
+ * gjs_profiler_set_long_frame_threshold:
+ * @self: A #GjsProfiler
+ * @threshold_ms: duration in milliseconds, or 0 to disable
+ *
+ * While the profiler is running, watches the thread-default main context for
+ * iterations that keep it busy for longer than @threshold_ms, and adds a
+ * "Long frame" mark to the profile for each of them. In flight recorder mode,
+ * the recording is dumped after such an iteration, unless it was already dumped
+ * less than a flight recorder period ago.
+ */
+void gjs_profiler_set_long_frame_threshold(GjsProfiler* self,
+                                           unsigned threshold_ms) {
+    g_return_if_fail(self);
+    g_return_if_fail(!self->running);
+
+    self->long_frame_ms = threshold_ms;
+}
+
+/**
+ * gjs_profiler_dump:
+ * @self: A #GjsProfiler
+ * @error: return location for a #GError, or %NULL
+ *
+ * Writes the samples kept by a profiler running in flight recorder mode to a
+ * new file, and its allocation samples, if any, to another one. See
+ * gjs_profiler_set_flight_recorder(). The profiler keeps running.
+ *
+ * Returns: %TRUE if the recording was written, %FALSE otherwise.
+ */
+bool gjs_profiler_dump(GjsProfiler* self, GError** error) {
+    g_return_val_if_fail(self, false);
+    g_return_val_if_fail(!error || !*error, false);
+
+#ifdef ENABLE_PROFILER
+    if (!self->flight_recording) {
+        g_set_error_literal(error, GJS_ERROR, GJS_ERROR_FAILED,
+                            "The profiler is not running in flight recorder "
+                            "mode");
+        return false;
+    }
+
+    GjsAutoChar output_base = gjs_profiler_output_base(self);
+    GjsAutoChar base = g_strdup_printf("%s-%u", output_base.get(),
+                                       self->n_dumps + 1);
+    GjsAutoChar path = g_strdup_printf("%s.syscap", base.get());
+
+    SysprofCaptureWriter* output = sysprof_capture_writer_new(path, 0);
+    if (!output) {
+        int errsv = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv),
+                    "Failed to create %s: %s", path.get(), g_strerror(errsv));
+        return false;
+    }
+
+    bool ok = true;
+    {
+        GjsAutoBlockSigprof block;
+        gjs_profiler_report_labels(self);
+
+        SysprofCaptureWriter* periods[] = {self->previous_capture,
+                                           self->capture};
+        for (SysprofCaptureWriter* period : periods) {
+            if (!period)
+                continue;
+
+            SysprofCaptureReader* reader =
+                sysprof_capture_writer_create_reader(period, error);
+            ok = reader && sysprof_capture_writer_cat(output, reader, error);
+            g_clear_pointer(&reader, sysprof_capture_reader_unref);
+            if (!ok)
+                break;
+        }
+    }
+
+    sysprof_capture_writer_flush(output);
+    sysprof_capture_writer_unref(output);
+
+    if (!ok) {
+        g_unlink(path);
+        return false;
+    }
+
+    self->n_dumps++;
+    self->last_dump_time = g_get_monotonic_time();
+    g_message("Profiler flight recording written to %s", path.get());
+
+    if (self->drain_allocations_id != 0) {
+        JS::UniqueChars stacks;
+        if (self->allocation_sampler->collect(&stacks))
+            gjs_profiler_write_allocations(base, stacks.get());
+        else
+            gjs_profiler_log_allocation_exception(
+                self, "Failed to dump allocation samples");
+    }
+
+    return true;
+
+#else  /* !ENABLE_PROFILER */
+
+    g_set_error_literal(error, G_FILE_ERROR, G_FILE_ERROR_NOSYS,
+                        "Profiler is disabled. Recompile with "
+                        "--enable-profiler to use.");
+    return false;
+
+#endif  /* ENABLE_PROFILER */
+}
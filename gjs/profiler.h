@@ -28,6 +28,8 @@
 #    error "Only <gjs/gjs.h> can be included directly."
 #endif
 
+#include <stdbool.h> /* IWYU pragma: keep */
+
 #include <glib-object.h>
 #include <glib.h>
 
@@ -48,12 +50,28 @@ void gjs_profiler_set_filename(GjsProfiler *self,
 GJS_EXPORT
 void gjs_profiler_set_fd(GjsProfiler* self, int fd);
 
+GJS_EXPORT
+void gjs_profiler_set_sample_rate(GjsProfiler* self, unsigned samples_per_sec);
+GJS_EXPORT
+void gjs_profiler_set_native_stacks(GjsProfiler* self, gboolean enabled);
+GJS_EXPORT
+void gjs_profiler_set_allocation_sampling(GjsProfiler* self,
+                                          double probability);
+GJS_EXPORT
+void gjs_profiler_set_flight_recorder(GjsProfiler* self, unsigned seconds);
+GJS_EXPORT
+void gjs_profiler_set_long_frame_threshold(GjsProfiler* self,
+                                           unsigned threshold_ms);
+
 GJS_EXPORT
 void gjs_profiler_start(GjsProfiler *self);
 
 GJS_EXPORT
 void gjs_profiler_stop(GjsProfiler *self);
 
+GJS_EXPORT GJS_USE
+bool gjs_profiler_dump(GjsProfiler* self, GError** error);
+
 G_END_DECLS
 
 #endif  // GJS_PROFILER_H_
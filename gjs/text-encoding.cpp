@@ -0,0 +1,1179 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>  // for memcpy
+
+#include <memory>  // for unique_ptr
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glib.h>
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/atoms.h"
+#include "gjs/context-private.h"
+#include "gjs/jsapi-class.h"
+#include "gjs/jsapi-util.h"
+#include "gjs/macros.h"
+#include "gjs/text-encoding.h"
+#include "util/log.h"
+
+/* Converters that are not in use, keyed by "to\nfrom" */
+G_LOCK_DEFINE_STATIC(iconv_cache);
+static std::unordered_map<std::string, std::vector<GIConv>> iconv_cache;
+static const size_t MAX_IDLE_CONVERTERS = 4;
+
+GjsCachedIConv::GjsCachedIConv(const char* to_codeset,
+                               const char* from_codeset)
+    : m_iconv((GIConv)-1) {
+    m_key = to_codeset;
+    m_key += '\n';
+    m_key += from_codeset;
+
+    G_LOCK(iconv_cache);
+    auto it = iconv_cache.find(m_key);
+    if (it != iconv_cache.end() && !it->second.empty()) {
+        m_iconv = it->second.back();
+        it->second.pop_back();
+    }
+    G_UNLOCK(iconv_cache);
+
+    if (!is_valid())
+        m_iconv = g_iconv_open(to_codeset, from_codeset);
+}
+
+GjsCachedIConv::~GjsCachedIConv(void) {
+    if (!is_valid())
+        return;
+
+    // Discard any state left over from an incomplete conversion
+    g_iconv(m_iconv, nullptr, nullptr, nullptr, nullptr);
+
+    G_LOCK(iconv_cache);
+    std::vector<GIConv>& idle = iconv_cache[m_key];
+    if (idle.size() < MAX_IDLE_CONVERTERS) {
+        idle.push_back(m_iconv);
+        m_iconv = (GIConv)-1;
+    }
+    G_UNLOCK(iconv_cache);
+
+    if (is_valid())
+        g_iconv_close(m_iconv);
+}
+
+/* Whether none of the 8 bytes at @data has the high bit set. Checking a word
+ * at a time makes the common case of long runs of ASCII several times faster
+ * than checking byte by byte. */
+GJS_ALWAYS_INLINE GJS_USE static inline bool is_ascii_word(
+    const uint8_t* data) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    return (word & UINT64_C(0x8080808080808080)) == 0;
+}
+
+/* Same, for 4 UTF-16 code units */
+GJS_ALWAYS_INLINE GJS_USE static inline bool is_ascii_word(
+    const char16_t* data) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    return (word & UINT64_C(0xff80ff80ff80ff80)) == 0;
+}
+
+GJS_USE
+static bool is_ascii(const uint8_t* data, size_t len) {
+    size_t ix = 0;
+    for (; ix + 8 <= len; ix += 8) {
+        if (!is_ascii_word(data + ix))
+            return false;
+    }
+    for (; ix < len; ix++) {
+        if (data[ix] >= 0x80)
+            return false;
+    }
+    return true;
+}
+
+static void append_code_point(std::u16string* out, uint32_t code_point) {
+    if (code_point < 0x10000) {
+        out->push_back(code_point);
+        return;
+    }
+    code_point -= 0x10000;
+    out->push_back(0xd800 + (code_point >> 10));
+    out->push_back(0xdc00 + (code_point & 0x3ff));
+}
+
+// Characters for the bytes 0x80-0x9f in windows-1252; the rest are the same
+// as in Latin-1
+static const char16_t windows_1252_c1[] = {
+    0x20ac, 0x0081, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,
+    0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008d, 0x017d, 0x008f,
+    0x0090, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+    0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0x009d, 0x017e, 0x0178,
+};
+
+enum class GjsEncoding { UTF8, UTF16LE, UTF16BE, WINDOWS_1252, ICONV };
+
+// The labels from the WHATWG Encoding standard for the encodings decoded
+// without iconv
+static const struct {
+    const char* label;
+    GjsEncoding encoding;
+} encoding_labels[] = {
+    {"unicode-1-1-utf-8", GjsEncoding::UTF8},
+    {"unicode11utf8", GjsEncoding::UTF8},
+    {"unicode20utf8", GjsEncoding::UTF8},
+    {"utf-8", GjsEncoding::UTF8},
+    {"utf8", GjsEncoding::UTF8},
+    {"x-unicode20utf8", GjsEncoding::UTF8},
+    {"csunicode", GjsEncoding::UTF16LE},
+    {"iso-10646-ucs-2", GjsEncoding::UTF16LE},
+    {"ucs-2", GjsEncoding::UTF16LE},
+    {"unicode", GjsEncoding::UTF16LE},
+    {"unicodefeff", GjsEncoding::UTF16LE},
+    {"utf-16", GjsEncoding::UTF16LE},
+    {"utf-16le", GjsEncoding::UTF16LE},
+    {"unicodefffe", GjsEncoding::UTF16BE},
+    {"utf-16be", GjsEncoding::UTF16BE},
+    {"ansi_x3.4-1968", GjsEncoding::WINDOWS_1252},
+    {"ascii", GjsEncoding::WINDOWS_1252},
+    {"cp1252", GjsEncoding::WINDOWS_1252},
+    {"cp819", GjsEncoding::WINDOWS_1252},
+    {"csisolatin1", GjsEncoding::WINDOWS_1252},
+    {"ibm819", GjsEncoding::WINDOWS_1252},
+    {"iso-8859-1", GjsEncoding::WINDOWS_1252},
+    {"iso-ir-100", GjsEncoding::WINDOWS_1252},
+    {"iso8859-1", GjsEncoding::WINDOWS_1252},
+    {"iso88591", GjsEncoding::WINDOWS_1252},
+    {"iso_8859-1", GjsEncoding::WINDOWS_1252},
+    {"iso_8859-1:1987", GjsEncoding::WINDOWS_1252},
+    {"l1", GjsEncoding::WINDOWS_1252},
+    {"latin1", GjsEncoding::WINDOWS_1252},
+    {"us-ascii", GjsEncoding::WINDOWS_1252},
+    {"windows-1252", GjsEncoding::WINDOWS_1252},
+    {"x-cp1252", GjsEncoding::WINDOWS_1252},
+};
+
+static const char* encoding_names[] = {"utf-8", "utf-16le", "utf-16be",
+                                       "windows-1252"};
+
+// The labels from the WHATWG Encoding standard for the other encodings, with
+// the encoding's name and the iconv codeset that decodes it, if the name isn't
+// one. Where the standard describes an encoding as a Microsoft code page, that
+// code page is used.
+// Labels that are in neither table are rejected, including those of the
+// standard's "replacement" encoding and of x-user-defined.
+static const struct {
+    const char* label;
+    const char* name;
+    const char* codeset;  // nullptr if the same as the name
+} iconv_labels[] = {
+    {"866", "ibm866", nullptr},
+    {"cp866", "ibm866", nullptr},
+    {"csibm866", "ibm866", nullptr},
+    {"ibm866", "ibm866", nullptr},
+    {"csisolatin2", "iso-8859-2", nullptr},
+    {"iso-8859-2", "iso-8859-2", nullptr},
+    {"iso-ir-101", "iso-8859-2", nullptr},
+    {"iso8859-2", "iso-8859-2", nullptr},
+    {"iso88592", "iso-8859-2", nullptr},
+    {"iso_8859-2", "iso-8859-2", nullptr},
+    {"iso_8859-2:1987", "iso-8859-2", nullptr},
+    {"l2", "iso-8859-2", nullptr},
+    {"latin2", "iso-8859-2", nullptr},
+    {"csisolatin3", "iso-8859-3", nullptr},
+    {"iso-8859-3", "iso-8859-3", nullptr},
+    {"iso-ir-109", "iso-8859-3", nullptr},
+    {"iso8859-3", "iso-8859-3", nullptr},
+    {"iso88593", "iso-8859-3", nullptr},
+    {"iso_8859-3", "iso-8859-3", nullptr},
+    {"iso_8859-3:1988", "iso-8859-3", nullptr},
+    {"l3", "iso-8859-3", nullptr},
+    {"latin3", "iso-8859-3", nullptr},
+    {"csisolatin4", "iso-8859-4", nullptr},
+    {"iso-8859-4", "iso-8859-4", nullptr},
+    {"iso-ir-110", "iso-8859-4", nullptr},
+    {"iso8859-4", "iso-8859-4", nullptr},
+    {"iso88594", "iso-8859-4", nullptr},
+    {"iso_8859-4", "iso-8859-4", nullptr},
+    {"iso_8859-4:1988", "iso-8859-4", nullptr},
+    {"l4", "iso-8859-4", nullptr},
+    {"latin4", "iso-8859-4", nullptr},
+    {"csisolatincyrillic", "iso-8859-5", nullptr},
+    {"cyrillic", "iso-8859-5", nullptr},
+    {"iso-8859-5", "iso-8859-5", nullptr},
+    {"iso-ir-144", "iso-8859-5", nullptr},
+    {"iso8859-5", "iso-8859-5", nullptr},
+    {"iso88595", "iso-8859-5", nullptr},
+    {"iso_8859-5", "iso-8859-5", nullptr},
+    {"iso_8859-5:1988", "iso-8859-5", nullptr},
+    {"arabic", "iso-8859-6", nullptr},
+    {"asmo-708", "iso-8859-6", nullptr},
+    {"csiso88596e", "iso-8859-6", nullptr},
+    {"csiso88596i", "iso-8859-6", nullptr},
+    {"csisolatinarabic", "iso-8859-6", nullptr},
+    {"ecma-114", "iso-8859-6", nullptr},
+    {"iso-8859-6", "iso-8859-6", nullptr},
+    {"iso-8859-6-e", "iso-8859-6", nullptr},
+    {"iso-8859-6-i", "iso-8859-6", nullptr},
+    {"iso-ir-127", "iso-8859-6", nullptr},
+    {"iso8859-6", "iso-8859-6", nullptr},
+    {"iso88596", "iso-8859-6", nullptr},
+    {"iso_8859-6", "iso-8859-6", nullptr},
+    {"iso_8859-6:1987", "iso-8859-6", nullptr},
+    {"csisolatingreek", "iso-8859-7", nullptr},
+    {"ecma-118", "iso-8859-7", nullptr},
+    {"elot_928", "iso-8859-7", nullptr},
+    {"greek", "iso-8859-7", nullptr},
+    {"greek8", "iso-8859-7", nullptr},
+    {"iso-8859-7", "iso-8859-7", nullptr},
+    {"iso-ir-126", "iso-8859-7", nullptr},
+    {"iso8859-7", "iso-8859-7", nullptr},
+    {"iso88597", "iso-8859-7", nullptr},
+    {"iso_8859-7", "iso-8859-7", nullptr},
+    {"iso_8859-7:1987", "iso-8859-7", nullptr},
+    {"sun_eu_greek", "iso-8859-7", nullptr},
+    {"csiso88598e", "iso-8859-8", nullptr},
+    {"csisolatinhebrew", "iso-8859-8", nullptr},
+    {"hebrew", "iso-8859-8", nullptr},
+    {"iso-8859-8", "iso-8859-8", nullptr},
+    {"iso-8859-8-e", "iso-8859-8", nullptr},
+    {"iso-ir-138", "iso-8859-8", nullptr},
+    {"iso8859-8", "iso-8859-8", nullptr},
+    {"iso88598", "iso-8859-8", nullptr},
+    {"iso_8859-8", "iso-8859-8", nullptr},
+    {"iso_8859-8:1988", "iso-8859-8", nullptr},
+    {"visual", "iso-8859-8", nullptr},
+    {"csiso88598i", "iso-8859-8-i", "ISO-8859-8"},
+    {"iso-8859-8-i", "iso-8859-8-i", "ISO-8859-8"},
+    {"logical", "iso-8859-8-i", "ISO-8859-8"},
+    {"csisolatin6", "iso-8859-10", nullptr},
+    {"iso-8859-10", "iso-8859-10", nullptr},
+    {"iso-ir-157", "iso-8859-10", nullptr},
+    {"iso8859-10", "iso-8859-10", nullptr},
+    {"iso885910", "iso-8859-10", nullptr},
+    {"l6", "iso-8859-10", nullptr},
+    {"latin6", "iso-8859-10", nullptr},
+    {"iso-8859-13", "iso-8859-13", nullptr},
+    {"iso8859-13", "iso-8859-13", nullptr},
+    {"iso885913", "iso-8859-13", nullptr},
+    {"iso-8859-14", "iso-8859-14", nullptr},
+    {"iso8859-14", "iso-8859-14", nullptr},
+    {"iso885914", "iso-8859-14", nullptr},
+    {"csisolatin9", "iso-8859-15", nullptr},
+    {"iso-8859-15", "iso-8859-15", nullptr},
+    {"iso8859-15", "iso-8859-15", nullptr},
+    {"iso885915", "iso-8859-15", nullptr},
+    {"iso_8859-15", "iso-8859-15", nullptr},
+    {"l9", "iso-8859-15", nullptr},
+    {"iso-8859-16", "iso-8859-16", nullptr},
+    {"cskoi8r", "koi8-r", nullptr},
+    {"koi", "koi8-r", nullptr},
+    {"koi8", "koi8-r", nullptr},
+    {"koi8-r", "koi8-r", nullptr},
+    {"koi8_r", "koi8-r", nullptr},
+    {"koi8-ru", "koi8-u", nullptr},
+    {"koi8-u", "koi8-u", nullptr},
+    {"csmacintosh", "macintosh", nullptr},
+    {"mac", "macintosh", nullptr},
+    {"macintosh", "macintosh", nullptr},
+    {"x-mac-roman", "macintosh", nullptr},
+    {"dos-874", "windows-874", nullptr},
+    {"iso-8859-11", "windows-874", nullptr},
+    {"iso8859-11", "windows-874", nullptr},
+    {"iso885911", "windows-874", nullptr},
+    {"tis-620", "windows-874", nullptr},
+    {"windows-874", "windows-874", nullptr},
+    {"cp1250", "windows-1250", nullptr},
+    {"windows-1250", "windows-1250", nullptr},
+    {"x-cp1250", "windows-1250", nullptr},
+    {"cp1251", "windows-1251", nullptr},
+    {"windows-1251", "windows-1251", nullptr},
+    {"x-cp1251", "windows-1251", nullptr},
+    {"cp1253", "windows-1253", nullptr},
+    {"windows-1253", "windows-1253", nullptr},
+    {"x-cp1253", "windows-1253", nullptr},
+    {"cp1254", "windows-1254", nullptr},
+    {"csisolatin5", "windows-1254", nullptr},
+    {"iso-8859-9", "windows-1254", nullptr},
+    {"iso-ir-148", "windows-1254", nullptr},
+    {"iso8859-9", "windows-1254", nullptr},
+    {"iso88599", "windows-1254", nullptr},
+    {"iso_8859-9", "windows-1254", nullptr},
+    {"iso_8859-9:1989", "windows-1254", nullptr},
+    {"l5", "windows-1254", nullptr},
+    {"latin5", "windows-1254", nullptr},
+    {"windows-1254", "windows-1254", nullptr},
+    {"x-cp1254", "windows-1254", nullptr},
+    {"cp1255", "windows-1255", nullptr},
+    {"windows-1255", "windows-1255", nullptr},
+    {"x-cp1255", "windows-1255", nullptr},
+    {"cp1256", "windows-1256", nullptr},
+    {"windows-1256", "windows-1256", nullptr},
+    {"x-cp1256", "windows-1256", nullptr},
+    {"cp1257", "windows-1257", nullptr},
+    {"windows-1257", "windows-1257", nullptr},
+    {"x-cp1257", "windows-1257", nullptr},
+    {"cp1258", "windows-1258", nullptr},
+    {"windows-1258", "windows-1258", nullptr},
+    {"x-cp1258", "windows-1258", nullptr},
+    {"x-mac-cyrillic", "x-mac-cyrillic", "MAC-CYRILLIC"},
+    {"x-mac-ukrainian", "x-mac-cyrillic", "MAC-CYRILLIC"},
+    {"chinese", "gbk", "GB18030"},
+    {"csgb2312", "gbk", "GB18030"},
+    {"csiso58gb231280", "gbk", "GB18030"},
+    {"gb2312", "gbk", "GB18030"},
+    {"gb_2312", "gbk", "GB18030"},
+    {"gb_2312-80", "gbk", "GB18030"},
+    {"gbk", "gbk", "GB18030"},
+    {"iso-ir-58", "gbk", "GB18030"},
+    {"x-gbk", "gbk", "GB18030"},
+    {"gb18030", "gb18030", nullptr},
+    {"big5", "big5", "BIG5-HKSCS"},
+    {"big5-hkscs", "big5", "BIG5-HKSCS"},
+    {"cn-big5", "big5", "BIG5-HKSCS"},
+    {"csbig5", "big5", "BIG5-HKSCS"},
+    {"x-x-big5", "big5", "BIG5-HKSCS"},
+    {"cseucpkdfmtjapanese", "euc-jp", nullptr},
+    {"euc-jp", "euc-jp", nullptr},
+    {"x-euc-jp", "euc-jp", nullptr},
+    {"csiso2022jp", "iso-2022-jp", nullptr},
+    {"iso-2022-jp", "iso-2022-jp", nullptr},
+    {"csshiftjis", "shift_jis", "CP932"},
+    {"ms932", "shift_jis", "CP932"},
+    {"ms_kanji", "shift_jis", "CP932"},
+    {"shift-jis", "shift_jis", "CP932"},
+    {"shift_jis", "shift_jis", "CP932"},
+    {"sjis", "shift_jis", "CP932"},
+    {"windows-31j", "shift_jis", "CP932"},
+    {"x-sjis", "shift_jis", "CP932"},
+    {"cseuckr", "euc-kr", "CP949"},
+    {"csksc56011987", "euc-kr", "CP949"},
+    {"euc-kr", "euc-kr", "CP949"},
+    {"iso-ir-149", "euc-kr", "CP949"},
+    {"korean", "euc-kr", "CP949"},
+    {"ks_c_5601-1987", "euc-kr", "CP949"},
+    {"ks_c_5601-1989", "euc-kr", "CP949"},
+    {"ksc5601", "euc-kr", "CP949"},
+    {"ksc_5601", "euc-kr", "CP949"},
+    {"windows-949", "euc-kr", "CP949"},
+};
+
+/*
+ * GjsTextDecoder:
+ *
+ * Private data of a TextDecoder object. Decoding with {stream: true} keeps any
+ * incomplete character at the end of the input in the decoder's state, to be
+ * completed by the next call.
+ *
+ * UTF-8, UTF-16, and windows-1252 are decoded here, following the WHATWG
+ * Encoding standard; all other encodings go through an iconv converter that is
+ * kept for the lifetime of the decoder.
+ */
+class GjsTextDecoder {
+    GjsEncoding m_encoding;
+    std::string m_name;
+    std::unique_ptr<GjsCachedIConv> m_iconv;
+
+    bool m_fatal : 1;
+    bool m_ignore_bom : 1;
+    bool m_do_not_flush : 1;
+    bool m_bom_seen : 1;
+    bool m_failed : 1;
+
+    // UTF-8 state
+    uint32_t m_code_point;
+    uint8_t m_bytes_needed;
+    uint8_t m_bytes_seen;
+    uint8_t m_lower_boundary;
+    uint8_t m_upper_boundary;
+
+    // UTF-16 state
+    int m_lead_byte;  // -1 if none
+    char16_t m_lead_surrogate;  // 0 if none
+
+    // Incomplete sequence at the end of the last input, for iconv
+    std::string m_leftover;
+
+    void reset(void) {
+        m_bom_seen = false;
+        m_code_point = 0;
+        m_bytes_needed = m_bytes_seen = 0;
+        m_lower_boundary = 0x80;
+        m_upper_boundary = 0xbf;
+        m_lead_byte = -1;
+        m_lead_surrogate = 0;
+        m_leftover.clear();
+        if (m_iconv)
+            g_iconv(*m_iconv, nullptr, nullptr, nullptr, nullptr);
+    }
+
+    /* Handles invalid input: in fatal mode decoding stops, otherwise the
+     * replacement character is added to the output */
+    GJS_USE bool error(std::u16string* out) {
+        if (m_fatal) {
+            m_failed = true;
+            return false;
+        }
+        out->push_back(0xfffd);
+        return true;
+    }
+
+    GJS_USE bool decode_utf8(const uint8_t* data, size_t len,
+                             std::u16string* out);
+    GJS_USE bool decode_utf16(const uint8_t* data, size_t len,
+                              std::u16string* out);
+    void decode_windows_1252(const uint8_t* data, size_t len,
+                             std::u16string* out);
+    GJS_USE bool decode_iconv(const uint8_t* data, size_t len,
+                              std::u16string* out);
+    GJS_USE bool flush(std::u16string* out);
+
+ public:
+    GjsTextDecoder(bool fatal, bool ignore_bom)
+        : m_encoding(GjsEncoding::UTF8),
+          m_fatal(fatal),
+          m_ignore_bom(ignore_bom),
+          m_do_not_flush(false),
+          m_failed(false) {
+        reset();
+    }
+
+    GJS_USE bool set_label(const char* label);
+
+    GJS_USE const char* name(void) const { return m_name.c_str(); }
+    GJS_USE bool fatal(void) const { return m_fatal; }
+    GJS_USE bool ignore_bom(void) const { return m_ignore_bom; }
+
+    GJS_USE bool fast_path(const uint8_t* data, size_t len) const;
+    GJS_USE bool decode(const uint8_t* data, size_t len, bool stream,
+                        std::u16string* out, std::string* latin1_out);
+};
+
+/* Looks up the encoding for @label, ignoring case and surrounding whitespace.
+ * Returns false if there is no such encoding. */
+bool GjsTextDecoder::set_label(const char* label) {
+    GjsAutoChar normalized = g_ascii_strdown(label, -1);
+    g_strstrip(normalized);
+
+    for (const auto& entry : encoding_labels) {
+        if (strcmp(normalized, entry.label) == 0) {
+            m_encoding = entry.encoding;
+            m_name = encoding_names[int(entry.encoding)];
+            return true;
+        }
+    }
+
+    for (const auto& entry : iconv_labels) {
+        if (strcmp(normalized, entry.label) == 0) {
+            m_encoding = GjsEncoding::ICONV;
+            m_name = entry.name;
+            m_iconv.reset(new GjsCachedIConv(
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+                "UTF-16LE",
+#else
+                "UTF-16BE",
+#endif
+                entry.codeset ? entry.codeset : entry.name));
+            // The iconv implementation may not have all of them
+            return m_iconv->is_valid();
+        }
+    }
+
+    return false;
+}
+
+bool GjsTextDecoder::decode_utf8(const uint8_t* data, size_t len,
+                                 std::u16string* out) {
+    size_t ix = 0;
+    while (ix < len) {
+        if (m_bytes_needed == 0) {
+            for (; ix + 8 <= len && is_ascii_word(data + ix); ix += 8)
+                out->append(data + ix, data + ix + 8);
+            if (ix == len)
+                break;
+
+            uint8_t byte = data[ix++];
+            if (byte < 0x80) {
+                out->push_back(byte);
+            } else if (byte >= 0xc2 && byte <= 0xdf) {
+                m_bytes_needed = 1;
+                m_code_point = byte & 0x1f;
+            } else if (byte >= 0xe0 && byte <= 0xef) {
+                if (byte == 0xe0)
+                    m_lower_boundary = 0xa0;
+                else if (byte == 0xed)
+                    m_upper_boundary = 0x9f;
+                m_bytes_needed = 2;
+                m_code_point = byte & 0xf;
+            } else if (byte >= 0xf0 && byte <= 0xf4) {
+                if (byte == 0xf0)
+                    m_lower_boundary = 0x90;
+                else if (byte == 0xf4)
+                    m_upper_boundary = 0x8f;
+                m_bytes_needed = 3;
+                m_code_point = byte & 0x7;
+            } else if (!error(out)) {
+                return false;
+            }
+            continue;
+        }
+
+        uint8_t byte = data[ix];
+        if (byte < m_lower_boundary || byte > m_upper_boundary) {
+            // The byte is not consumed; it may start the next sequence
+            m_code_point = 0;
+            m_bytes_needed = m_bytes_seen = 0;
+            m_lower_boundary = 0x80;
+            m_upper_boundary = 0xbf;
+            if (!error(out))
+                return false;
+            continue;
+        }
+
+        ix++;
+        m_lower_boundary = 0x80;
+        m_upper_boundary = 0xbf;
+        m_code_point = (m_code_point << 6) | (byte & 0x3f);
+        if (++m_bytes_seen < m_bytes_needed)
+            continue;
+
+        append_code_point(out, m_code_point);
+        m_code_point = 0;
+        m_bytes_needed = m_bytes_seen = 0;
+    }
+    return true;
+}
+
+bool GjsTextDecoder::decode_utf16(const uint8_t* data, size_t len,
+                                  std::u16string* out) {
+    for (size_t ix = 0; ix < len; ix++) {
+        if (m_lead_byte < 0) {
+            m_lead_byte = data[ix];
+            continue;
+        }
+
+        char16_t unit = m_encoding == GjsEncoding::UTF16LE
+                            ? (data[ix] << 8) | m_lead_byte
+                            : (m_lead_byte << 8) | data[ix];
+        m_lead_byte = -1;
+
+        if (m_lead_surrogate) {
+            char16_t lead = m_lead_surrogate;
+            m_lead_surrogate = 0;
+            if (unit >= 0xdc00 && unit <= 0xdfff) {
+                out->push_back(lead);
+                out->push_back(unit);
+                continue;
+            }
+            // Unpaired; the unit is then processed by itself
+            if (!error(out))
+                return false;
+        }
+
+        if (unit >= 0xd800 && unit <= 0xdbff) {
+            m_lead_surrogate = unit;
+        } else if (unit >= 0xdc00 && unit <= 0xdfff) {
+            if (!error(out))
+                return false;
+        } else {
+            out->push_back(unit);
+        }
+    }
+    return true;
+}
+
+void GjsTextDecoder::decode_windows_1252(const uint8_t* data, size_t len,
+                                         std::u16string* out) {
+    for (size_t ix = 0; ix < len; ix++) {
+        uint8_t byte = data[ix];
+        if (byte >= 0x80 && byte <= 0x9f)
+            out->push_back(windows_1252_c1[byte - 0x80]);
+        else
+            out->push_back(byte);
+    }
+}
+
+bool GjsTextDecoder::decode_iconv(const uint8_t* data, size_t len,
+                                  std::u16string* out) {
+    std::string input;
+    char* inbuf = reinterpret_cast<char*>(const_cast<uint8_t*>(data));
+    size_t inbytes_left = len;
+    if (!m_leftover.empty()) {
+        input.swap(m_leftover);
+        input.append(inbuf, len);
+        inbuf = &input[0];
+        inbytes_left = input.size();
+    }
+
+    while (inbytes_left > 0) {
+        char16_t chunk[1024];
+        char* outbuf = reinterpret_cast<char*>(chunk);
+        size_t outbytes_left = sizeof(chunk);
+
+        size_t retval = g_iconv(*m_iconv, &inbuf, &inbytes_left, &outbuf,
+                                &outbytes_left);
+        out->append(chunk, (sizeof(chunk) - outbytes_left) / 2);
+        if (retval != size_t(-1) || errno == E2BIG)
+            continue;
+
+        if (errno == EINVAL) {
+            // Incomplete sequence at the end of the input
+            m_leftover.assign(inbuf, inbytes_left);
+            break;
+        }
+
+        if (!error(out))
+            return false;
+        inbuf++;
+        inbytes_left--;
+    }
+    return true;
+}
+
+/* Checks for an incomplete character at the end of the input */
+bool GjsTextDecoder::flush(std::u16string* out) {
+    bool incomplete = m_bytes_needed != 0 || m_lead_byte >= 0 ||
+                      m_lead_surrogate != 0 || !m_leftover.empty();
+    reset();
+    return !incomplete || error(out);
+}
+
+/* Whether the input can be passed through unchanged as a Latin-1 string */
+bool GjsTextDecoder::fast_path(const uint8_t* data, size_t len) const {
+    switch (m_encoding) {
+        case GjsEncoding::UTF8:
+            return m_bytes_needed == 0 && is_ascii(data, len);
+        case GjsEncoding::WINDOWS_1252:
+            for (size_t ix = 0; ix < len; ix++) {
+                if (data[ix] >= 0x80 && data[ix] <= 0x9f)
+                    return false;
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * GjsTextDecoder::decode:
+ * @stream: whether more input will follow
+ * @out: return location for the decoded text
+ * @latin1_out: return location for the decoded text, if it could be decoded
+ *   without conversion; @out is left empty in that case
+ *
+ * Returns false if the input is invalid and the decoder is in fatal mode. This
+ * doesn't allocate from the JS heap, so the input may point into a typed array.
+ */
+bool GjsTextDecoder::decode(const uint8_t* data, size_t len, bool stream,
+                            std::u16string* out, std::string* latin1_out) {
+    if (!m_do_not_flush)
+        reset();
+    m_do_not_flush = stream;
+    m_failed = false;
+
+    if (fast_path(data, len)) {
+        latin1_out->assign(reinterpret_cast<const char*>(data), len);
+        m_bom_seen = m_bom_seen || len > 0;
+        if (!stream)
+            reset();
+        return true;
+    }
+
+    out->reserve(len);
+
+    bool ok;
+    switch (m_encoding) {
+        case GjsEncoding::UTF8:
+            ok = decode_utf8(data, len, out);
+            break;
+        case GjsEncoding::UTF16LE:
+        case GjsEncoding::UTF16BE:
+            ok = decode_utf16(data, len, out);
+            break;
+        case GjsEncoding::WINDOWS_1252:
+            decode_windows_1252(data, len, out);
+            ok = true;
+            break;
+        default:
+            ok = decode_iconv(data, len, out);
+    }
+    // Check for the BOM before flushing, which forgets that any text has been
+    // seen; only the start of the stream may have one
+    if (ok && !m_bom_seen && !out->empty() &&
+        m_encoding != GjsEncoding::ICONV &&
+        m_encoding != GjsEncoding::WINDOWS_1252) {
+        m_bom_seen = true;
+        if (!m_ignore_bom && (*out)[0] == 0xfeff)
+            out->erase(0, 1);
+    }
+
+    if (!ok || (!stream && !flush(out))) {
+        reset();
+        m_do_not_flush = false;
+        return false;
+    }
+    return true;
+}
+
+GJS_USE
+static JSObject* gjs_text_decoder_get_proto(JSContext*);
+GJS_USE
+static JSObject* gjs_text_encoder_get_proto(JSContext*);
+
+GJS_DEFINE_PROTO("TextDecoder", text_decoder, JSCLASS_BACKGROUND_FINALIZE)
+GJS_DEFINE_PRIV_FROM_JS(GjsTextDecoder, gjs_text_decoder_class);
+
+GJS_DEFINE_PROTO("TextEncoder", text_encoder, JSCLASS_BACKGROUND_FINALIZE)
+
+/* Reads a boolean member of an options dictionary, which may be undefined */
+GJS_JSAPI_RETURN_CONVENTION
+static bool get_bool_option(JSContext* cx, JS::HandleValue options,
+                            JS::HandleId id, bool* value) {
+    *value = false;
+    if (options.isNullOrUndefined())
+        return true;
+    if (!options.isObject()) {
+        gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                         "Options must be an object");
+        return false;
+    }
+
+    JS::RootedObject options_obj(cx, &options.toObject());
+    JS::RootedValue v_value(cx);
+    if (!JS_GetPropertyById(cx, options_obj, id, &v_value))
+        return false;
+    *value = JS::ToBoolean(v_value);
+    return true;
+}
+
+GJS_NATIVE_CONSTRUCTOR_DECLARE(text_decoder) {
+    GJS_NATIVE_CONSTRUCTOR_VARIABLES(text_decoder)
+
+    GJS_NATIVE_CONSTRUCTOR_PRELUDE(text_decoder);
+
+    const char* label = "utf-8";
+    JS::UniqueChars label_buf;
+    if (!argv.get(0).isUndefined()) {
+        JS::RootedString label_str(context, JS::ToString(context, argv[0]));
+        if (!label_str)
+            return false;
+        label_buf.reset(JS_EncodeStringToUTF8(context, label_str));
+        if (!label_buf)
+            return false;
+        label = label_buf.get();
+    }
+
+    const GjsAtoms& atoms = GjsContextPrivate::atoms(context);
+    bool fatal, ignore_bom;
+    if (!get_bool_option(context, argv.get(1), atoms.fatal(), &fatal) ||
+        !get_bool_option(context, argv.get(1), atoms.ignore_bom(), &ignore_bom))
+        return false;
+
+    auto* priv = new GjsTextDecoder(fatal, ignore_bom);
+    if (!priv->set_label(label)) {
+        delete priv;
+        gjs_throw_custom(context, JSProto_RangeError, nullptr,
+                         "Unsupported encoding label '%s'", label);
+        return false;
+    }
+    JS_SetPrivate(object, priv);
+
+    GJS_NATIVE_CONSTRUCTOR_FINISH(text_decoder);
+    return true;
+}
+
+static void gjs_text_decoder_finalize(JSFreeOp*, JSObject* obj) {
+    delete static_cast<GjsTextDecoder*>(JS_GetPrivate(obj));
+    JS_SetPrivate(obj, nullptr);
+}
+
+/* Input to TextDecoder.decode() may be an ArrayBuffer or a view on one */
+GJS_JSAPI_RETURN_CONVENTION
+static bool check_buffer_source(JSContext* cx, JS::HandleValue value) {
+    if (value.isUndefined() ||
+        (value.isObject() && (JS_IsArrayBufferViewObject(&value.toObject()) ||
+                              JS_IsArrayBufferObject(&value.toObject()))))
+        return true;
+
+    gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                     "Argument to TextDecoder.decode() must be an ArrayBuffer "
+                     "or a typed array");
+    return false;
+}
+
+/* The pointer is only valid until the next garbage collection */
+static void get_buffer_source_data(JS::HandleValue value, uint8_t** data,
+                                   uint32_t* len) {
+    *data = nullptr;
+    *len = 0;
+    if (value.isUndefined())
+        return;
+
+    bool is_shared_memory;
+    if (!JS_GetObjectAsArrayBufferView(&value.toObject(), len,
+                                       &is_shared_memory, data))
+        JS_GetObjectAsArrayBuffer(&value.toObject(), len, data);
+}
+
+GJS_JSAPI_RETURN_CONVENTION
+static bool decode_func(JSContext* cx, unsigned argc, JS::Value* vp) {
+    GJS_GET_PRIV(cx, argc, vp, args, obj, GjsTextDecoder, priv);
+    if (!priv) {
+        gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                         "TextDecoder.decode() called on the prototype");
+        return false;
+    }
+
+    // Read the options first; the getters could run a garbage collection
+    bool stream;
+    const GjsAtoms& atoms = GjsContextPrivate::atoms(cx);
+    if (!check_buffer_source(cx, args.get(0)) ||
+        !get_bool_option(cx, args.get(1), atoms.stream(), &stream))
+        return false;
+
+    std::u16string decoded;
+    std::string latin1;
+    bool ok;
+    {
+        JS::AutoCheckCannotGC nogc;
+        uint8_t* data;
+        uint32_t len;
+        get_buffer_source_data(args.get(0), &data, &len);
+        ok = priv->decode(data, len, stream, &decoded, &latin1);
+    }
+
+    if (!ok) {
+        gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                         "The encoded data was not valid for encoding %s",
+                         priv->name());
+        return false;
+    }
+
+    JSString* str;
+    if (!latin1.empty())
+        str = JS_NewStringCopyN(cx, latin1.data(), latin1.size());
+    else if (!decoded.empty())
+        str = JS_NewUCStringCopyN(cx, decoded.data(), decoded.size());
+    else
+        str = JS_GetEmptyString(cx);
+    if (!str)
+        return false;
+
+    args.rval().setString(str);
+    return true;
+}
+
+GJS_JSAPI_RETURN_CONVENTION
+static bool get_encoding_func(JSContext* cx, unsigned argc, JS::Value* vp) {
+    GJS_GET_PRIV(cx, argc, vp, args, obj, GjsTextDecoder, priv);
+    if (!priv) {
+        args.rval().setUndefined();
+        return true;
+    }
+    return gjs_string_from_utf8(cx, priv->name(), args.rval());
+}
+
+GJS_JSAPI_RETURN_CONVENTION
+static bool get_fatal_func(JSContext* cx, unsigned argc, JS::Value* vp) {
+    GJS_GET_PRIV(cx, argc, vp, args, obj, GjsTextDecoder, priv);
+    args.rval().setBoolean(priv && priv->fatal());
+    return true;
+}
+
+GJS_JSAPI_RETURN_CONVENTION
+static bool get_ignore_bom_func(JSContext* cx, unsigned argc, JS::Value* vp) {
+    GJS_GET_PRIV(cx, argc, vp, args, obj, GjsTextDecoder, priv);
+    args.rval().setBoolean(priv && priv->ignore_bom());
+    return true;
+}
+
+JSPropertySpec gjs_text_decoder_proto_props[] = {
+    JS_PSG("encoding", get_encoding_func, JSPROP_PERMANENT),
+    JS_PSG("fatal", get_fatal_func, JSPROP_PERMANENT),
+    JS_PSG("ignoreBOM", get_ignore_bom_func, JSPROP_PERMANENT),
+    JS_PS_END};
+
+JSFunctionSpec gjs_text_decoder_proto_funcs[] = {
+    JS_FN("decode", decode_func, 0, 0),
+    JS_FS_END};
+
+JSFunctionSpec gjs_text_decoder_static_funcs[] = {JS_FS_END};
+
+/* Copies a run of ASCII characters a word at a time, and returns how many were
+ * copied */
+static size_t copy_ascii_run(const JS::Latin1Char* chars, size_t len,
+                             uint8_t* dest, size_t capacity) {
+    size_t ix = 0;
+    for (; ix + 8 <= len && ix + 8 <= capacity && is_ascii_word(chars + ix);
+         ix += 8)
+        memcpy(dest + ix, chars + ix, 8);
+    return ix;
+}
+
+static size_t copy_ascii_run(const char16_t* chars, size_t len, uint8_t* dest,
+                             size_t capacity) {
+    size_t ix = 0;
+    for (; ix + 4 <= len && ix + 4 <= capacity && is_ascii_word(chars + ix);
+         ix += 4) {
+        dest[ix] = chars[ix];
+        dest[ix + 1] = chars[ix + 1];
+        dest[ix + 2] = chars[ix + 2];
+        dest[ix + 3] = chars[ix + 3];
+    }
+    return ix;
+}
+
+/* Reads the code point at @chars, replacing unpaired surrogates with U+FFFD,
+ * and returns the number of code units read */
+template <typename CharT>
+static size_t read_code_point(const CharT* chars, size_t len,
+                              uint32_t* code_point) {
+    uint32_t unit = chars[0];
+    if (unit < 0xd800 || unit > 0xdfff) {
+        *code_point = unit;
+        return 1;
+    }
+    if (unit <= 0xdbff && len > 1) {
+        uint32_t next = chars[1];
+        if (next >= 0xdc00 && next <= 0xdfff) {
+            *code_point = 0x10000 + ((unit - 0xd800) << 10) + (next - 0xdc00);
+            return 2;
+        }
+    }
+    *code_point = 0xfffd;
+    return 1;
+}
+
+GJS_USE
+static inline size_t utf8_length(uint32_t code_point) {
+    if (code_point < 0x80)
+        return 1;
+    if (code_point < 0x800)
+        return 2;
+    if (code_point < 0x10000)
+        return 3;
+    return 4;
+}
+
+template <typename CharT>
+GJS_USE static size_t utf8_length(const CharT* chars, size_t len) {
+    size_t read = 0, written = 0;
+    while (read < len) {
+        uint32_t code_point;
+        read += read_code_point(chars + read, len - read, &code_point);
+        written += utf8_length(code_point);
+    }
+    return written;
+}
+
+/* Encodes as many whole characters as fit into @capacity bytes */
+template <typename CharT>
+static void utf8_encode(const CharT* chars, size_t len, uint8_t* dest,
+                        size_t capacity, size_t* read_out,
+                        size_t* written_out) {
+    size_t read = 0, written = 0;
+    while (read < len) {
+        size_t run = copy_ascii_run(chars + read, len - read, dest + written,
+                                    capacity - written);
+        read += run;
+        written += run;
+        if (read == len)
+            break;
+
+        uint32_t code_point;
+        size_t units = read_code_point(chars + read, len - read, &code_point);
+        size_t nbytes = utf8_length(code_point);
+        if (written + nbytes > capacity)
+            break;
+
+        uint8_t* out = dest + written;
+        switch (nbytes) {
+            case 1:
+                out[0] = code_point;
+                break;
+            case 2:
+                out[0] = 0xc0 | (code_point >> 6);
+                out[1] = 0x80 | (code_point & 0x3f);
+                break;
+            case 3:
+                out[0] = 0xe0 | (code_point >> 12);
+                out[1] = 0x80 | ((code_point >> 6) & 0x3f);
+                out[2] = 0x80 | (code_point & 0x3f);
+                break;
+            default:
+                out[0] = 0xf0 | (code_point >> 18);
+                out[1] = 0x80 | ((code_point >> 12) & 0x3f);
+                out[2] = 0x80 | ((code_point >> 6) & 0x3f);
+                out[3] = 0x80 | (code_point & 0x3f);
+        }
+        read += units;
+        written += nbytes;
+    }
+    *read_out = read;
+    *written_out = written;
+}
+
+GJS_NATIVE_CONSTRUCTOR_DECLARE(text_encoder) {
+    GJS_NATIVE_CONSTRUCTOR_VARIABLES(text_encoder)
+
+    GJS_NATIVE_CONSTRUCTOR_PRELUDE(text_encoder);
+
+    GJS_NATIVE_CONSTRUCTOR_FINISH(text_encoder);
+    return true;
+}
+
+static void gjs_text_encoder_finalize(JSFreeOp*, JSObject*) {}
+
+GJS_JSAPI_RETURN_CONVENTION
+static JSString* string_arg(JSContext* cx, JS::HandleValue value) {
+    if (value.isUndefined())
+        return JS_GetEmptyString(cx);
+    return JS::ToString(cx, value);
+}
+
+GJS_JSAPI_RETURN_CONVENTION
+static bool encode_func(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedString str(cx, string_arg(cx, args.get(0)));
+    if (!str)
+        return false;
+
+    uint8_t* bytes;
+    size_t nbytes, read;
+    {
+        JS::AutoCheckCannotGC nogc;
+        size_t len;
+        if (JS_StringHasLatin1Chars(str)) {
+            const JS::Latin1Char* chars =
+                JS_GetLatin1StringCharsAndLength(cx, nogc, str, &len);
+            if (!chars)
+                return false;
+            nbytes = utf8_length(chars, len);
+            bytes = static_cast<uint8_t*>(g_malloc(nbytes));
+            utf8_encode(chars, len, bytes, nbytes, &read, &nbytes);
+        } else {
+            const char16_t* chars =
+                JS_GetTwoByteStringCharsAndLength(cx, nogc, str, &len);
+            if (!chars)
+                return false;
+            nbytes = utf8_length(chars, len);
+            bytes = static_cast<uint8_t*>(g_malloc(nbytes));
+            utf8_encode(chars, len, bytes, nbytes, &read, &nbytes);
+        }
+    }
+
+    JS::RootedObject array_buffer(cx);
+    if (nbytes > 0) {
+        array_buffer = JS_NewArrayBufferWithContents(cx, nbytes, bytes);
+    } else {
+        g_free(bytes);
+        array_buffer = JS_NewArrayBuffer(cx, 0);
+    }
+    if (!array_buffer)
+        return false;
+
+    JSObject* array = JS_NewUint8ArrayWithBuffer(cx, array_buffer, 0, -1);
+    if (!array)
+        return false;
+
+    args.rval().setObject(*array);
+    return true;
+}
+
+GJS_JSAPI_RETURN_CONVENTION
+static bool encode_into_func(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedString str(cx, string_arg(cx, args.get(0)));
+    if (!str)
+        return false;
+
+    if (!args.get(1).isObject() || !JS_IsUint8Array(&args[1].toObject())) {
+        gjs_throw_custom(cx, JSProto_TypeError, nullptr,
+                         "Second argument to TextEncoder.encodeInto() must be "
+                         "a Uint8Array");
+        return false;
+    }
+
+    size_t read, written;
+    {
+        JS::AutoCheckCannotGC nogc;
+        uint32_t capacity;
+        bool is_shared_memory;
+        uint8_t* dest;
+        js::GetUint8ArrayLengthAndData(&args[1].toObject(), &capacity,
+                                       &is_shared_memory, &dest);
+
+        size_t len;
+        if (JS_StringHasLatin1Chars(str)) {
+            const JS::Latin1Char* chars =
+                JS_GetLatin1StringCharsAndLength(cx, nogc, str, &len);
+            if (!chars)
+                return false;
+            utf8_encode(chars, len, dest, capacity, &read, &written);
+        } else {
+            const char16_t* chars =
+                JS_GetTwoByteStringCharsAndLength(cx, nogc, str, &len);
+            if (!chars)
+                return false;
+            utf8_encode(chars, len, dest, capacity, &read, &written);
+        }
+    }
+
+    const GjsAtoms& atoms = GjsContextPrivate::atoms(cx);
+    JS::RootedObject result(cx, JS_NewPlainObject(cx));
+    if (!result ||
+        !JS_DefinePropertyById(cx, result, atoms.read(), double(read),
+                               JSPROP_ENUMERATE) ||
+        !JS_DefinePropertyById(cx, result, atoms.written(), double(written),
+                               JSPROP_ENUMERATE))
+        return false;
+
+    args.rval().setObject(*result);
+    return true;
+}
+
+GJS_JSAPI_RETURN_CONVENTION
+static bool get_encoder_encoding_func(JSContext* cx, unsigned argc,
+                                      JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    return gjs_string_from_utf8(cx, "utf-8", args.rval());
+}
+
+JSPropertySpec gjs_text_encoder_proto_props[] = {
+    JS_PSG("encoding", get_encoder_encoding_func, JSPROP_PERMANENT),
+    JS_PS_END};
+
+JSFunctionSpec gjs_text_encoder_proto_funcs[] = {
+    JS_FN("encode", encode_func, 0, 0),
+    JS_FN("encodeInto", encode_into_func, 2, 0),
+    JS_FS_END};
+
+JSFunctionSpec gjs_text_encoder_static_funcs[] = {JS_FS_END};
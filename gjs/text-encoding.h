@@ -0,0 +1,68 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#ifndef GJS_TEXT_ENCODING_H_
+#define GJS_TEXT_ENCODING_H_
+
+#include <string>
+
+#include <glib.h>
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/macros.h"
+
+/*
+ * GjsCachedIConv:
+ *
+ * A character set converter taken from a process-wide cache. Opening a
+ * converter is expensive compared to converting a short string, so on
+ * destruction it is reset and put back for the next conversion between the
+ * same character sets. A converter is never shared while in use, so it may be
+ * used for streaming conversions.
+ */
+class GjsCachedIConv {
+    std::string m_key;
+    GIConv m_iconv;
+
+ public:
+    GjsCachedIConv(const char* to_codeset, const char* from_codeset);
+    ~GjsCachedIConv(void);
+
+    GjsCachedIConv(const GjsCachedIConv&) = delete;
+    GjsCachedIConv& operator=(const GjsCachedIConv&) = delete;
+
+    GJS_USE bool is_valid(void) const { return m_iconv != (GIConv)-1; }
+    GJS_USE operator GIConv(void) const { return m_iconv; }
+};
+
+GJS_JSAPI_RETURN_CONVENTION
+bool gjs_text_decoder_define_proto(JSContext* cx, JS::HandleObject module,
+                                   JS::MutableHandleObject proto);
+
+GJS_JSAPI_RETURN_CONVENTION
+bool gjs_text_encoder_define_proto(JSContext* cx, JS::HandleObject module,
+                                   JS::MutableHandleObject proto);
+
+#endif  // GJS_TEXT_ENCODING_H_
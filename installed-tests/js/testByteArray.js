@@ -70,6 +70,82 @@ describe('Byte array', function () {
         expect(() => ByteArray.toGBytes(a)).toThrow();
     });
 
+    it('is copied to a GBytes even if it was created from one', function () {
+        const bytes = new GLib.Bytes(Uint8Array.of(1, 2, 3, 4));
+        const a = ByteArray.fromGBytes(bytes);
+        const copy = ByteArray.toGBytes(a);
+        a[1] = 9;
+        expect(copy.toArray()).toEqual(Uint8Array.of(1, 2, 3, 4));
+    });
+
+    it('shares memory with its GBytes when transferred', function () {
+        const bytes = new GLib.Bytes(Uint8Array.of(1, 2, 3, 4));
+        const a = ByteArray.fromGBytes(bytes);
+        const part = ByteArray.transferToGBytes(a.subarray(1, 3));
+        expect(part.toArray()).toEqual(Uint8Array.of(2, 3));
+        expect(a.length).toEqual(0);
+    });
+
+    it('can be transferred to a GBytes', function () {
+        const a = Uint8Array.of(1, 2, 3, 4);
+        const bytes = ByteArray.transferToGBytes(a.subarray(1, 3));
+        expect(bytes.toArray()).toEqual(Uint8Array.of(2, 3));
+        expect(a.length).toEqual(0);
+    });
+
+    describe('from a mapped file', function () {
+        let dir;
+
+        beforeEach(function () {
+            dir = GLib.dir_make_tmp('gjs-test-byte-array-XXXXXX');
+        });
+
+        afterEach(function () {
+            GLib.rmdir(dir);
+        });
+
+        it('has the contents of the file', function () {
+            const path = GLib.build_filenamev([dir, 'data']);
+            GLib.file_set_contents(path, 'abcd');
+
+            const a = ByteArray.fromMappedFile(path);
+            expect(a).toEqual(Uint8Array.of(97, 98, 99, 100));
+
+            // Changes to the array don't reach the file
+            a[0] = 120;
+            expect(ByteArray.toString(a)).toEqual('xbcd');
+            const [, contents] = GLib.file_get_contents(path);
+            expect(ByteArray.toString(contents)).toEqual('abcd');
+
+            GLib.unlink(path);
+        });
+
+        it('can map a file that is not writable', function () {
+            const path = GLib.build_filenamev([dir, 'read-only']);
+            GLib.file_set_contents(path, 'abcd');
+            GLib.chmod(path, 0o444);
+
+            const a = ByteArray.fromMappedFile(path);
+            expect(a).toEqual(Uint8Array.of(97, 98, 99, 100));
+            a[0] = 120;
+            expect(ByteArray.toString(a)).toEqual('xbcd');
+
+            GLib.unlink(path);
+        });
+
+        it('can be empty', function () {
+            const path = GLib.build_filenamev([dir, 'empty']);
+            GLib.file_set_contents(path, '');
+            expect(ByteArray.fromMappedFile(path).length).toEqual(0);
+            GLib.unlink(path);
+        });
+
+        it('throws if the file does not exist', function () {
+            const path = GLib.build_filenamev([dir, 'nonexistent']);
+            expect(() => ByteArray.fromMappedFile(path)).toThrow();
+        });
+    });
+
     describe('legacy toString() behavior', function () {
         beforeEach(function () {
             GLib.test_expect_message('Gjs', GLib.LogLevelFlags.LEVEL_WARNING,
@@ -92,3 +168,159 @@ describe('Byte array', function () {
         });
     });
 });
+
+describe('TextDecoder', function () {
+    const {TextDecoder} = ByteArray;
+
+    it('decodes UTF-8 by default', function () {
+        const decoder = new TextDecoder();
+        expect(decoder.encoding).toEqual('utf-8');
+        expect(decoder.decode(Uint8Array.of(0x61, 0xc3, 0xa4, 0xf0, 0x9f, 0x8d,
+            0xb0))).toEqual('aä🍰');
+    });
+
+    it('decodes ASCII runs longer than a word', function () {
+        const s = 'The quick brown fox jumps over the lazy dog';
+        const decoder = new TextDecoder();
+        expect(decoder.decode(ByteArray.fromString(s))).toEqual(s);
+        expect(decoder.decode(ByteArray.fromString(`${s} ⅜ ${s}`)))
+            .toEqual(`${s} ⅜ ${s}`);
+    });
+
+    it('accepts ArrayBuffers and other views', function () {
+        const decoder = new TextDecoder();
+        const bytes = Uint8Array.of(0x61, 0x62, 0x63, 0x64);
+        expect(decoder.decode(bytes.buffer)).toEqual('abcd');
+        expect(decoder.decode(new DataView(bytes.buffer, 1, 2))).toEqual('bc');
+        expect(decoder.decode()).toEqual('');
+        expect(() => decoder.decode('abcd')).toThrowError(TypeError);
+    });
+
+    it('replaces invalid input', function () {
+        const decoder = new TextDecoder();
+        expect(decoder.decode(Uint8Array.of(0x61, 0xff, 0x62, 0xc3)))
+            .toEqual('a�b�');
+        expect(decoder.decode(Uint8Array.of(0xed, 0xa0, 0x80)))
+            .toEqual('���');
+    });
+
+    it('throws on invalid input in fatal mode', function () {
+        const decoder = new TextDecoder('utf-8', {fatal: true});
+        expect(decoder.fatal).toBeTruthy();
+        expect(() => decoder.decode(Uint8Array.of(0x61, 0xff)))
+            .toThrowError(TypeError);
+        expect(decoder.decode(Uint8Array.of(0x61))).toEqual('a');
+    });
+
+    it('keeps incomplete characters when streaming', function () {
+        const decoder = new TextDecoder();
+        const bytes = Uint8Array.of(0xe2, 0x85, 0x9c, 0xf0, 0x9f, 0x8d, 0xb0);
+        let s = '';
+        for (let ix = 0; ix < bytes.length; ix++)
+            s += decoder.decode(bytes.subarray(ix, ix + 1), {stream: true});
+        s += decoder.decode();
+        expect(s).toEqual('⅜🍰');
+
+        expect(decoder.decode(Uint8Array.of(0xe2, 0x85), {stream: true}))
+            .toEqual('');
+        expect(decoder.decode()).toEqual('�');
+    });
+
+    it('strips the byte order mark unless told not to', function () {
+        const bytes = Uint8Array.of(0xef, 0xbb, 0xbf, 0x61);
+        expect(new TextDecoder().decode(bytes)).toEqual('a');
+        expect(new TextDecoder('utf-8', {ignoreBOM: true}).decode(bytes))
+            .toEqual('﻿a');
+    });
+
+    it('only strips the byte order mark at the start of the stream',
+        function () {
+            const decoder = new TextDecoder();
+            expect(decoder.decode(Uint8Array.of(0x61), {stream: true}))
+                .toEqual('a');
+            expect(decoder.decode(Uint8Array.of(0xef, 0xbb, 0xbf, 0x78)))
+                .toEqual('\ufeffx');
+            expect(decoder.decode(Uint8Array.of(0xef, 0xbb, 0xbf, 0x78)))
+                .toEqual('x');
+        });
+
+    it('decodes UTF-16', function () {
+        expect(new TextDecoder('utf-16le').decode(Uint8Array.of(0x61, 0x00,
+            0x3c, 0xd8, 0x70, 0xdf))).toEqual('a🍰');
+        expect(new TextDecoder('UTF-16BE').decode(Uint8Array.of(0x00, 0x61,
+            0xd8, 0x3c))).toEqual('a�');
+    });
+
+    it('decodes Latin-1 labels as windows-1252', function () {
+        const decoder = new TextDecoder('latin1');
+        expect(decoder.encoding).toEqual('windows-1252');
+        expect(decoder.decode(Uint8Array.of(0x61, 0xe4))).toEqual('aä');
+        expect(decoder.decode(Uint8Array.of(0x80, 0x99)))
+            .toEqual('€™');
+    });
+
+    it('decodes other encodings with iconv', function () {
+        const decoder = new TextDecoder('iso-8859-15');
+        expect(decoder.encoding).toEqual('iso-8859-15');
+        expect(decoder.decode(Uint8Array.of(0xa4, 0x61))).toEqual('€a');
+    });
+
+    it('gives the standard name for labels decoded with iconv', function () {
+        expect(new TextDecoder('sjis').encoding).toEqual('shift_jis');
+        expect(new TextDecoder(' Latin2 ').encoding).toEqual('iso-8859-2');
+    });
+
+    it('decodes GBK labels with the gb18030 decoder', function () {
+        const decoder = new TextDecoder('gb2312');
+        expect(decoder.encoding).toEqual('gbk');
+        expect(decoder.decode(Uint8Array.of(0x81, 0x30, 0x81, 0x30)))
+            .toEqual('\u0080');
+    });
+
+    it('rejects unknown encodings', function () {
+        expect(() => new TextDecoder('no-such-encoding'))
+            .toThrowError(RangeError);
+    });
+
+    it('rejects encodings that are not in the standard', function () {
+        expect(() => new TextDecoder('utf-32')).toThrowError(RangeError);
+        expect(() => new TextDecoder('iso-2022-kr')).toThrowError(RangeError);
+    });
+});
+
+describe('TextEncoder', function () {
+    const {TextDecoder, TextEncoder} = ByteArray;
+
+    it('encodes UTF-8', function () {
+        const encoder = new TextEncoder();
+        expect(encoder.encoding).toEqual('utf-8');
+        expect(encoder.encode('aä🍰')).toEqual(Uint8Array.of(
+            0x61, 0xc3, 0xa4, 0xf0, 0x9f, 0x8d, 0xb0));
+        expect(encoder.encode()).toEqual(new Uint8Array(0));
+    });
+
+    it('replaces unpaired surrogates', function () {
+        expect(new TextEncoder().encode('\ud83c.'))
+            .toEqual(Uint8Array.of(0xef, 0xbf, 0xbd, 0x2e));
+    });
+
+    it('round-trips long strings', function () {
+        const s = `${'abcdefgh'.repeat(100)}⅜${'ä'.repeat(100)}`;
+        const bytes = new TextEncoder().encode(s);
+        expect(new TextDecoder().decode(bytes)).toEqual(s);
+    });
+
+    it('encodes into an existing array without splitting characters',
+        function () {
+            const encoder = new TextEncoder();
+            const dest = new Uint8Array(5);
+            expect(encoder.encodeInto('ab🍰', dest))
+                .toEqual({read: 2, written: 2});
+            expect(dest).toEqual(Uint8Array.of(0x61, 0x62, 0, 0, 0));
+
+            expect(encoder.encodeInto('🍰a', dest))
+                .toEqual({read: 3, written: 5});
+            expect(dest).toEqual(Uint8Array.of(0xf0, 0x9f, 0x8d, 0xb0, 0x61));
+            expect(() => encoder.encodeInto('a', [])).toThrowError(TypeError);
+        });
+});
@@ -27,6 +27,59 @@ describe('Introspected structs', function () {
             expect(b.some_double).toEqual(42.5);
             expect(b.some_enum).toEqual(Regress.TestEnum.VALUE3);
         });
+
+        it('coerces values written to scalar fields', function () {
+            struct.some_int = '7';
+            struct.some_double = '0.5';
+            expect(struct.some_int).toEqual(7);
+            expect(struct.some_double).toEqual(0.5);
+        });
+
+        it('throws when writing out-of-range values to scalar fields', function () {
+            expect(() => (struct.some_int8 = 128)).toThrowError(/out of range/);
+            expect(() => (struct.some_int8 = -129)).toThrowError(/out of range/);
+        });
+
+        it('leaves the field unchanged after an out-of-range value', function () {
+            expect(() => (struct.some_int8 = 300)).toThrowError(/out of range/);
+            expect(struct.some_int8).toEqual(43);
+        });
+    });
+
+    describe('with unsigned fields', function () {
+        beforeEach(function () {
+            struct = new Regress.TestBoxedC();
+        });
+
+        it('reads and writes 32-bit unsigned fields', function () {
+            struct.another_thing = 0xffffffff;
+            expect(struct.another_thing).toEqual(0xffffffff);
+            struct.another_thing = '7';
+            expect(struct.another_thing).toEqual(7);
+        });
+
+        it('throws on out-of-range values, leaving the field unchanged', function () {
+            struct.another_thing = 42;
+            expect(() => (struct.another_thing = -1)).toThrowError(/out of range/);
+            expect(() => (struct.another_thing = 2 ** 32)).toThrowError(/out of range/);
+            expect(struct.another_thing).toEqual(42);
+        });
+    });
+
+    describe('with boolean fields', function () {
+        beforeEach(function () {
+            struct = new GLib.TestConfig();
+        });
+
+        it('reads and writes them', function () {
+            expect(struct.test_quick).toBe(false);
+            struct.test_quick = true;
+            expect(struct.test_quick).toBe(true);
+            struct.test_quick = 0;
+            expect(struct.test_quick).toBe(false);
+            struct.test_quick = 'yes';
+            expect(struct.test_quick).toBe(true);
+        });
     });
 
     describe('nested', function () {
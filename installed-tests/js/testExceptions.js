@@ -164,4 +164,43 @@ describe('Exception from function with too few arguments', function () {
         let file = Gio.File.new_for_path('foo');
         expect(() => file.read()).toThrowError(/Gio\.File\.read/);
     });
-});
\ No newline at end of file
+});
+
+describe('GError stack', function () {
+    function readNonexistentFile() {
+        try {
+            Gio.File.new_for_path('/nonexistent/gjs-test').load_contents(null);
+        } catch (e) {
+            return e;
+        }
+        return null;
+    }
+
+    afterEach(function () {
+        Gio.IOErrorEnum.setCaptureStack(true);
+    });
+
+    it('is formatted when read', function () {
+        const e = readNonexistentFile();
+        expect(e.stack).toMatch(/readNonexistentFile/);
+        expect(e.lineNumber).toBeGreaterThan(0);
+    });
+
+    it('can be overwritten', function () {
+        const e = readNonexistentFile();
+        e.stack = 'custom';
+        expect(e.stack).toEqual('custom');
+    });
+
+    it('can be turned off for one error code', function () {
+        Gio.IOErrorEnum.setCaptureStack(false, Gio.IOErrorEnum.NOT_FOUND);
+        const e = readNonexistentFile();
+        expect(e.matches(Gio.IOErrorEnum, Gio.IOErrorEnum.NOT_FOUND)).toBeTruthy();
+        expect(e.stack).toBeUndefined();
+    });
+
+    it('can be turned off for a whole domain', function () {
+        Gio.IOErrorEnum.setCaptureStack(false);
+        expect(readNonexistentFile().stack).toBeUndefined();
+    });
+});
@@ -89,6 +89,49 @@ describe('C array', function () {
             let structArray = GIMarshallingTests.array_zero_terminated_return_struct();
             expect(structArray.map(e => e.long_)).toEqual([42, 43, 44]);
         });
+
+        describe('as struct array views', function () {
+            const {SimpleStruct} = GIMarshallingTests;
+
+            it('can be returned as typed views per field', function () {
+                const view = GObject.withStructArrayViews(SimpleStruct,
+                    () => GIMarshallingTests.array_fixed_out_struct());
+                expect(view.length).toEqual(2);
+                expect(view.int8 instanceof Int8Array).toBe(true);
+                expect(view.int8[0]).toEqual(6);
+                expect(view.int8[view.int8.stride]).toEqual(7);
+            });
+
+            it('are only returned while enabled', function () {
+                GObject.withStructArrayViews(SimpleStruct, () => {
+                    GObject.withStructArrayViews(SimpleStruct, () => {});
+                    expect(GIMarshallingTests.array_fixed_out_struct().int8)
+                        .toBeDefined();
+                });
+                const array = GIMarshallingTests.array_fixed_out_struct();
+                expect(array.map(e => e.int8)).toEqual([6, 7]);
+            });
+
+            it('can be passed back to C', function () {
+                const view = GObject.newStructArrayView(SimpleStruct,
+                    [1, 2, 3].map(long_ => new SimpleStruct({long_})));
+                expect(view.length).toEqual(3);
+                expect(() => GIMarshallingTests.array_simple_struct_in(view))
+                    .not.toThrow();
+            });
+
+            it('are only passed back as arrays of the same struct type',
+                function () {
+                    const view = GObject.newStructArrayView(SimpleStruct, []);
+                    expect(() => GIMarshallingTests.array_struct_value_in(view))
+                        .toThrowError(/got an array of GIMarshallingTests.SimpleStruct/);
+                });
+
+            it('are only supported for simple structs', function () {
+                expect(() => GObject.withStructArrayViews(
+                    GIMarshallingTests.BoxedStruct, () => {})).toThrow();
+            });
+        });
     });
 
     describe('of booleans', function () {
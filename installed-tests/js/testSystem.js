@@ -1,4 +1,5 @@
 const System = imports.system;
+const Gio = imports.gi.Gio;
 const GObject = imports.gi.GObject;
 
 describe('System.addressOf()', function () {
@@ -43,6 +44,34 @@ describe('System.gc()', function () {
     });
 });
 
+describe('System.gcSlice()', function () {
+    it('runs slices until the collection finishes', function () {
+        // Finish any collection that is already in progress
+        while (System.gcSlice(1000))
+            continue;
+
+        // Keep enough alive that marking can't finish in one 1 ms slice
+        let live = Array.from({length: 1000000}, (v, i) => ({i}));
+
+        // A toggle reference going down makes the scheduler start a collection
+        // on the next slice, regardless of how much memory has been used
+        let store = new Gio.ListStore({item_type: GObject.Object});
+        store.append(new GObject.Object());
+        store.remove(0);
+
+        let slices = 0;
+        while (System.gcSlice(1000) && slices < 10000)
+            slices++;
+        expect(slices).toBeGreaterThan(0);
+        expect(slices).toBeLessThan(10000);
+        expect(live.length).toEqual(1000000);
+    });
+
+    it('throws on a nonpositive budget', function () {
+        expect(() => System.gcSlice(0)).toThrow();
+    });
+});
+
 describe('System.dumpHeap()', function () {
     it('throws but does not crash when given a nonexistent path', function () {
         expect(() => System.dumpHeap('/does/not/exist')).toThrow();
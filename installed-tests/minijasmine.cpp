@@ -28,11 +28,29 @@
 #include <girepository.h>
 #include <glib-object.h>
 #include <glib.h>
+#include <glib/gstdio.h>  // for g_remove
 
 #include <gjs/gjs.h>
 
+static char* cache_dir;
+
+static void remove_tree(const char* path) {
+    GDir* dir = g_dir_open(path, 0, nullptr);
+    if (dir) {
+        const char* name;
+        while ((name = g_dir_read_name(dir))) {
+            char* child = g_build_filename(path, name, nullptr);
+            remove_tree(child);
+            g_free(child);
+        }
+        g_dir_close(dir);
+    }
+    g_remove(path);
+}
+
 [[noreturn]] static void bail_out(GjsContext* gjs_context, const char* msg) {
     g_object_unref(gjs_context);
+    remove_tree(cache_dir);
     g_print("Bail out! %s\n", msg);
     exit(1);
 }
@@ -50,6 +68,12 @@ main(int argc, char **argv)
 
     setlocale(LC_ALL, "");
 
+    /* Keep the bytecode cache out of the user's cache directory */
+    cache_dir = g_dir_make_tmp("gjs-test-cache-XXXXXX", nullptr);
+    if (!cache_dir)
+        g_error("Failed to create a cache directory");
+    g_setenv("XDG_CACHE_HOME", cache_dir, true);
+
     if (g_getenv("GJS_USE_UNINSTALLED_FILES") != NULL) {
         g_irepository_prepend_search_path(g_getenv("TOP_BUILDDIR"));
     } else {
@@ -125,6 +149,9 @@ main(int argc, char **argv)
     g_object_unref(cx);
     gjs_memory_report("after destroying context", true);
 
+    remove_tree(cache_dir);
+    g_free(cache_dir);
+
     /* For TAP, should actually be return 0; as a nonzero return code would
      * indicate an error in the test harness. But that would be quite silly
      * when running the tests outside of the TAP driver. */
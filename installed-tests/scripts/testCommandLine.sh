@@ -9,6 +9,10 @@ fi
 # Avoid interference in the profiler tests from stray environment variable
 unset GJS_ENABLE_PROFILER
 
+# Keep the bytecode cache out of the user's cache directory
+cache_dir=$(mktemp -d)
+export XDG_CACHE_HOME="$cache_dir"
+
 # This JS script should exit immediately with code 42. If that is not working,
 # then it will exit after 3 seconds as a fallback, with code 0.
 cat <<EOF >exit.js
@@ -176,6 +180,17 @@ rm -f gjs-*.syscap foo.syscap
 $gjs -c 'imports.system.exit(0)' && ! stat gjs-*.syscap &> /dev/null
 report "no profiling data should be dumped without --profile"
 
+for bad_option in --profile-rate=0 --profile-rate=-1 --profile-rate=10001 \
+    --profile-flight-recorder=-1 --profile-long-frame=-1 \
+    --profile-allocations=-0.5 --profile-allocations=2; do
+    ! $gjs --profile $bad_option -c 1 2>/dev/null
+    report "$bad_option should be rejected"
+done
+$gjs --profile-rate=1 --profile-flight-recorder=0 --profile-long-frame=0 \
+    --profile-allocations=0 -c 1
+report "profiler options at the ends of their ranges should be accepted"
+rm -f gjs-*.syscap
+
 # Skip some tests if built without profiler support
 if $gjs --profile -c 1 2>&1 | grep -q 'Gjs-Message.*Profiler is disabled'; then
     reason="profiler is disabled"
@@ -231,6 +246,66 @@ else
     skip "avoid crashing when GTK vfuncs are called on context destroy" "GTK disabled"
 fi
 
+# --bundle loads modules from a GResource file; a bundle given later shadows
+# modules at the same path in an earlier one, and precompiled bytecode next to
+# a module is used instead of its source
+write_bundle () {
+    mkdir -p "$1"
+    cat <<EOF >"$1/bundle.gresource.xml"
+<?xml version="1.0" encoding="UTF-8"?>
+<gresources>
+  <gresource prefix="/org/gnome/gjs/bundle">
+$2
+  </gresource>
+</gresources>
+EOF
+}
+if command -v glib-compile-resources >/dev/null; then
+    write_bundle bundle1 '    <file>bundled.js</file>
+    <file>shadowed.js</file>'
+    echo 'var value = 42;' >bundle1/bundled.js
+    echo 'var value = 1;' >bundle1/shadowed.js
+    glib-compile-resources --sourcedir=bundle1 --target=bundle1.gresource \
+        bundle1/bundle.gresource.xml
+    write_bundle bundle2 '    <file>shadowed.js</file>'
+    echo 'var value = 2;' >bundle2/shadowed.js
+    glib-compile-resources --sourcedir=bundle2 --target=bundle2.gresource \
+        bundle2/bundle.gresource.xml
+
+    $gjs --bundle=bundle1.gresource -c 'if (imports.bundled.value !== 42) imports.system.exit(1);'
+    report "--bundle should load modules from the bundle"
+    $gjs --bundle=bundle1.gresource --bundle=bundle2.gresource -c 'if (imports.shadowed.value !== 2) imports.system.exit(1);'
+    report "a later --bundle should shadow modules in an earlier one"
+    $gjs --bundle=bundle2.gresource --bundle=bundle1.gresource -c 'if (imports.shadowed.value !== 1) imports.system.exit(1);'
+    report "the order of --bundle should decide which module is shadowed"
+
+    # The bytecode is compiled from different source than the bundled module,
+    # so the module's value shows which of the two was loaded
+    if test "$GJS_USE_UNINSTALLED_FILES" = "1"; then
+        write_bundle bundle3 '    <file>bundled.js</file>
+    <file>bundled.js.xdr</file>'
+        mkdir -p bundle3/src bundle3/out
+        echo 'var value = 42;' >bundle3/bundled.js
+        echo 'var value = 43;' >bundle3/src/bundled.js
+        "$TOP_BUILDDIR/gjs-compile-bytecode" --prefix=/org/gnome/gjs/bundle \
+            --srcdir=bundle3/src --outdir=bundle3/out bundled.js &&
+        glib-compile-resources --sourcedir=bundle3 --sourcedir=bundle3/out \
+            --target=bundle3.gresource bundle3/bundle.gresource.xml &&
+        (unset G_RESOURCE_OVERLAYS
+         $gjs --bundle=bundle3.gresource -c 'if (imports.bundled.value !== 43) imports.system.exit(1);')
+        report "precompiled bytecode next to a bundled module should be used"
+    else
+        skip "precompiled bytecode next to a bundled module should be used" "gjs-compile-bytecode is only run uninstalled"
+    fi
+    rm -rf bundle1 bundle2 bundle3 bundle1.gresource bundle2.gresource bundle3.gresource
+else
+    skip "--bundle should load modules from the bundle" "glib-compile-resources not found"
+    skip "a later --bundle should shadow modules in an earlier one" "glib-compile-resources not found"
+    skip "the order of --bundle should decide which module is shadowed" "glib-compile-resources not found"
+    skip "precompiled bytecode next to a bundled module should be used" "glib-compile-resources not found"
+fi
+
 rm -f exit.js help.js promise.js awaitcatch.js
+rm -rf "$cache_dir"
 
 echo "1..$total"
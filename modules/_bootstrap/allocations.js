@@ -0,0 +1,86 @@
+/* global debuggee, Debugger */
+(function (exports) {
+    'use strict';
+
+    const dbg = new Debugger();
+    let probability = 1;
+    // Collapsed stack => estimated number of bytes allocated there
+    let stacks = new Map();
+    // In flight recorder mode, the stacks of the previous period
+    let previousStacks = new Map();
+
+    function frameName(frame) {
+        const name = frame.functionDisplayName || '(anonymous)';
+        // Semicolons separate the frames in the collapsed stack format
+        return `${name} ${frame.source}:${frame.line}`.replace(/;/g, ',');
+    }
+
+    function collapse(...maps) {
+        const totals = new Map();
+        for (const map of maps) {
+            for (const [stack, bytes] of map)
+                totals.set(stack, (totals.get(stack) || 0) + bytes);
+        }
+
+        const lines = [];
+        for (const [stack, bytes] of totals)
+            lines.push(`${stack} ${Math.round(bytes)}\n`);
+        return lines.join('');
+    }
+
+    exports.startSampling = function (sampleProbability) {
+        probability = sampleProbability;
+        stacks = new Map();
+        previousStacks = new Map();
+
+        dbg.addDebuggee(debuggee);
+        dbg.memory.allocationSamplingProbability = probability;
+        dbg.memory.maxAllocationsLogLength = 100000;
+        dbg.memory.trackingAllocationSites = true;
+    };
+
+    // Returns whether the log overflowed, losing samples
+    exports.drainSamples = function () {
+        const overflowed = dbg.memory.allocationsLogOverflowed;
+
+        for (const {frame, class: className, size} of
+            dbg.memory.drainAllocationsLog()) {
+            const names = [`[${className}]`];
+            for (let f = frame; f; f = f.parent)
+                names.push(frameName(f));
+            const stack = names.reverse().join(';');
+
+            // Each sample stands for 1 / probability allocations on average
+            stacks.set(stack, (stacks.get(stack) || 0) + size / probability);
+        }
+
+        return overflowed;
+    };
+
+    // Throws away the previous period and starts a new one; returns whether
+    // the log overflowed, like drainSamples()
+    exports.rotateSamples = function () {
+        const overflowed = exports.drainSamples();
+        previousStacks = stacks;
+        stacks = new Map();
+        return overflowed;
+    };
+
+    // Returns the samples of the current and previous periods, and keeps
+    // sampling
+    exports.collectSamples = function () {
+        exports.drainSamples();
+        return collapse(previousStacks, stacks);
+    };
+
+    exports.stopSampling = function () {
+        exports.drainSamples();
+        dbg.memory.trackingAllocationSites = false;
+        dbg.removeAllDebuggees();
+
+        const collapsed = collapse(previousStacks, stacks);
+        stacks = new Map();
+        previousStacks = new Map();
+        return collapsed;
+    };
+})(window);
@@ -1,6 +1,8 @@
-/* exported ByteArray, fromArray, fromGBytes, fromString, toGBytes, toString */
+/* exported ByteArray, TextDecoder, TextEncoder, fromArray, fromGBytes,
+fromMappedFile, fromString, toGBytes, toString, transferToGBytes */
 
-var {fromGBytes, fromString, toGBytes, toString} = imports._byteArrayNative;
+var {fromGBytes, fromMappedFile, fromString, toGBytes, toString,
+    transferToGBytes, TextDecoder, TextEncoder} = imports._byteArrayNative;
 
 // For backwards compatibility
 
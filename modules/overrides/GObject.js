@@ -462,6 +462,28 @@ function _init() {
         Object.assign(this, params);
     };
 
+    /**
+     * Calls func(), and while it runs, returns C arrays of structType from C
+     * functions as struct array views: one typed array per field, over a
+     * single copy of the C array, instead of a JS array of separate structs.
+     * structType must be a struct without pointer fields. Calls can be
+     * nested; views stay enabled until the outermost call returns.
+     */
+    GObject.withStructArrayViews = function (structType, func) {
+        const wasEnabled = Gi.set_struct_array_views(structType, true);
+        try {
+            return func();
+        } finally {
+            Gi.set_struct_array_views(structType, wasEnabled);
+        }
+    };
+
+    /**
+     * Packs an array of structType structs into a struct array view, which
+     * can be passed to C functions that take a C array of structType.
+     */
+    GObject.newStructArrayView = Gi.new_struct_array_view;
+
     // fake enum for signal accumulators, keep in sync with gi/object.c
     GObject.AccumulatorType = {
         NONE: 0,
@@ -160,6 +160,22 @@ gjs_gc(JSContext *context,
     return true;
 }
 
+static bool gjs_gc_slice(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    int64_t budget_us;
+    if (!gjs_parse_call_args(cx, "gcSlice", args, "t", "budget", &budget_us))
+        return false;
+
+    if (budget_us <= 0) {
+        gjs_throw(cx, "GC slice budget must be positive");
+        return false;
+    }
+
+    GjsContextPrivate* gjs = GjsContextPrivate::from_cx(cx);
+    args.rval().setBoolean(gjs->gc_scheduler().run_slice(budget_us));
+    return true;
+}
+
 static bool
 gjs_exit(JSContext *context,
          unsigned   argc,
@@ -202,6 +218,7 @@ static JSFunctionSpec module_funcs[] = {
     JS_FN("breakpoint", gjs_breakpoint, 0, GJS_MODULE_PROP_FLAGS),
     JS_FN("dumpHeap", gjs_dump_heap, 1, GJS_MODULE_PROP_FLAGS),
     JS_FN("gc", gjs_gc, 0, GJS_MODULE_PROP_FLAGS),
+    JS_FN("gcSlice", gjs_gc_slice, 1, GJS_MODULE_PROP_FLAGS),
     JS_FN("exit", gjs_exit, 0, GJS_MODULE_PROP_FLAGS),
     JS_FN("clearDateCaches", gjs_clear_date_caches, 0, GJS_MODULE_PROP_FLAGS),
     JS_FS_END};
@@ -21,17 +21,32 @@
  * IN THE SOFTWARE.
  */
 
-#include <string.h>  // for size_t, strlen
+#include <config.h>  // for ENABLE_PROFILER
+
+#include <stdint.h>
+#include <stdio.h>   // for sscanf
+#include <string.h>  // for size_t, strlen, strstr, memset
+#include <unistd.h>  // for sysconf
 
 #include <string>  // for u16string, u32string
+#include <vector>
 
+#include <girepository.h>
 #include <glib-object.h>
 #include <glib.h>
+#include <glib/gstdio.h>  // for g_remove, g_rmdir, g_unlink
+
+#ifdef ENABLE_PROFILER
+#    include <sysprof-capture.h>
+#endif
 
 #include "gjs/jsapi-wrapper.h"
 
+#include "gi/repo.h"
+#include "gjs/bytecode-cache.h"
 #include "gjs/context.h"
 #include "gjs/error-types.h"
+#include "gjs/import-prefetch.h"
 #include "gjs/jsapi-util.h"
 #include "gjs/profiler.h"
 #include "test/gjs-test-utils.h"
@@ -130,6 +145,33 @@ gjstest_test_func_gjs_gobject_js_defined_type(void)
     g_object_unref(context);
 }
 
+static void gjstest_test_func_gjs_gi_gtype_info_cache(void) {
+    // Nothing else in this process needs the GIRepository typelib
+    if (g_irepository_is_registered(nullptr, "GIRepository", nullptr)) {
+        g_test_skip("GIRepository typelib already loaded");
+        return;
+    }
+
+    GType gtype = g_irepository_get_type();
+    g_assert_null(gjs_lookup_gtype_info(gtype));
+    g_assert_null(gjs_lookup_gtype_info(gtype));
+
+    // Loading the typelib anywhere else must not leave the miss cached
+    GError* error = nullptr;
+    if (!g_irepository_require(nullptr, "GIRepository", nullptr,
+                               GIRepositoryLoadFlags(0), &error)) {
+        g_test_skip(error->message);
+        g_error_free(error);
+        return;
+    }
+    GjsAutoBaseInfo info = gjs_lookup_gtype_info(gtype);
+    g_assert_nonnull(info);
+    g_assert_cmpstr(g_base_info_get_name(info), ==, "Repository");
+
+    GjsAutoBaseInfo cached = gjs_lookup_gtype_info(gtype);
+    g_assert_true(cached.get() == info.get());
+}
+
 static void gjstest_test_func_gjs_jsapi_util_string_js_string_utf8(
     GjsUnitTestFixture* fx, const void*) {
     JS::RootedValue js_string(fx->cx);
@@ -361,6 +403,444 @@ static void gjstest_test_strip_shebang_advance_to_end_for_just_shebang(void) {
     g_assert_cmpuint(line_number, ==, 2);
 }
 
+static void gjstest_test_func_gjs_context_gc_policy(void) {
+    GjsAutoUnref<GjsContext> context = static_cast<GjsContext*>(
+        g_object_new(GJS_TYPE_CONTEXT, "gc-policy", GJS_GC_POLICY_LOW_MEMORY,
+                     nullptr));
+    GjsGcPolicy policy;
+
+    g_object_get(context, "gc-policy", &policy, nullptr);
+    g_assert_cmpint(policy, ==, GJS_GC_POLICY_LOW_MEMORY);
+
+    g_object_set(context, "gc-policy", GJS_GC_POLICY_LATENCY, nullptr);
+    g_object_get(context, "gc-policy", &policy, nullptr);
+    g_assert_cmpint(policy, ==, GJS_GC_POLICY_LATENCY);
+
+    // Allocate some garbage and make sure collecting it with the policy in
+    // effect doesn't disturb evaluation
+    GError* error = nullptr;
+    int estatus;
+    bool ok = gjs_context_eval(context,
+                               "for (let i = 0; i < 10000; i++) [i, {i}];", -1,
+                               "<input>", &estatus, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+    gjs_context_maybe_gc(context);
+}
+
+static size_t test_rss_bytes(void) {
+    char* unowned_statm;
+    if (!g_file_get_contents("/proc/self/statm", &unowned_statm, nullptr,
+                             nullptr))
+        return 0;
+    GjsAutoChar statm = unowned_statm;
+    unsigned long vm_pages, rss_pages;
+    if (sscanf(statm, "%lu %lu", &vm_pages, &rss_pages) != 2)
+        return 0;
+    return rss_pages * sysconf(_SC_PAGESIZE);
+}
+
+// Whether running slices until there is nothing left to do collected anything
+static bool run_gc_slices_collected(GjsContext* context) {
+    auto* cx = static_cast<JSContext*>(gjs_context_get_native_context(context));
+    uint32_t gc_number = JS_GetGCParameter(cx, JSGC_NUMBER);
+    while (gjs_context_run_gc_slice(context, 10000))
+        continue;
+    return JS_GetGCParameter(cx, JSGC_NUMBER) != gc_number;
+}
+
+static void gjstest_test_func_gjs_context_gc_policy_scheduling(void) {
+    if (test_rss_bytes() == 0) {
+        g_test_skip("Needs /proc/self/statm");
+        return;
+    }
+
+    static const GjsGcPolicy policies[] = {
+        GJS_GC_POLICY_BALANCED, GJS_GC_POLICY_LATENCY,
+        GJS_GC_POLICY_THROUGHPUT, GJS_GC_POLICY_LOW_MEMORY};
+    // Checks are rate limited to one per 5 frames
+    static const unsigned long check_interval_us = 100000;
+
+    for (GjsGcPolicy policy : policies) {
+        GjsAutoUnref<GjsContext> context = static_cast<GjsContext*>(
+            g_object_new(GJS_TYPE_CONTEXT, "gc-policy", policy, nullptr));
+
+        // Measurements are taken after this collection, so nothing has grown
+        gjs_context_gc(context);
+        g_usleep(check_interval_us);
+        g_assert_false(run_gc_slices_collected(context));
+
+        // Grow the RSS by 80%. All policies but throughput (which allows it to
+        // double) must collect.
+        size_t grow = test_rss_bytes() * 4 / 5;
+        GjsAutoChar block = static_cast<char*>(g_malloc(grow));
+        memset(block, 1, grow);
+        g_usleep(check_interval_us);
+        if (policy == GJS_GC_POLICY_THROUGHPUT)
+            g_assert_false(run_gc_slices_collected(context));
+        else
+            g_assert_true(run_gc_slices_collected(context));
+    }
+}
+
+static void gjstest_test_func_gjs_context_engine_tuning(void) {
+    GjsAutoUnref<GjsContext> context = static_cast<GjsContext*>(g_object_new(
+        GJS_TYPE_CONTEXT, "engine-preset", GJS_ENGINE_PRESET_BATCH,
+        "gc-slice-budget", 20, nullptr));
+    GjsEnginePreset preset;
+    unsigned slice_budget, max_malloc_bytes;
+
+    g_object_get(context, "engine-preset", &preset, "gc-slice-budget",
+                 &slice_budget, "gc-max-malloc-bytes", &max_malloc_bytes,
+                 nullptr);
+    g_assert_cmpint(preset, ==, GJS_ENGINE_PRESET_BATCH);
+    // Explicitly set values take precedence over the preset
+    g_assert_cmpuint(slice_budget, ==, 20);
+    // Values that were not set are filled in from the preset
+    g_assert_cmpuint(max_malloc_bytes, >, 0);
+
+    int estatus;
+    GError* error = nullptr;
+    bool ok = gjs_context_eval(context, "1+1", -1, "<input>", &estatus, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+}
+
+static void gjstest_test_func_gjs_context_engine_tuning_heap_growth(void) {
+    unsigned heap_growth;
+
+    // Heap growth that the JS engine would reject falls back to the preset
+    g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                          "Ignoring gc-heap-growth 50*");
+    {
+        GjsAutoUnref<GjsContext> context = static_cast<GjsContext*>(
+            g_object_new(GJS_TYPE_CONTEXT, "engine-preset",
+                         GJS_ENGINE_PRESET_BATCH, "gc-heap-growth", 50,
+                         nullptr));
+        g_test_assert_expected_messages();
+        g_object_get(context, "gc-heap-growth", &heap_growth, nullptr);
+        g_assert_cmpuint(heap_growth, ==, 300);
+    }
+
+    g_setenv("GJS_GC_HEAP_GROWTH", "20000", true);
+    g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                          "Ignoring value 20000 for GJS_GC_HEAP_GROWTH*");
+    {
+        GjsAutoUnref<GjsContext> context = static_cast<GjsContext*>(
+            g_object_new(GJS_TYPE_CONTEXT, "engine-preset",
+                         GJS_ENGINE_PRESET_BATCH, "gc-heap-growth", 200,
+                         nullptr));
+        g_test_assert_expected_messages();
+        g_object_get(context, "gc-heap-growth", &heap_growth, nullptr);
+        g_assert_cmpuint(heap_growth, ==, 200);
+    }
+    g_unsetenv("GJS_GC_HEAP_GROWTH");
+}
+
+static void gjstest_test_func_gjs_context_job_queue_budget(void) {
+    GjsAutoUnref<GjsContext> context = static_cast<GjsContext*>(g_object_new(
+        GJS_TYPE_CONTEXT, "job-queue-count-budget", 1, nullptr));
+    GError* error = nullptr;
+    int estatus;
+
+    // Queue three promise callbacks from the main loop, and an idle handler at
+    // GTK's redraw priority, which should get to run in between them
+    bool ok = gjs_context_eval(context, R"js(
+        const GLib = imports.gi.GLib;
+        var log = [];
+        GLib.idle_add(GLib.PRIORITY_DEFAULT, () => {
+            for (let i = 0; i < 3; i++)
+                Promise.resolve().then(() => log.push('job'));
+            GLib.idle_add(GLib.PRIORITY_HIGH_IDLE + 20, () => {
+                log.push('paint');
+                return GLib.SOURCE_REMOVE;
+            });
+            return GLib.SOURCE_REMOVE;
+        });
+    )js", -1, "<input>", &estatus, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    while (g_main_context_iteration(nullptr, false)) {
+    }
+
+    ok = gjs_context_eval(context, R"js(
+        if (log.join() !== 'job,paint,job,job')
+            throw new Error(`Wrong order: ${log}`);
+    )js", -1, "<input>", &estatus, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+}
+
+static void gjstest_test_func_gjs_context_prefetch_imports(void) {
+    GError* error = nullptr;
+    GjsAutoChar dir = g_dir_make_tmp("gjs-test-prefetch-XXXXXX", &error);
+    g_assert_no_error(error);
+    GjsAutoChar good = g_build_filename(dir, "good.js", nullptr);
+    GjsAutoChar bad = g_build_filename(dir, "bad.js", nullptr);
+    g_file_set_contents(good, "var value = 42;", -1, &error);
+    g_assert_no_error(error);
+    g_file_set_contents(bad, "var value = ;", -1, &error);
+    g_assert_no_error(error);
+
+    unsigned hits, failures, prev_hits, prev_failures;
+    gjs_import_prefetch_get_stats(&prev_hits, &prev_failures);
+
+    const char* search_path[] = {dir, nullptr};
+    GjsAutoUnref<GjsContext> context = static_cast<GjsContext*>(
+        g_object_new(GJS_TYPE_CONTEXT, "search-path", search_path, nullptr));
+    const char* paths[] = {good, bad, nullptr};
+    gjs_context_prefetch_imports(context, paths);
+
+    int estatus;
+    bool ok = gjs_context_eval(context, R"js(
+        if (imports.good.value !== 42)
+            throw new Error('Wrong value');
+        let threw = false;
+        try {
+            imports.bad;
+        } catch (e) {
+            threw = e instanceof SyntaxError;
+        }
+        if (!threw)
+            throw new Error('Syntax error not reported');
+    )js", -1, "<input>", &estatus, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    // Both modules came from the prefetched scripts, the syntax error too,
+    // rather than being compiled again by the importer
+    gjs_import_prefetch_get_stats(&hits, &failures);
+    g_assert_cmpuint(hits, ==, prev_hits + 2);
+    g_assert_cmpuint(failures, ==, prev_failures);
+
+    g_unlink(good);
+    g_unlink(bad);
+    g_rmdir(dir);
+}
+
+static void gjstest_test_func_gjs_context_import_cache(void) {
+    GError* error = nullptr;
+    GjsAutoChar dir = g_dir_make_tmp("gjs-test-import-cache-XXXXXX", &error);
+    g_assert_no_error(error);
+    GjsAutoChar module = g_build_filename(dir, "late.js", nullptr);
+
+    const char* search_path[] = {dir, nullptr};
+    GjsAutoUnref<GjsContext> context = static_cast<GjsContext*>(
+        g_object_new(GJS_TYPE_CONTEXT, "search-path", search_path, nullptr));
+
+    int estatus;
+    const char* import_late = R"js(
+        let threw = false;
+        try {
+            imports.late;
+        } catch (e) {
+            threw = true;
+        }
+        if (threw !== expectFailure)
+            throw new Error(`Import threw: ${threw}`);
+    )js";
+
+    bool ok = gjs_context_eval(context, "var expectFailure = true;", -1,
+                               "<input>", &estatus, &error) &&
+              gjs_context_eval(context, import_late, -1, "<input>", &estatus,
+                               &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    // The directory listing is cached, but the directory's modification time
+    // shows that it has changed, so the next import sees the new file
+    g_file_set_contents(module, "var value = 1;", -1, &error);
+    g_assert_no_error(error);
+    ok = gjs_context_eval(context, "expectFailure = false;", -1, "<input>",
+                          &estatus, &error) &&
+         gjs_context_eval(context, import_late, -1, "<input>", &estatus,
+                          &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    gjs_context_invalidate_import_cache(context);
+    ok = gjs_context_eval(context, import_late, -1, "<input>", &estatus,
+                          &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    g_unlink(module);
+    g_rmdir(dir);
+}
+
+static void gjstest_test_func_gjs_context_lazy_module_source(void) {
+    GError* error = nullptr;
+    GjsAutoChar dir = g_dir_make_tmp("gjs-test-lazy-source-XXXXXX", &error);
+    g_assert_no_error(error);
+    GjsAutoChar module = g_build_filename(dir, "lazy.js", nullptr);
+    g_file_set_contents(module, "function answer() { return 42; }", -1,
+                        &error);
+    g_assert_no_error(error);
+
+    const char* search_path[] = {dir, nullptr};
+    GjsAutoUnref<GjsContext> context = static_cast<GjsContext*>(
+        g_object_new(GJS_TYPE_CONTEXT, "search-path", search_path,
+                     "lazy-module-source", TRUE, nullptr));
+
+    // The source is not kept, but toString() can still read it from the file
+    int estatus;
+    bool ok = gjs_context_eval(context, R"js(
+        const {answer} = imports.lazy;
+        if (answer() !== 42)
+            throw new Error('Wrong value');
+        if (!answer.toString().includes('return 42;'))
+            throw new Error(`Wrong source: ${answer}`);
+    )js", -1, "<input>", &estatus, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    // If the file changes after compiling, its source is not used anymore,
+    // since the offsets in the compiled code don't fit it
+    GjsAutoChar changed = g_build_filename(dir, "changed.js", nullptr);
+    g_file_set_contents(changed, "function question() { return 'What?'; }", -1,
+                        &error);
+    g_assert_no_error(error);
+    ok = gjs_context_eval(context, "imports.changed;", -1, "<input>", &estatus,
+                          &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+    g_file_set_contents(changed, "var x;", -1, &error);
+    g_assert_no_error(error);
+    ok = gjs_context_eval(context, R"js(
+        const {question} = imports.changed;
+        if (question() !== 'What?')
+            throw new Error('Wrong value');
+        if (question.toString().includes('var x'))
+            throw new Error(`Wrong source: ${question}`);
+    )js", -1, "<input>", &estatus, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    g_unlink(changed);
+    g_unlink(module);
+    g_rmdir(dir);
+}
+
+static void import_cached_module(const char* dir, const char* expected) {
+    const char* search_path[] = {dir, nullptr};
+    GjsAutoUnref<GjsContext> context = static_cast<GjsContext*>(
+        g_object_new(GJS_TYPE_CONTEXT, "search-path", search_path, nullptr));
+
+    GjsAutoChar script = g_strdup_printf(
+        "if (imports.cached.value !== '%s') throw new Error('Wrong value');",
+        expected);
+    GError* error = nullptr;
+    int estatus;
+    bool ok = gjs_context_eval(context, script, -1, "<input>", &estatus,
+                               &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+}
+
+static void gjstest_test_func_gjs_context_bytecode_cache(void) {
+    GError* error = nullptr;
+    GjsAutoChar dir = g_dir_make_tmp("gjs-test-bytecode-cache-XXXXXX", &error);
+    g_assert_no_error(error);
+    GjsAutoChar module = g_build_filename(dir, "cached.js", nullptr);
+    g_file_set_contents(module, "var value = 'one';", -1, &error);
+    g_assert_no_error(error);
+
+    unsigned hits, misses, stale, prev_hits, prev_misses, prev_stale;
+    gjs_bytecode_cache_get_stats(&prev_hits, &prev_misses, &prev_stale);
+
+    // The first import compiles the module and writes it to the cache
+    import_cached_module(dir, "one");
+    gjs_bytecode_cache_get_stats(&hits, &misses, &stale);
+    g_assert_cmpuint(hits, ==, prev_hits);
+    g_assert_cmpuint(misses, ==, prev_misses + 1);
+
+    // A second context decodes it from the cache
+    import_cached_module(dir, "one");
+    gjs_bytecode_cache_get_stats(&hits, &misses, &stale);
+    g_assert_cmpuint(hits, ==, prev_hits + 1);
+    g_assert_cmpuint(misses, ==, prev_misses + 1);
+    g_assert_cmpuint(stale, ==, prev_stale);
+
+    // Editing the source, even without changing its size, invalidates it
+    g_file_set_contents(module, "var value = 'two';", -1, &error);
+    g_assert_no_error(error);
+    import_cached_module(dir, "two");
+    gjs_bytecode_cache_get_stats(&hits, &misses, &stale);
+    g_assert_cmpuint(hits, ==, prev_hits + 1);
+    g_assert_cmpuint(misses, ==, prev_misses + 2);
+    g_assert_cmpuint(stale, ==, prev_stale + 1);
+
+    // A corrupt entry is replaced by compiling the module again
+    GjsAutoChar cache_dir =
+        g_build_filename(g_get_user_cache_dir(), "gjs", nullptr);
+    GDir* entries = g_dir_open(cache_dir, 0, &error);
+    g_assert_no_error(error);
+    const char* name;
+    while ((name = g_dir_read_name(entries))) {
+        GjsAutoChar entry = g_build_filename(cache_dir, name, nullptr);
+        g_file_set_contents(entry, "garbage", -1, &error);
+        g_assert_no_error(error);
+    }
+    g_dir_close(entries);
+
+    import_cached_module(dir, "two");
+    gjs_bytecode_cache_get_stats(&hits, &misses, &stale);
+    g_assert_cmpuint(hits, ==, prev_hits + 1);
+    g_assert_cmpuint(misses, ==, prev_misses + 3);
+    g_assert_cmpuint(stale, ==, prev_stale + 2);
+
+    // ...and the new entry is used again
+    import_cached_module(dir, "two");
+    gjs_bytecode_cache_get_stats(&hits, &misses, &stale);
+    g_assert_cmpuint(hits, ==, prev_hits + 2);
+
+    g_unlink(module);
+    g_rmdir(dir);
+}
+
+static void gjstest_test_func_gjs_context_import_profile(void) {
+    GError* error = nullptr;
+    GjsAutoChar dir = g_dir_make_tmp("gjs-test-import-profile-XXXXXX", &error);
+    g_assert_no_error(error);
+    GjsAutoChar outer = g_build_filename(dir, "outer.js", nullptr);
+    GjsAutoChar inner = g_build_filename(dir, "inner.js", nullptr);
+    GjsAutoChar report_file = g_build_filename(dir, "report.txt", nullptr);
+    g_file_set_contents(outer, "var value = imports.inner.value;", -1, &error);
+    g_assert_no_error(error);
+    g_file_set_contents(inner, "var value = 42;", -1, &error);
+    g_assert_no_error(error);
+
+    const char* search_path[] = {dir, nullptr};
+    auto* context = static_cast<GjsContext*>(
+        g_object_new(GJS_TYPE_CONTEXT, "search-path", search_path, nullptr));
+    gjs_context_set_import_profile_output(context, report_file);
+
+    int estatus;
+    bool ok = gjs_context_eval(context, "imports.outer.value;", -1, "<input>",
+                               &estatus, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    // The report is written when the context is disposed
+    g_object_unref(context);
+
+    char* unowned_report;
+    g_file_get_contents(report_file, &unowned_report, nullptr, &error);
+    g_assert_no_error(error);
+    GjsAutoChar report = unowned_report;
+
+    // The inner module is nested in the outer one in the tree
+    const char* outer_line = strstr(report, "  module outer\n");
+    g_assert_nonnull(outer_line);
+    g_assert_nonnull(strstr(outer_line, "    module inner\n"));
+
+    g_unlink(report_file);
+    g_unlink(outer);
+    g_unlink(inner);
+    g_rmdir(dir);
+}
+
 static void
 gjstest_test_profiler_start_stop(void)
 {
@@ -387,6 +867,328 @@ gjstest_test_profiler_start_stop(void)
     gjs_profiler_stop(profiler);
 }
 
+static void gjstest_test_profiler_flight_recorder(void) {
+    GError* error = nullptr;
+    GjsAutoChar dir = g_dir_make_tmp("gjs-test-profiler-XXXXXX", &error);
+    g_assert_no_error(error);
+    GjsAutoChar filename = g_build_filename(dir, "profile.syscap", nullptr);
+    GjsAutoChar dump = g_build_filename(dir, "profile-1.syscap", nullptr);
+    GjsAutoChar allocations =
+        g_build_filename(dir, "profile-allocations.folded", nullptr);
+    GjsAutoChar dump_allocations =
+        g_build_filename(dir, "profile-1-allocations.folded", nullptr);
+
+    GjsAutoUnref<GjsContext> context = static_cast<GjsContext*>(
+        g_object_new(GJS_TYPE_CONTEXT, "profiler-enabled", TRUE, nullptr));
+    GjsProfiler* profiler = gjs_context_get_profiler(context);
+
+    gjs_profiler_set_filename(profiler, filename);
+    gjs_profiler_set_sample_rate(profiler, 100);
+    gjs_profiler_set_flight_recorder(profiler, 5);
+    gjs_profiler_set_native_stacks(profiler, true);
+    gjs_profiler_set_allocation_sampling(profiler, 1);
+
+    g_assert_false(gjs_profiler_dump(profiler, &error));
+    g_clear_error(&error);
+
+    gjs_profiler_start(profiler);
+
+    int estatus;
+    bool ok = gjs_context_eval(context, "[1,5,7,1,2,3,67,8].sort()", -1,
+                               "<input>", &estatus, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    ok = gjs_profiler_dump(profiler, &error);
+    gjs_profiler_stop(profiler);
+
+    if (!ok && g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOSYS)) {
+        g_test_skip(error->message);
+        g_clear_error(&error);
+    } else {
+        g_assert_no_error(error);
+        g_assert_true(ok);
+        g_assert_true(g_file_test(dump, G_FILE_TEST_EXISTS));
+        g_assert_true(g_file_test(dump_allocations, G_FILE_TEST_EXISTS));
+        // Only dumps are written in flight recorder mode
+        g_assert_false(g_file_test(filename, G_FILE_TEST_EXISTS));
+        g_assert_false(g_file_test(allocations, G_FILE_TEST_EXISTS));
+        g_unlink(dump);
+        g_unlink(dump_allocations);
+    }
+
+    g_rmdir(dir);
+}
+
+#ifdef ENABLE_PROFILER
+struct AddressRange {
+    uintptr_t start, end;
+};
+
+// Where libgjs is mapped, and how far up the stack the frame pointer probe
+// may look
+static std::vector<AddressRange> libgjs_ranges;
+static uintptr_t probe_stack_top;
+static bool frame_pointers_reach_libgjs;
+
+GJS_USE
+static bool in_libgjs(uintptr_t address) {
+    for (const AddressRange& range : libgjs_ranges) {
+        if (address >= range.start && address < range.end)
+            return true;
+    }
+    return false;
+}
+
+// Finds all the mappings of the file that @address is mapped from
+static void find_mappings(uintptr_t address,
+                          std::vector<AddressRange>* ranges) {
+    char* contents;
+    if (!g_file_get_contents("/proc/self/maps", &contents, nullptr, nullptr))
+        return;
+    GjsAutoChar contents_ref = contents;
+    GjsAutoStrv lines = g_strsplit(contents, "\n", 0);
+
+    std::string file;
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t ix = 0; lines[ix]; ix++) {
+            char line_file[256];
+            unsigned long start, end;
+            if (sscanf(lines[ix], "%lx-%lx %*s %*x %*x:%*x %*u %255s", &start,
+                       &end, line_file) != 3)
+                continue;
+            if (pass == 0 && address >= start && address < end)
+                file = line_file;
+            else if (pass == 1 && file == line_file)
+                ranges->push_back({start, end});
+        }
+        if (file.empty())
+            return;
+    }
+}
+
+/* Follows the frame pointers from this native, called from JS, the same way
+ * as the profiler does. If the chain gets back to libgjs, both the JS engine
+ * and libgjs keep frame pointers, so the profiler can walk through them too. */
+GJS_JSAPI_RETURN_CONVENTION
+static bool probe_frame_pointers(JSContext*, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    static const uintptr_t record_size = 2 * sizeof(uintptr_t);
+
+    auto fp = uintptr_t(__builtin_frame_address(0));
+    while (fp % sizeof(uintptr_t) == 0 && fp + record_size <= probe_stack_top) {
+        const uintptr_t* record = reinterpret_cast<uintptr_t*>(fp);
+        if (in_libgjs(record[1])) {
+            frame_pointers_reach_libgjs = true;
+            break;
+        }
+        if (record[0] <= fp)
+            break;
+        fp = record[0];
+    }
+
+    args.rval().setUndefined();
+    return true;
+}
+
+/* Whether a sample in the capture has a native frame in libgjs, with
+ * pseudo-stack entries both inside and outside of it; returns -1 if there were
+ * no samples */
+GJS_USE
+static int capture_has_interleaved_libgjs_frame(const char* filename) {
+    GError* error = nullptr;
+    SysprofCaptureReader* reader = sysprof_capture_reader_new(filename, &error);
+    g_assert_no_error(error);
+
+    auto is_jitmap = [](SysprofCaptureAddress address) {
+        return (address & SYSPROF_CAPTURE_JITMAP_MARK) ==
+               SYSPROF_CAPTURE_JITMAP_MARK;
+    };
+
+    int found = -1;
+    SysprofCaptureFrameType type;
+    while (found != 1 && sysprof_capture_reader_peek_type(reader, &type)) {
+        if (type != SYSPROF_CAPTURE_FRAME_SAMPLE) {
+            g_assert_true(sysprof_capture_reader_skip(reader));
+            continue;
+        }
+        const SysprofCaptureSample* sample =
+            sysprof_capture_reader_read_sample(reader);
+        g_assert_nonnull(sample);
+        found = 0;
+
+        // The addresses go from the innermost frame outwards
+        int first_jitmap = -1, last_jitmap = -1;
+        for (int ix = 0; ix < sample->n_addrs; ix++) {
+            if (!is_jitmap(sample->addrs[ix]))
+                continue;
+            if (first_jitmap == -1)
+                first_jitmap = ix;
+            last_jitmap = ix;
+        }
+        for (int ix = first_jitmap + 1; ix < last_jitmap; ix++) {
+            if (in_libgjs(sample->addrs[ix])) {
+                found = 1;
+                break;
+            }
+        }
+    }
+
+    sysprof_capture_reader_unref(reader);
+    return found;
+}
+#endif  // ENABLE_PROFILER
+
+static void gjstest_test_profiler_native_stacks(void) {
+#if !defined(ENABLE_PROFILER)
+    g_test_skip("Profiler is disabled");
+#elif !defined(__x86_64__) && !defined(__i386__) && !defined(__aarch64__)
+    g_test_skip("Native stacks are not supported on this architecture");
+#else
+    // A function pointer taken here might point to this program's PLT, so
+    // take one that libgjs filled in itself
+    GjsAutoTypeClass<GObjectClass> context_class(GJS_TYPE_CONTEXT);
+    libgjs_ranges.clear();
+    find_mappings(reinterpret_cast<uintptr_t>(context_class->finalize),
+                  &libgjs_ranges);
+    if (libgjs_ranges.empty()) {
+        g_test_skip("Needs /proc/self/maps");
+        return;
+    }
+
+    GError* error = nullptr;
+    GjsAutoChar dir = g_dir_make_tmp("gjs-test-profiler-XXXXXX", &error);
+    g_assert_no_error(error);
+    GjsAutoChar filename = g_build_filename(dir, "profile.syscap", nullptr);
+    GjsAutoChar module = g_build_filename(dir, "busy.js", nullptr);
+
+    // Importing the module runs it from libgjs's importer, called from JS.
+    // Without the JIT, every sample interrupts the JS engine's own code, which
+    // the probe checks for frame pointers.
+    g_file_set_contents(module, R"js(
+        probeFramePointers();
+        const start = Date.now();
+        while (Date.now() - start < 200) {
+        }
+    )js", -1, &error);
+    g_assert_no_error(error);
+
+    const char* search_path[] = {dir, nullptr};
+    GjsAutoUnref<GjsContext> context = static_cast<GjsContext*>(g_object_new(
+        GJS_TYPE_CONTEXT, "profiler-enabled", TRUE, "disable-jit", TRUE,
+        "search-path", search_path, nullptr));
+
+    auto* cx = static_cast<JSContext*>(gjs_context_get_native_context(context));
+    {
+        JSAutoRequest ar(cx);
+        JS::RootedObject global(cx, gjs_get_import_global(cx));
+        JSAutoCompartment ac(cx, global);
+        g_assert_nonnull(JS_DefineFunction(cx, global, "probeFramePointers",
+                                           probe_frame_pointers, 0, 0));
+    }
+
+    GjsProfiler* profiler = gjs_context_get_profiler(context);
+    gjs_profiler_set_filename(profiler, filename);
+    gjs_profiler_set_native_stacks(profiler, true);
+    gjs_profiler_start(profiler);
+
+    char stack_top;
+    probe_stack_top = uintptr_t(&stack_top);
+    frame_pointers_reach_libgjs = false;
+    int estatus;
+    bool ok = gjs_context_eval(context, "imports.busy;", -1, "<input>",
+                               &estatus, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    gjs_profiler_stop(profiler);
+
+    int found = capture_has_interleaved_libgjs_frame(filename);
+    g_unlink(filename);
+    g_unlink(module);
+    g_rmdir(dir);
+
+    if (found == -1) {
+        g_test_skip("No samples were taken");
+        return;
+    }
+    if (!frame_pointers_reach_libgjs) {
+        g_test_skip("The JS engine or libgjs was built without frame pointers");
+        return;
+    }
+
+    // The importer's frames are between the module's pseudo-stack entries and
+    // those of the code that imported it
+    g_assert_cmpint(found, ==, 1);
+#endif
+}
+
+static void gjstest_test_profiler_allocations(void) {
+    GError* error = nullptr;
+    GjsAutoChar dir = g_dir_make_tmp("gjs-test-profiler-XXXXXX", &error);
+    g_assert_no_error(error);
+    GjsAutoChar filename = g_build_filename(dir, "profile.syscap", nullptr);
+    GjsAutoChar allocations =
+        g_build_filename(dir, "profile-allocations.folded", nullptr);
+
+    GjsAutoUnref<GjsContext> context = static_cast<GjsContext*>(
+        g_object_new(GJS_TYPE_CONTEXT, "profiler-enabled", TRUE, nullptr));
+    GjsProfiler* profiler = gjs_context_get_profiler(context);
+
+    // Only fails with this error if built without the profiler
+    if (!gjs_profiler_dump(profiler, &error) &&
+        g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOSYS)) {
+        g_test_skip(error->message);
+        g_clear_error(&error);
+        g_rmdir(dir);
+        return;
+    }
+    g_clear_error(&error);
+
+    gjs_profiler_set_filename(profiler, filename);
+    gjs_profiler_set_allocation_sampling(profiler, 1);
+    gjs_profiler_start(profiler);
+
+    int estatus;
+    bool ok = gjs_context_eval(context, R"js(
+        function allocateThings() {
+            const things = [];
+            for (let ix = 0; ix < 100; ix++)
+                things.push({ix});
+            return things;
+        }
+        allocateThings();
+    )js", -1, "<input>", &estatus, &error);
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    gjs_profiler_stop(profiler);
+
+    char* contents;
+    g_file_get_contents(allocations, &contents, nullptr, &error);
+    g_assert_no_error(error);
+    GjsAutoChar contents_ref = contents;
+    g_assert_nonnull(strstr(contents, "allocateThings <input>:"));
+    g_assert_nonnull(strstr(contents, "[Object] "));
+
+    g_unlink(allocations);
+    g_unlink(filename);
+    g_rmdir(dir);
+}
+
+static void remove_tree(const char* path) {
+    GDir* dir = g_dir_open(path, 0, nullptr);
+    if (dir) {
+        const char* name;
+        while ((name = g_dir_read_name(dir))) {
+            GjsAutoChar child = g_build_filename(path, name, nullptr);
+            remove_tree(child);
+        }
+        g_dir_close(dir);
+    }
+    g_remove(path);
+}
+
 int
 main(int    argc,
      char **argv)
@@ -394,6 +1196,21 @@ main(int    argc,
     /* Avoid interference in the tests from stray environment variable */
     g_unsetenv("GJS_ENABLE_PROFILER");
     g_unsetenv("GJS_TRACE_FD");
+    g_unsetenv("GJS_ENGINE_PRESET");
+    g_unsetenv("GJS_GC_NURSERY_BYTES");
+    g_unsetenv("GJS_GC_MAX_BYTES");
+    g_unsetenv("GJS_GC_MAX_MALLOC_BYTES");
+    g_unsetenv("GJS_GC_SLICE_BUDGET");
+    g_unsetenv("GJS_GC_HEAP_GROWTH");
+    g_unsetenv("GJS_JIT_BASELINE_THRESHOLD");
+    g_unsetenv("GJS_JIT_ION_THRESHOLD");
+    g_unsetenv("GJS_DISABLE_JIT");
+    g_unsetenv("GJS_DISABLE_BYTECODE_CACHE");
+
+    /* Keep the bytecode cache out of the user's cache directory */
+    GjsAutoChar cache_dir = g_dir_make_tmp("gjs-test-cache-XXXXXX", nullptr);
+    g_assert_nonnull(cache_dir);
+    g_setenv("XDG_CACHE_HOME", cache_dir, true);
 
     g_test_init(&argc, &argv, NULL);
 
@@ -402,6 +1219,28 @@ main(int    argc,
     g_test_add_func("/gjs/context/eval/non-zero-terminated",
                     gjstest_test_func_gjs_context_eval_non_zero_terminated);
     g_test_add_func("/gjs/context/exit", gjstest_test_func_gjs_context_exit);
+    g_test_add_func("/gjs/context/gc-policy",
+                    gjstest_test_func_gjs_context_gc_policy);
+    g_test_add_func("/gjs/context/gc-policy/scheduling",
+                    gjstest_test_func_gjs_context_gc_policy_scheduling);
+    g_test_add_func("/gjs/context/engine-tuning",
+                    gjstest_test_func_gjs_context_engine_tuning);
+    g_test_add_func("/gjs/context/engine-tuning/heap-growth",
+                    gjstest_test_func_gjs_context_engine_tuning_heap_growth);
+    g_test_add_func("/gjs/context/job-queue-budget",
+                    gjstest_test_func_gjs_context_job_queue_budget);
+    g_test_add_func("/gjs/context/prefetch-imports",
+                    gjstest_test_func_gjs_context_prefetch_imports);
+    g_test_add_func("/gjs/context/import-cache",
+                    gjstest_test_func_gjs_context_import_cache);
+    g_test_add_func("/gjs/context/lazy-module-source",
+                    gjstest_test_func_gjs_context_lazy_module_source);
+    g_test_add_func("/gjs/context/bytecode-cache",
+                    gjstest_test_func_gjs_context_bytecode_cache);
+    g_test_add_func("/gjs/context/import-profile",
+                    gjstest_test_func_gjs_context_import_profile);
+    g_test_add_func("/gjs/gi/gtype-info-cache",
+                    gjstest_test_func_gjs_gi_gtype_info_cache);
     g_test_add_func("/gjs/gobject/js_defined_type", gjstest_test_func_gjs_gobject_js_defined_type);
     g_test_add_func("/gjs/jsutil/strip_shebang/no_shebang", gjstest_test_strip_shebang_no_advance_for_no_shebang);
     g_test_add_func("/gjs/jsutil/strip_shebang/short_string",
@@ -410,6 +1249,12 @@ main(int    argc,
     g_test_add_func("/gjs/jsutil/strip_shebang/only_shebang",
                     gjstest_test_strip_shebang_advance_to_end_for_just_shebang);
     g_test_add_func("/gjs/profiler/start_stop", gjstest_test_profiler_start_stop);
+    g_test_add_func("/gjs/profiler/flight_recorder",
+                    gjstest_test_profiler_flight_recorder);
+    g_test_add_func("/gjs/profiler/native_stacks",
+                    gjstest_test_profiler_native_stacks);
+    g_test_add_func("/gjs/profiler/allocations",
+                    gjstest_test_profiler_allocations);
     g_test_add_func("/util/misc/strv/concat/null",
                     gjstest_test_func_util_misc_strv_concat_null);
     g_test_add_func("/util/misc/strv/concat/pointers",
@@ -445,5 +1290,7 @@ main(int    argc,
 
     g_test_run();
 
+    remove_tree(cache_dir);
+
     return 0;
 }
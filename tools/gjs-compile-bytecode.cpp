@@ -0,0 +1,229 @@
+/* -*- mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2019 Endless Mobile, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/* Build tool that compiles the built-in modules to SpiderMonkey bytecode in
+ * XDR format, so that the bytecode can be embedded in the GResource next to the
+ * sources and decoded at startup, instead of parsing the sources every time.
+ * See gjs_bytecode_decode_precompiled().
+ *
+ * It must compile the scripts exactly the way they are compiled at runtime, but
+ * it can't link to libgjs, which embeds its output, so it uses the JS engine
+ * directly with a bare global object. */
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdlib.h>  // for EXIT_FAILURE, EXIT_SUCCESS
+
+#include <glib.h>
+#include <glib/gstdio.h>  // for g_mkdir_with_parents
+
+#include "gjs/jsapi-wrapper.h"
+
+#include "gjs/bytecode-build-id.h"
+
+static char* srcdir = nullptr;
+static char* outdir = nullptr;
+static char* prefix = nullptr;
+static char** global_scope_files = nullptr;
+static char** module_files = nullptr;
+
+static GOptionEntry entries[] = {
+    {"srcdir", 0, 0, G_OPTION_ARG_FILENAME, &srcdir,
+     "Directory containing the sources", "DIR"},
+    {"outdir", 0, 0, G_OPTION_ARG_FILENAME, &outdir,
+     "Directory to write the bytecode files to", "DIR"},
+    {"prefix", 0, 0, G_OPTION_ARG_STRING, &prefix,
+     "Resource path prefix of the sources", "PATH"},
+    {"global", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &global_scope_files,
+     "Compile FILE for the global scope, like the bootstrap scripts", "FILE"},
+    {G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &module_files,
+     nullptr, "FILE..."},
+    {nullptr}};
+
+static const JSClass global_class = {
+    "GjsCompileBytecodeGlobal", JSCLASS_GLOBAL_FLAGS,
+    &JS::DefaultGlobalClassOps};
+
+static void print_exception(JSContext* cx, const char* filename) {
+    JS::RootedValue exc(cx);
+    if (!JS_GetPendingException(cx, &exc)) {
+        g_printerr("%s: compilation failed\n", filename);
+        return;
+    }
+    JS_ClearPendingException(cx);
+
+    JS::RootedString message(cx, JS::ToString(cx, exc));
+    JS::UniqueChars utf8;
+    if (message)
+        utf8 = JS_EncodeStringToUTF8(cx, message);
+    g_printerr("%s: %s\n", filename, utf8 ? utf8.get() : "compilation failed");
+    JS_ClearPendingException(cx);
+}
+
+/* Compiles @relpath, relative to the source directory, with the same options
+ * as gjs_bytecode_cache_compile() or run_bootstrap() would use for it at
+ * runtime, and writes the bytecode to @relpath + ".xdr" in the output
+ * directory. The source is marked lazy, since at runtime it can be retrieved
+ * from the GResource by the source hook. */
+static bool compile_file(JSContext* cx, const char* relpath,
+                         bool global_scope) {
+    GError* error = nullptr;
+    char* path = g_build_filename(srcdir, relpath, nullptr);
+    char* contents;
+    size_t len;
+    bool ok = g_file_get_contents(path, &contents, &len, &error);
+    g_free(path);
+    if (!ok) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        return false;
+    }
+
+    char* uri = g_strconcat("resource://", prefix, "/", relpath, nullptr);
+
+    size_t script_len;
+    JS::ConstUTF8CharsZ utf8(contents, len);
+    JS::UniqueTwoByteChars script(
+        JS::UTF8CharsToNewTwoByteCharsZ(cx, utf8, &script_len).get());
+    g_free(contents);
+
+    JS::CompileOptions options(cx);
+    options.setUTF8(true).setFileAndLine(uri, 1).setSourceIsLazy(true);
+
+    JS::RootedScript compiled(cx);
+    if (!script) {
+        ok = false;
+    } else if (global_scope) {
+        ok = JS::Compile(cx, options, script.get(), script_len, &compiled);
+    } else {
+        JS::SourceBufferHolder buf(script.get(), script_len,
+                                   JS::SourceBufferHolder::NoOwnership);
+        ok = JS::CompileForNonSyntacticScope(cx, options, buf, &compiled);
+    }
+    if (!ok) {
+        print_exception(cx, uri);
+        g_free(uri);
+        return false;
+    }
+
+    JS::TranscodeBuffer buffer;
+    if (JS::EncodeScript(cx, buffer, compiled) != JS::TranscodeResult_Ok) {
+        print_exception(cx, uri);
+        g_free(uri);
+        return false;
+    }
+    g_free(uri);
+
+    char* xdr_relpath = g_strconcat(relpath, ".xdr", nullptr);
+    char* out_path = g_build_filename(outdir, xdr_relpath, nullptr);
+    char* out_dir = g_path_get_dirname(out_path);
+    g_free(xdr_relpath);
+
+    ok = g_mkdir_with_parents(out_dir, 0755) == 0 &&
+         g_file_set_contents(out_path,
+                             reinterpret_cast<const char*>(buffer.begin()),
+                             buffer.length(), &error);
+    if (!ok) {
+        g_printerr("Failed to write %s: %s\n", out_path,
+                   error ? error->message : g_strerror(errno));
+        g_clear_error(&error);
+    }
+
+    g_free(out_dir);
+    g_free(out_path);
+    return ok;
+}
+
+static bool compile_files(JSContext* cx, char** files, bool global_scope) {
+    for (char** file = files; file && *file; file++) {
+        if (!compile_file(cx, *file, global_scope))
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    GError* error = nullptr;
+    GOptionContext* context = g_option_context_new(nullptr);
+    g_option_context_set_summary(
+        context, "Compile JS sources to bytecode for embedding in a GResource");
+    g_option_context_add_main_entries(context, entries, nullptr);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(context);
+
+    if (!srcdir)
+        srcdir = g_strdup(".");
+    if (!outdir)
+        outdir = g_strdup(".");
+    if (!prefix)
+        prefix = g_strdup("/org/gnome/gjs");
+
+    if (!JS_Init()) {
+        g_printerr("Failed to initialize the JS engine\n");
+        return EXIT_FAILURE;
+    }
+
+    JSContext* cx = JS_NewContext(32 * 1024 * 1024 /* max bytes */);
+    if (!cx || !JS::InitSelfHostedCode(cx)) {
+        g_printerr("Failed to create a JS context\n");
+        return EXIT_FAILURE;
+    }
+    JS::SetBuildIdOp(cx, gjs_bytecode_get_build_id);
+
+    bool ok;
+    {
+        JSAutoRequest ar(cx);
+
+        JS::CompartmentOptions compartment_options;
+        JS::RootedObject global(
+            cx, JS_NewGlobalObject(cx, &global_class, nullptr,
+                                   JS::FireOnNewGlobalHook,
+                                   compartment_options));
+        if (!global) {
+            g_printerr("Failed to create a global object\n");
+            return EXIT_FAILURE;
+        }
+
+        JSAutoCompartment ac(cx, global);
+        ok = compile_files(cx, global_scope_files, true) &&
+             compile_files(cx, module_files, false);
+    }
+
+    JS_DestroyContext(cx);
+    JS_ShutDown();
+
+    g_strfreev(global_scope_files);
+    g_strfreev(module_files);
+    g_free(srcdir);
+    g_free(outdir);
+    g_free(prefix);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}